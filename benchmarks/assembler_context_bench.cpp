@@ -0,0 +1,70 @@
+#include "assembler_context.h"
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "bench_snippet.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+template <typename Function>
+auto measureNanoseconds(Function &&function) -> double {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void report(const char *name, std::vector<double> &latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double fraction) {
+        return latencies[static_cast<size_t>(
+            fraction * static_cast<double>(latencies.size() - 1))];
+    };
+    std::printf("%s: p50 %.0f ns, p99 %.0f ns per snippet\n", name,
+                percentile(0.50), percentile(0.99));
+}
+
+} // namespace
+
+// Latency of assembling one small snippet with a fresh lexer, parser and
+// state each time versus a reused AssemblerContext:
+// assembler_context_bench [snippet count, default 100k]
+auto main(int argc, char *argv[]) -> int {
+    const size_t count =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+
+    std::vector<std::string> snippets;
+    for (int variant{0}; variant < 16; variant++) {
+        snippets.push_back(makeSnippet(variant));
+    }
+
+    std::vector<double> fresh(count);
+    for (size_t i{0}; i < count; i++) {
+        fresh[i] = measureNanoseconds([&] {
+            AssemblerState state;
+            Lexer::tokenize(snippets[i % snippets.size()], state);
+            Parser::parse(state);
+            Encoder::encode(state);
+        });
+    }
+    report("fresh state", fresh);
+
+    AssemblerContext context;
+    context.assemble(snippets[0]); // Warm up the buffers
+    std::vector<double> reused(count);
+    for (size_t i{0}; i < count; i++) {
+        reused[i] = measureNanoseconds(
+            [&] { context.assemble(snippets[i % snippets.size()]); });
+    }
+    report("reused context", reused);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "batch_encoder.h"
+#include "encoder.h"
+#include "encoding.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+template <typename Function> auto timeSeconds(Function &&function) -> double {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+// Compares the scalar encoder against each batch kernel on already resolved
+// instructions: batch_encoder_bench [instruction count, default 10M]
+auto main(int argc, char *argv[]) -> int {
+    const size_t count =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+
+    std::mt19937 rng(42);
+    std::vector<ResolvedInstruction> resolved(count);
+    for (auto &instruction : resolved) {
+        instruction.encoding =
+            &instructionEncodings[rng() % instructionEncodings.size()];
+        for (size_t i{0}; i < instruction.encoding->operandCount; i++) {
+            const uint32_t width = instruction.encoding->fields[i].width;
+            instruction.operands[i] = rng() & ((1U << width) - 1U);
+        }
+        instruction.is32Bit = (rng() & 1U) != 0;
+    }
+
+    std::vector<uint32_t> expected(count);
+    const double scalarSeconds = timeSeconds([&] {
+        for (size_t i{0}; i < count; i++) {
+            expected[i] = Encoder::encodeResolved(resolved[i]);
+        }
+    });
+    std::printf("scalar encoder: %.3f s (%.1f M instr/s)\n", scalarSeconds,
+                static_cast<double>(count) / scalarSeconds / 1e6);
+
+    EncodingBatches batches;
+    const double groupSeconds = timeSeconds([&] {
+        for (size_t i{0}; i < count; i++) {
+            BatchEncoder::addInstruction(batches, resolved[i],
+                                         static_cast<uint32_t>(i));
+        }
+    });
+    std::printf("grouping into batches: %.3f s\n", groupSeconds);
+
+    const std::vector<std::pair<SimdLevel, const char *>> levels = {
+        {SimdLevel::SCALAR, "batch scalar"},
+        {SimdLevel::SSE2, "batch sse2"},
+        {SimdLevel::AVX2, "batch avx2"}};
+    std::vector<uint32_t> words(count);
+    for (const auto &[level, name] : levels) {
+        if (level == SimdLevel::AVX2 &&
+            BatchEncoder::detectSimdLevel() != SimdLevel::AVX2) {
+            continue;
+        }
+        const double seconds = timeSeconds(
+            [&] { BatchEncoder::encodeBatches(batches, words, level); });
+        std::printf("%s: %.3f s (%.1f M instr/s, %.2fx, %s)\n", name, seconds,
+                    static_cast<double>(count) / seconds / 1e6,
+                    scalarSeconds / seconds,
+                    words == expected ? "identical" : "MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+/*
+ * The workload shared by the per-context and thread scaling benches, so
+ * that changing it changes both.
+ * */
+
+// 20 instructions with a label and forward/backward branches, the size of a
+// typical JIT or test harness snippet
+inline auto makeSnippet(int variant) -> std::string {
+    std::string snippet = "entry:\n";
+    for (int i{0}; i < 16; i++) {
+        const int reg = (i + variant) % 28;
+        snippet += "add x" + std::to_string(reg) + ", x" +
+                   std::to_string((reg + 1) % 28) + ", #" +
+                   std::to_string(i * 8 + variant) + "\n";
+    }
+    snippet += "cbz x1, done\nldr x2, [x3, #16]\nb entry\ndone:\nmov x0, x2\n";
+    return snippet;
+}
@@ -0,0 +1,65 @@
+#include "assembler_state.h"
+#include "branch_relaxation.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+constexpr size_t LINES_PER_LABEL = 64;
+
+// A quarter of the lines are CBZs to labels about 1MB ahead: half start just
+// in range and are pushed out as the others expand, the rest start out of
+// range. Every LINES_PER_LABEL-th line is a label.
+auto makeProgram(size_t lines) -> std::string {
+    std::string program;
+    for (size_t i{0}; i < lines; i++) {
+        if (i % LINES_PER_LABEL == 0) {
+            program.append("l").append(std::to_string(i / LINES_PER_LABEL));
+            program.append(":\n");
+        } else if (i % 4 == 1) {
+            const size_t ahead = (i % 8 == 1) ? 4000 : 4200;
+            program.append("cbz x1, l")
+                .append(std::to_string(i / LINES_PER_LABEL + ahead));
+            program.append("\n");
+        } else {
+            program += "add x2, x3, #1\n";
+        }
+    }
+    return program;
+}
+
+} // namespace
+
+// Time spent parsing (which includes relaxation) for growing programs, to
+// show that it stays linear in the number of branches:
+// branch_relaxation_bench [largest line count, default 2M]
+auto main(int argc, char *argv[]) -> int {
+    const size_t maxLines =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2'000'000;
+
+    for (size_t lines = maxLines / 8; lines <= maxLines; lines *= 2) {
+        AssemblerState state;
+        Lexer::tokenize(makeProgram(lines), state);
+
+        const auto start = std::chrono::steady_clock::now();
+        Parser::parse(state);
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        size_t expanded{0};
+        for (const auto &branch : state.relaxableBranches) {
+            expanded += branch.expanded ? 1 : 0;
+        }
+        std::printf("%9zu lines, %8zu branches (%8zu expanded): %.3f s, "
+                    "%.1f ns/line\n",
+                    lines, state.relaxableBranches.size(), expanded,
+                    elapsed.count(),
+                    elapsed.count() * 1e9 / static_cast<double>(lines));
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "disassembler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Decodes a buffer of valid words repeatedly and reports words per second
+auto main() -> int {
+    constexpr size_t WORD_COUNT = 1U << 20;
+    constexpr int ITERATIONS = 20;
+    const std::vector<uint32_t> seeds = {0x8B030041, 0x0B030041, 0x913FFC20,
+                                         0xD1004083, 0xAA0203E1, 0x529FFFE5};
+
+    std::mt19937 rng(42);
+    std::vector<uint32_t> words(WORD_COUNT);
+    for (auto &word : words) {
+        word = seeds[rng() % seeds.size()];
+    }
+    std::vector<DecodedInstruction> decoded(WORD_COUNT);
+
+    size_t validCount{0};
+    const auto start = std::chrono::steady_clock::now();
+    for (int i{0}; i < ITERATIONS; i++) {
+        Disassembler::decode(words, decoded);
+        validCount += decoded.back().valid ? 1 : 0;
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const double wordsPerSecond =
+        static_cast<double>(WORD_COUNT) * ITERATIONS / elapsed.count();
+    std::printf("decoded %zu words in %.3f s: %.1f M words/s (%zu)\n",
+                WORD_COUNT * ITERATIONS, elapsed.count(), wordsPerSecond / 1e6,
+                validCount);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "assembler_state.h"
+#include "batch_encoder.h"
+#include "lazy_assembler.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+
+namespace {
+
+constexpr size_t HELPERS = 16;
+
+// Functions of about 30 lines with a local loop, each calling one of a few
+// shared helpers, like a library a JIT would load
+auto makeLibrary(size_t bytes) -> std::string {
+    std::string library;
+    for (size_t i{0}; i < HELPERS; i++) {
+        const std::string name = std::string("helper").append(
+            std::to_string(i));
+        library.append(".global ").append(name).append("\n");
+        library.append(name).append(":\nadd x0, x0, #1\nb ")
+            .append(name).append("\n");
+    }
+    for (size_t i{0}; library.size() < bytes; i++) {
+        const std::string name = std::string("f").append(std::to_string(i));
+        library.append(".global ").append(name).append("\n");
+        library.append(name).append(":\n");
+        library.append(name).append("_loop:\n");
+        for (int line{0}; line < 6; line++) {
+            library += "mov x1, x2\nadd x3, x1, #4\nldr x4, [x3]\n"
+                       "sub x5, x4, #1\n";
+        }
+        library.append("bl helper")
+            .append(std::to_string(i % HELPERS))
+            .append("\ncbnz x5, ")
+            .append(name)
+            .append("_loop\nb ")
+            .append(name)
+            .append("\n");
+    }
+    return library;
+}
+
+template <typename Work> auto secondsFor(const Work &work) -> double {
+    const auto start = std::chrono::steady_clock::now();
+    work();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+// Time until the first function is ready, assembling the whole library
+// against indexing it and assembling one function:
+// lazy_assembly_bench [library MB, default 50]
+auto main(int argc, char *argv[]) -> int {
+    const size_t megabytes =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50;
+    const std::string library = makeLibrary(megabytes << 20U);
+
+    const double whole = secondsFor([&library] {
+        AssemblerState state;
+        Lexer::tokenize(library, state);
+        Parser::parse(state);
+        BatchEncoder::encode(state);
+    });
+    std::optional<LazyAssembler> lazy;
+    const double index = secondsFor([&] { lazy.emplace(library); });
+    const double first =
+        secondsFor([&lazy] { lazy->assembleSymbol("f1000"); });
+    const double later = secondsFor([&lazy] {
+        for (int i{0}; i < 100; i++) {
+            lazy->assembleSymbol(
+                std::string("f").append(std::to_string(2000 + i * 7)));
+        }
+    });
+    std::printf("%zu MB library\n"
+                "  whole assembly:      %8.3f s\n"
+                "  index:               %8.3f s\n"
+                "  first function:      %8.3f ms (with its helper)\n"
+                "  next 100 functions:  %8.3f ms\n",
+                megabytes, whole, index, first * 1e3, later * 1e3);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "assembler_state.h"
+#include "batch_encoder.h"
+#include "lexer.h"
+#include "linker.h"
+#include "object_file.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int RUNS = 5;
+
+// A small function that calls the next unit's and branches within itself
+auto makeUnit(size_t index, size_t units) -> std::string {
+    const std::string self = "function_" + std::to_string(index);
+    std::string unit = ".global " + self + "\n" + self + ":\n";
+    for (int i{0}; i < 12; i++) {
+        unit += "add x1, x2, #" + std::to_string(i * 8) + "\n";
+    }
+    unit += "cbz x3, " + self + "_done\nbl function_" +
+            std::to_string((index + 1) % units) + "\n" + self +
+            "_done:\nb " + self + "\n";
+    return unit;
+}
+
+} // namespace
+
+// Loading and linking many small object files as threads are added:
+// link_bench [units, default 10k] [most threads, default the hardware's]
+auto main(int argc, char *argv[]) -> int {
+    const size_t units =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000;
+
+    std::vector<std::vector<std::byte>> files;
+    AssemblerState state;
+    state.relocatable = true;
+    for (size_t i{0}; i < units; i++) {
+        state.clear();
+        Lexer::tokenize(makeUnit(i, units), state);
+        Parser::parse(state);
+        BatchEncoder::encode(state);
+        files.push_back(ObjectFile::fromState(state).serialize());
+    }
+    const std::vector<std::span<const std::byte>> objects(files.begin(),
+                                                          files.end());
+
+    const unsigned maxThreads =
+        argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10))
+                 : std::max(1U, std::thread::hardware_concurrency());
+    double single{0};
+    for (unsigned threads{1}; threads <= maxThreads; threads *= 2) {
+        double best{0};
+        size_t words{0};
+        for (int run{0}; run < RUNS; run++) {
+            const auto start = std::chrono::steady_clock::now();
+            words = Linker::link(Linker::load(objects, threads), threads)
+                        .words.size();
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            best = run == 0 ? elapsed.count() : std::min(best, elapsed.count());
+        }
+        if (threads == 1) {
+            single = best;
+        }
+        std::printf("%2u threads: %zu units, %zu words in %.2f ms (%.2fx)\n",
+                    threads, units, words, best * 1e3, single / best);
+    }
+    return 0;
+}
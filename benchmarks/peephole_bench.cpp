@@ -0,0 +1,100 @@
+#include "assembler_state.h"
+#include "batch_encoder.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr int RUNS = 5;
+
+// Code generator style output: blocks of register shuffling and arithmetic
+// where about one line in ten changes nothing or is overwritten at once
+auto makeProgram(size_t blocks) -> std::string {
+    std::string program;
+    for (size_t i{0}; i < blocks; i++) {
+        const std::string block = std::to_string(i);
+        program.append("b").append(block).append(":\n");
+        program += "mov x1, x2\nadd x3, x1, #4\nldr x4, [x3]\n"
+                   "mov x5, x4\nmov x5, #0\nsub x6, x6, #0\n"
+                   "add x7, x5, x4\nstr x7, [x3, #8]\nmov x2, x2\n"
+                   "lsl x8, x7, x1\nmov x9, #16\nadd x9, x8, x9\n"
+                   "cmp x9, #0\nmov x10, x9\neor x10, x10, x1\n"
+                   "orr x11, x10, x8\nstr x11, [x3]\nldr x12, =0x12345678\n"
+                   "add x1, x12, x11\nand x13, x1, x2\n";
+        program.append("cbnz x13, b").append(block).append("\n");
+    }
+    return program;
+}
+
+auto readProgram(const char *path) -> std::string {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error(std::string("Could not open ") + path);
+    }
+    return {std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>()};
+}
+
+struct Run {
+    double seconds;
+    size_t words;
+};
+
+// Best of RUNS full assemblies
+auto assemble(const std::string &program, bool optimize) -> Run {
+    Run best{1e30, 0};
+    for (int run{0}; run < RUNS; run++) {
+        AssemblerState state;
+        state.optimize = optimize;
+        const auto start = std::chrono::steady_clock::now();
+        Lexer::tokenize(program, state);
+        Parser::parse(state);
+        BatchEncoder::encode(state);
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = Run{std::min(best.seconds, elapsed.count()),
+                   state.machineCode.size()};
+    }
+    return best;
+}
+
+void report(const char *name, const std::string &program) {
+    const Run plain = assemble(program, false);
+    const Run optimized = assemble(program, true);
+    std::printf("%-24s %9zu -> %9zu words (-%.1f%%), %.3f -> %.3f s "
+                "(%+.1f%%)\n",
+                name, plain.words, optimized.words,
+                100.0 * static_cast<double>(plain.words - optimized.words) /
+                    static_cast<double>(std::max<size_t>(plain.words, 1)),
+                plain.seconds, optimized.seconds,
+                100.0 * (optimized.seconds - plain.seconds) / plain.seconds);
+}
+
+} // namespace
+
+// Code size and assembly time (lexing, parsing and encoding) without and
+// with -O1, for the given sources or a generated program:
+// peephole_bench [input.s...]
+auto main(int argc, char *argv[]) -> int {
+    try {
+        if (argc == 1) {
+            report("generated (2.1M lines)", makeProgram(100'000));
+        }
+        for (int i{1}; i < argc; i++) {
+            report(argv[i], readProgram(argv[i]));
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
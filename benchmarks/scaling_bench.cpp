@@ -0,0 +1,330 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Goal of the scaling harness: Catch memory or time that grows faster than
+ * the input. Runs the assembler on generated inputs of increasing size and
+ * records the wall time, the peak RSS (from getrusage) and both per source
+ * line. Fails if the cost per line grows with the input, or if its memory
+ * is worse than the checked-in baseline for the same build type and size.
+ * Wall time depends on the machine and its load, so it is only compared
+ * with the baseline under --check-time, on the machine that recorded it.
+ * Registered with CTest (label "scaling") at small sizes; the GB runs are
+ * the same harness with -DSCALING_SIZES_MB="1;64;1024;4096", and
+ * -DSCALING_CHECK_TIME=ON adds the time check.
+ * */
+
+namespace {
+
+constexpr size_t MEGABYTE = size_t{1} << 20U;
+
+struct Options {
+    std::string assembler;
+    std::string baseline;
+    std::string config{"None"};
+    std::vector<uint64_t> sizes{1, 2, 8}; // In MB
+    int repeat{1};
+    std::filesystem::path workDir{std::filesystem::current_path()};
+    bool updateBaseline{false};
+    bool checkTime{false}; // Against the baseline
+    // Vectors grow by doubling, so at some sizes the peak holds both the
+    // old and new buffer: per-line memory steps by up to half between sizes
+    double growthTolerance{1.5};
+    double memoryTolerance{1.1}; // Against the baseline
+    double timeTolerance{1.5};   // Against the baseline
+};
+
+struct Measurement {
+    uint64_t megabytes;
+    uint64_t lines;
+    double seconds;
+    uint64_t peakBytes;
+
+    [[nodiscard]] auto bytesPerLine() const -> double {
+        return static_cast<double>(this->peakBytes) /
+               static_cast<double>(this->lines);
+    }
+    [[nodiscard]] auto nanosecondsPerLine() const -> double {
+        return this->seconds * 1e9 / static_cast<double>(this->lines);
+    }
+};
+
+struct BaselineRow {
+    double bytesPerLine;
+    double nanosecondsPerLine;
+};
+
+// Build type and size in MB to the costs measured for them
+using Baseline = std::map<std::pair<std::string, uint64_t>, BaselineRow>;
+
+// Generated-looking code in blocks of eight lines: labels, branches both
+// ways, immediates, loads and literals. Returns the number of lines.
+auto generateInput(const std::filesystem::path &path, uint64_t bytes)
+    -> uint64_t {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not create " + path.string());
+    }
+    std::string chunk;
+    uint64_t written{0};
+    uint64_t block{0};
+    for (; written < bytes; block++) {
+        const std::string label = "block_" + std::to_string(block);
+        chunk.append(label).append(":\n");
+        chunk.append("add x1, x2, #").append(std::to_string(block % 4096));
+        chunk.append("\nldr x3, [x4, #16]\n");
+        chunk.append("cbz x5, block_").append(std::to_string(block + 1));
+        chunk.append("\nldr x6, =").append(std::to_string(block % 512));
+        chunk.append("\nsub w7, w8, w9\nmov x10, x11\nb ").append(label);
+        chunk.append("\n");
+        if (chunk.size() >= 64 * 1024) {
+            written += chunk.size();
+            file << chunk;
+            chunk.clear();
+        }
+    }
+    // The last block branches forward to one more label
+    chunk.append("block_").append(std::to_string(block)).append(":\n");
+    file << chunk;
+    if (!file) {
+        throw std::runtime_error("Could not write " + path.string());
+    }
+    return block * 8 + 1;
+}
+
+// Wall time and peak RSS of one run of the assembler
+auto runAssembler(const std::string &assembler,
+                  const std::filesystem::path &input,
+                  const std::filesystem::path &output)
+    -> std::pair<double, uint64_t> {
+    const auto start = std::chrono::steady_clock::now();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("Could not start the assembler");
+    }
+    if (pid == 0) {
+        execl(assembler.c_str(), assembler.c_str(), input.c_str(), "-o",
+              output.c_str(), static_cast<char *>(nullptr));
+        _exit(127);
+    }
+    int status{0};
+    rusage usage{};
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        throw std::runtime_error("Could not wait for the assembler");
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("The assembler failed on " + input.string());
+    }
+    // ru_maxrss is in kilobytes on Linux
+    return {elapsed.count(), static_cast<uint64_t>(usage.ru_maxrss) * 1024};
+}
+
+auto measure(const Options &options, uint64_t megabytes) -> Measurement {
+    const std::filesystem::path input =
+        options.workDir / ("scaling_" + std::to_string(megabytes) + "mb.s");
+    const std::filesystem::path output =
+        options.workDir / ("scaling_" + std::to_string(megabytes) + "mb.bin");
+    Measurement result{megabytes, generateInput(input, megabytes * MEGABYTE),
+                       std::numeric_limits<double>::max(),
+                       std::numeric_limits<uint64_t>::max()};
+    for (int run{0}; run < options.repeat; run++) {
+        const auto [seconds, peakBytes] =
+            runAssembler(options.assembler, input, output);
+        result.seconds = std::min(result.seconds, seconds);
+        result.peakBytes = std::min(result.peakBytes, peakBytes);
+    }
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+    return result;
+}
+
+// Lines of "<build type> <MB> <bytes per line> <ns per line>", and comments
+auto readBaseline(const std::string &path) -> Baseline {
+    Baseline baseline;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string config;
+        uint64_t megabytes{0};
+        BaselineRow row{};
+        if (!(fields >> config >> megabytes >> row.bytesPerLine >>
+              row.nanosecondsPerLine)) {
+            throw std::runtime_error("Malformed baseline line: " + line);
+        }
+        baseline[{config, megabytes}] = row;
+    }
+    return baseline;
+}
+
+void writeBaseline(const std::string &path, const Baseline &baseline) {
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not write " + path);
+    }
+    file << "# Peak RSS and wall time per source line of scaling_bench's\n"
+         << "# generated input. Rewrite with scaling_bench --update-baseline\n"
+         << "# <build type> <MB> <bytes per line> <ns per line>\n";
+    for (const auto &[key, row] : baseline) {
+        char buffer[128];
+        std::snprintf(buffer, sizeof(buffer), "%s %llu %.1f %.1f\n",
+                      key.first.c_str(),
+                      static_cast<unsigned long long>(key.second),
+                      row.bytesPerLine, row.nanosecondsPerLine);
+        file << buffer;
+    }
+}
+
+// Prints every failed check and returns whether all passed
+auto check(const Options &options, const std::vector<Measurement> &results,
+           const Baseline &baseline) -> bool {
+    bool passed = true;
+    auto fail = [&passed](const std::string &message) {
+        std::printf("FAIL: %s\n", message.c_str());
+        passed = false;
+    };
+
+    // The smallest input is mostly fixed cost, so the cost per line should
+    // only fall as the input grows
+    double leastBytes = std::numeric_limits<double>::max();
+    double leastNanoseconds = std::numeric_limits<double>::max();
+    for (const Measurement &result : results) {
+        const std::string size = std::to_string(result.megabytes) + " MB";
+        if (result.bytesPerLine() > leastBytes * options.growthTolerance) {
+            fail("memory per line grows superlinearly at " + size);
+        }
+        if (result.nanosecondsPerLine() >
+            leastNanoseconds * options.growthTolerance) {
+            fail("time per line grows superlinearly at " + size);
+        }
+        leastBytes = std::min(leastBytes, result.bytesPerLine());
+        leastNanoseconds =
+            std::min(leastNanoseconds, result.nanosecondsPerLine());
+
+        const auto row = baseline.find({options.config, result.megabytes});
+        if (row == baseline.end()) {
+            std::printf("No %s baseline for %s\n", options.config.c_str(),
+                        size.c_str());
+            continue;
+        }
+        if (result.bytesPerLine() >
+            row->second.bytesPerLine * options.memoryTolerance) {
+            fail("memory per line regressed at " + size);
+        }
+        if (options.checkTime &&
+            result.nanosecondsPerLine() >
+                row->second.nanosecondsPerLine * options.timeTolerance) {
+            fail("time per line regressed at " + size);
+        }
+    }
+    return passed;
+}
+
+auto parseSizes(const std::string &list) -> std::vector<uint64_t> {
+    std::vector<uint64_t> sizes;
+    std::istringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        sizes.push_back(std::strtoull(item.c_str(), nullptr, 10));
+        if (sizes.back() == 0) {
+            throw std::runtime_error("Invalid size: " + item);
+        }
+    }
+    std::sort(sizes.begin(), sizes.end());
+    return sizes;
+}
+
+auto parseOptions(int argc, char *argv[]) -> Options {
+    if (argc < 3) {
+        throw std::runtime_error(
+            "Usage: scaling_bench <assembler> <baseline> [--config <type>]\n"
+            "       [--sizes <MB,MB,...>] [--repeat <runs>] "
+            "[--work-dir <dir>]\n"
+            "       [--check-time] [--update-baseline]");
+    }
+    Options options;
+    options.assembler = argv[1];
+    options.baseline = argv[2];
+    for (int i{3}; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--config" && hasValue) {
+            options.config = argv[++i];
+        } else if (arg == "--sizes" && hasValue) {
+            options.sizes = parseSizes(argv[++i]);
+        } else if (arg == "--repeat" && hasValue) {
+            options.repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--work-dir" && hasValue) {
+            options.workDir = argv[++i];
+        } else if (arg == "--check-time") {
+            options.checkTime = true;
+        } else if (arg == "--update-baseline") {
+            options.updateBaseline = true;
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    if (options.config.empty()) {
+        options.config = "None";
+    }
+    return options;
+}
+
+} // namespace
+
+// Peak memory and time of the assembler as its input grows:
+// scaling_bench <assembler> <baseline> [--sizes 1,2,8] ...
+auto main(int argc, char *argv[]) -> int {
+    try {
+        const Options options = parseOptions(argc, argv);
+        std::vector<Measurement> results;
+        std::printf("%8s %10s %9s %9s %11s %9s\n", "size", "lines", "seconds",
+                    "peak MB", "bytes/line", "ns/line");
+        for (const uint64_t megabytes : options.sizes) {
+            results.push_back(measure(options, megabytes));
+            const Measurement &result = results.back();
+            std::printf("%5llu MB %10llu %9.3f %9.1f %11.1f %9.1f\n",
+                        static_cast<unsigned long long>(result.megabytes),
+                        static_cast<unsigned long long>(result.lines),
+                        result.seconds,
+                        static_cast<double>(result.peakBytes) /
+                            static_cast<double>(MEGABYTE),
+                        result.bytesPerLine(), result.nanosecondsPerLine());
+        }
+
+        Baseline baseline = readBaseline(options.baseline);
+        if (options.updateBaseline) {
+            for (const Measurement &result : results) {
+                baseline[{options.config, result.megabytes}] = BaselineRow{
+                    result.bytesPerLine(), result.nanosecondsPerLine()};
+            }
+            writeBaseline(options.baseline, baseline);
+            return 0;
+        }
+        return check(options, results, baseline) ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
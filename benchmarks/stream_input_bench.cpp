@@ -0,0 +1,93 @@
+#include "assembler_state.h"
+#include "input_stream.h"
+#include "lexer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t LINES_PER_WRITE = 4096;
+
+// A generator that formats its output a block at a time and writes each
+// block to the pipe, like a compiler piping into the assembler
+void generate(int fd, size_t lines) {
+    std::string block;
+    for (size_t line{0}; line < lines;) {
+        block.clear();
+        for (size_t i{0}; i < LINES_PER_WRITE && line < lines; i++, line++) {
+            block.append("add x").append(std::to_string(line % 30));
+            block.append(", x1, #").append(std::to_string(line % 4096));
+            block.append("\n");
+        }
+        for (size_t written{0}; written < block.size();) {
+            const ssize_t bytes =
+                write(fd, block.data() + written, block.size() - written);
+            if (bytes <= 0) {
+                std::perror("write");
+                std::exit(1);
+            }
+            written += static_cast<size_t>(bytes);
+        }
+    }
+    close(fd);
+}
+
+template <typename Consume> auto piped(size_t lines, const Consume &consume)
+    -> double {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        std::exit(1);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::thread generator(generate, fds[1], lines);
+    consume(fds[0]);
+    generator.join();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    close(fds[0]);
+    return elapsed.count();
+}
+
+} // namespace
+
+// Time from the generator starting to the tokens being ready, reading the
+// whole pipe before lexing against lexing chunks as they arrive, and the
+// input each holds in memory:
+// stream_input_bench [lines, default 4M] [chunk KiB, default 1024]
+auto main(int argc, char *argv[]) -> int {
+    const size_t lines =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+    const size_t chunkSize =
+        (argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1024) << 10U;
+
+    size_t wholeBytes{0};
+    const double whole = piped(lines, [&wholeBytes](int fd) {
+        std::string input;
+        std::string buffer(1 << 16, '\0');
+        ssize_t bytes = read(fd, buffer.data(), buffer.size());
+        while (bytes > 0) {
+            input.append(buffer.data(), static_cast<size_t>(bytes));
+            bytes = read(fd, buffer.data(), buffer.size());
+        }
+        wholeBytes = input.capacity();
+        AssemblerState state;
+        Lexer::tokenize(input, state);
+    });
+    const double streamed = piped(lines, [chunkSize](int fd) {
+        AssemblerState state;
+        InputStream input(fd, chunkSize);
+        Lexer::tokenizeStream(input, state);
+    });
+    std::printf("%zu lines\n"
+                "  read, then lex:   %.3f s, %8zu KiB of input held\n"
+                "  streamed:         %.3f s, %8zu KiB of input held\n",
+                lines, whole, wholeBytes >> 10U, streamed,
+                (2 * chunkSize) >> 10U);
+    return 0;
+}
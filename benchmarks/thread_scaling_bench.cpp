@@ -0,0 +1,70 @@
+#include "assembler_context.h"
+#include "bench_snippet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Seconds for `threads` threads to assemble `perThread` snippets each, every
+// thread with its own context
+auto runThreads(const std::vector<std::string> &snippets, unsigned threads,
+                size_t perThread) -> double {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned thread{0}; thread < threads; thread++) {
+        workers.emplace_back([&snippets, perThread, thread] {
+            AssemblerContext context;
+            size_t words{0};
+            for (size_t i{0}; i < perThread; i++) {
+                words += context
+                             .assemble(snippets[(i + thread) % snippets.size()])
+                             .size();
+            }
+            if (words == 0) {
+                std::abort(); // Keeps the work from being optimized out
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+// Throughput of concurrent assembly as threads are added, each thread
+// assembling the same number of 20-instruction snippets:
+// thread_scaling_bench [snippets per thread, default 50k]
+auto main(int argc, char *argv[]) -> int {
+    const size_t perThread =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50'000;
+    const unsigned maxThreads =
+        std::max(1U, std::thread::hardware_concurrency());
+
+    std::vector<std::string> snippets;
+    for (int variant{0}; variant < 16; variant++) {
+        snippets.push_back(makeSnippet(variant));
+    }
+
+    double singleRate{0};
+    for (unsigned threads{1}; threads <= maxThreads; threads *= 2) {
+        const double seconds = runThreads(snippets, threads, perThread);
+        const double rate =
+            static_cast<double>(perThread * threads) / seconds;
+        if (threads == 1) {
+            singleRate = rate;
+        }
+        std::printf("%2u threads: %.0f snippets/s (%.2fx)\n", threads, rate,
+                    rate / singleRate);
+    }
+    return 0;
+}
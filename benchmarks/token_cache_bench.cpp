@@ -0,0 +1,99 @@
+#include "assembler_state.h"
+#include "lexer.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include "token_cache.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int RUNS = 5;
+
+// Generated-looking code: labels, branches, immediates and loads
+auto makeProgram(size_t lines) -> std::string {
+    std::string program;
+    for (size_t i{0}; i < lines; i++) {
+        switch (i % 8) {
+        case 0:
+            program.append("block_").append(std::to_string(i / 8));
+            program.append(":\n");
+            break;
+        case 1:
+            program.append("add x1, x2, #").append(std::to_string(i % 4096));
+            program.append("\n");
+            break;
+        case 2:
+            program += "ldr x3, [x4, #16]\n";
+            break;
+        case 3:
+            program.append("cbz x5, block_").append(std::to_string(i / 8));
+            program.append("\n");
+            break;
+        case 4:
+            program += "ldr x6, =0x1122334455667788\n";
+            break;
+        default:
+            program += "sub w7, w8, w9\n";
+            break;
+        }
+    }
+    return program;
+}
+
+template <typename Load> auto bestOf(const Load &load) -> double {
+    double best = 1e30;
+    for (int run{0}; run < RUNS; run++) {
+        AssemblerState state;
+        const auto start = std::chrono::steady_clock::now();
+        load(state);
+        Parser::parse(state);
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+} // namespace
+
+// Time to get from source to parsed instructions by lexing the source
+// versus loading a mapped token cache, best of RUNS:
+// token_cache_bench [line count, default 1M]
+auto main(int argc, char *argv[]) -> int {
+    const size_t lines =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    const std::string source = makeProgram(lines);
+
+    const std::string path = "token_cache_bench.tok";
+    {
+        AssemblerState state;
+        Lexer::tokenize(source, state);
+        const std::vector<std::byte> cache = TokenCache::serialize(state);
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(cache.data()),
+                   static_cast<std::streamsize>(cache.size()));
+        std::printf("%zu lines: %zu bytes of source, %zu bytes of cache\n",
+                    lines, source.size(), cache.size());
+    }
+
+    const double fromSource = bestOf(
+        [&source](AssemblerState &state) { Lexer::tokenize(source, state); });
+    const double fromCache = bestOf([&path](AssemblerState &state) {
+        TokenCache::load(MappedFile(path).bytes(), state);
+    });
+    std::remove(path.c_str());
+
+    std::printf("lex + parse:        %.3f s, %.1f ns/line\n", fromSource,
+                fromSource * 1e9 / static_cast<double>(lines));
+    std::printf("cache load + parse: %.3f s, %.1f ns/line (%.2fx)\n",
+                fromCache, fromCache * 1e9 / static_cast<double>(lines),
+                fromSource / fromCache);
+    return 0;
+}
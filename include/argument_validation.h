@@ -1,17 +1,16 @@
 #pragma once
+#include "mnemonic.h"
 #include "token.h"
-#include <unordered_map>
-#include <vector>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <span>
 
-using ValidationRule = std::vector<TokenType>;
+using ValidationRule = std::span<const TokenType>;
 
-enum class ArgFormat {
-    REG_REG_REG,
-    REG_REG_IMM,
-    REG_IMM_REG,
-    REG_REG,
-    REG_IMM,
-};
+// ArgFormat, validationRule and mnemonicFormats are generated from
+// isa/aarch64.isa
+#include "isa_formats.h"
 
 // Specialize std::hash for ArgFormat
 namespace std {
@@ -21,25 +20,3 @@ template <> struct hash<ArgFormat> {
     }
 };
 } // namespace std
-
-const std::unordered_map<ArgFormat, ValidationRule> validationRules = {
-    {ArgFormat::REG_REG_REG,
-     ValidationRule{TokenType::Register, TokenType::Register,
-                    TokenType::Register}},
-    {ArgFormat::REG_REG_IMM,
-     ValidationRule{TokenType::Register, TokenType::Register,
-                    TokenType::Immediate}},
-    {ArgFormat::REG_IMM_REG,
-     ValidationRule{TokenType::Register, TokenType::Immediate,
-                    TokenType::Register}},
-    {ArgFormat::REG_REG,
-     ValidationRule{TokenType::Register, TokenType::Register}},
-    {ArgFormat::REG_IMM,
-     ValidationRule{TokenType::Register, TokenType::Immediate}}};
-
-const std::unordered_map<Mnemonic, std::vector<ArgFormat>> mnemonicsToFormats =
-    {{Mnemonic::ADD,
-      std::vector<ArgFormat>{ArgFormat::REG_REG_REG, ArgFormat::REG_REG_IMM,
-                             ArgFormat::REG_IMM_REG}},
-     {Mnemonic::MOV,
-      std::vector<ArgFormat>{ArgFormat::REG_REG, ArgFormat::REG_IMM}}};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "assembler_state.h"
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/*
+ * Goal of the context: Assemble many small snippets back to back without
+ * paying for allocation on each one. The state lives as long as the context,
+ * and reset() empties it while keeping every buffer, so once the buffers have
+ * grown to fit the largest snippet seen, assemble() allocates nothing (label
+ * names longer than std::string's small buffer excepted).
+ *
+ * Threading: the mnemonic, format, encoding, directive and decode tables are
+ * all constexpr, and Lexer, Parser, Encoder, BatchEncoder and Disassembler
+ * are stateless, so the only mutable data is the state a call is given.
+ * Any number of threads may assemble at once, each with its own context; a
+ * single context must not be used by two threads at the same time.
+ * */
+
+class AssemblerContext {
+  private:
+    AssemblerState state;
+
+  public:
+    // Forget the previous snippet but keep the allocated capacity
+    void reset();
+
+    // Resets, then assembles the snippet. The returned words stay valid until
+    // the next call.
+    auto assemble(std::string_view assembly) -> std::span<const uint32_t>;
+
+    [[nodiscard]] auto getState() const -> const AssemblerState &;
+};
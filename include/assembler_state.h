@@ -1,15 +1,110 @@
 #pragma once
 
+#include "expression.h"
 #include "instruction.h"
+#include "literal_pool.h"
+#include "section.h"
+#include "source_map.h"
+#include "symbol_table.h"
 #include "token.h"
 
-#include <unordered_map>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
-using LabelMap = std::unordered_map<Label, int>;
+using LabelMap = SymbolTable<LabelAddress>;
 class AssemblerState {
 
   public:
     std::vector<Token> tokens;
+    SourceMap sourceMap; // Where each line of tokens came from
     std::vector<Instruction> instructions;
     LabelMap labelToAddress;
+    // Names exported with .global, to the first token of the line naming
+    // them
+    SymbolTable<size_t> globalSymbols;
+    std::array<SectionBuffer, SECTION_COUNT> sections;
+    LiteralPools literalPools; // Values loaded by ldr xN, =value
+    Expressions expressions;   // Immediate expressions and .equ constants
+    // Tokens of the immediates whose expressions need labels
+    std::vector<size_t> deferredImmediates;
+    std::vector<uint32_t> machineCode; // Every section's words, in order
+    // Scratch for BranchRelaxer, kept so that relaxing does not allocate
+    std::vector<RelaxableBranch> relaxableBranches;
+    // Set when assembling an object file (see object_file.h): branches to
+    // labels the state does not define are encoded with a zero offset for
+    // the linker to fill in, rather than rejected. Kept by clear().
+    bool relocatable{false};
+    // Address the image is loaded at. Code only addresses itself relative
+    // to the pc, so this only shows where label addresses are used as
+    // values: in immediate expressions and in debug info. Kept by clear().
+    uint32_t loadAddress{0};
+    // Set for -O1: Parser::parse removes instructions that change nothing
+    // (see peephole.h). Kept by clear().
+    bool optimize{false};
+
+    // Error for the line holding the token, prefixed with where it is
+    [[nodiscard]] auto errorAt(size_t token, std::string_view message) const
+        -> std::runtime_error {
+        std::string located = this->sourceMap.describe(token);
+        located.append(": ").append(message);
+        return std::runtime_error(located);
+    }
+
+    [[nodiscard]] auto tokensOf(const Instruction &instruction) const
+        -> std::span<const Token> {
+        return std::span<const Token>(this->tokens)
+            .subspan(instruction.firstToken, instruction.tokenCount);
+    }
+
+    [[nodiscard]] auto section(Section section) -> SectionBuffer & {
+        return this->sections[static_cast<size_t>(section)];
+    }
+
+    [[nodiscard]] auto section(Section section) const
+        -> const SectionBuffer & {
+        return this->sections[static_cast<size_t>(section)];
+    }
+
+    // Address in the image, valid once sections are placed
+    [[nodiscard]] auto addressOf(LabelAddress label) const -> int {
+        return this->section(label.section).base + label.offset;
+    }
+
+    // Places the sections back to back, in order, from their sizes
+    void placeSections() {
+        int base = 0;
+        for (auto &section : this->sections) {
+            base = alignUp(base, section.alignment);
+            section.base = base;
+            base += section.size;
+        }
+    }
+
+    // Bytes of the image, with any gaps between sections
+    [[nodiscard]] auto imageSize() const -> int {
+        const SectionBuffer &last = this->sections.back();
+        return last.base + last.size;
+    }
+
+    // Empties everything but keeps the allocated capacity for reuse
+    void clear() {
+        this->tokens.clear();
+        this->sourceMap.clear();
+        this->instructions.clear();
+        this->labelToAddress.clear();
+        this->globalSymbols.clear();
+        for (auto &section : this->sections) {
+            section.clear();
+        }
+        this->literalPools.clear();
+        this->expressions.clear();
+        this->deferredImmediates.clear();
+        this->machineCode.clear();
+        this->relaxableBranches.clear();
+    }
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "assembler_state.h"
+#include "encoder.h"
+#include "encoding.h"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+ * Batched encoding: once instructions are resolved, every instruction sharing
+ * an InstructionEncoding and register width is built with the same shifts,
+ * so they are grouped into column-wise (SoA) batches and encoded several at
+ * a time with SIMD shifts and ORs. Each word is then written to its own
+ * offset in the output. Output is bit-identical to Encoder::encode.
+ * */
+
+// Instructions that share one InstructionEncoding and register width, stored
+// column-wise
+struct EncodingBatch {
+    std::vector<uint32_t> offsets; // Word index of each instruction
+    std::array<std::vector<uint32_t>, 3> operands;
+
+    void push(const ResolvedInstruction &resolved, uint32_t offset);
+    void clear();
+    [[nodiscard]] auto size() const -> size_t { return offsets.size(); }
+};
+
+// Batches for the X and W forms of each entry of instructionEncodings, at
+// batchIndex(entry index, is32Bit)
+using EncodingBatches =
+    std::array<EncodingBatch, instructionEncodings.size() * 2>;
+
+constexpr auto batchIndex(size_t encodingIndex, bool is32Bit) -> size_t {
+    return encodingIndex * 2 + (is32Bit ? 1 : 0);
+}
+
+enum class SimdLevel {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+class BatchEncoder {
+  public:
+    static auto detectSimdLevel() -> SimdLevel;
+    static void addInstruction(EncodingBatches &batches,
+                               const ResolvedInstruction &resolved,
+                               uint32_t offset);
+    // out must have room for the largest offset in any batch
+    static void
+    encodeBatches(const EncodingBatches &batches, std::span<uint32_t> out,
+                  SimdLevel level = BatchEncoder::detectSimdLevel());
+    static void encode(AssemblerState &assemblerState);
+};
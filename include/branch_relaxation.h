@@ -0,0 +1,40 @@
+#pragma once
+
+#include "assembler_state.h"
+#include "mnemonic.h"
+#include <optional>
+
+/*
+ * Goal of Relaxation: Give every branch a form that reaches its label.
+ * CBZ/CBNZ reach +-1MB. One that cannot reach is expanded into the inverted
+ * branch hopping over a B, which reaches +-128MB:
+ *     cbz x1, far    ->    cbnz x1, #8
+ *                          b far
+ * Expanding a branch moves everything after it, which can push other branches
+ * out of range, so this repeats until nothing changes. Branches only ever
+ * grow, so that always ends, and each round walks a compact table of the
+ * relaxable branches rather than every instruction. Branches that cannot
+ * be expanded (B, BL, JUMP, LDR literal), or whose label is in another
+ * section, are range checked by the encoder.
+ * */
+
+constexpr int EXPANDED_BRANCH_SIZE = 8;
+
+// The branch taken in the opposite case, for branches that can be expanded
+constexpr auto invertedBranch(Mnemonic mnemonic) -> std::optional<Mnemonic> {
+    switch (mnemonic) {
+    case Mnemonic::CBZ:
+        return Mnemonic::CBNZ;
+    case Mnemonic::CBNZ:
+        return Mnemonic::CBZ;
+    default:
+        return std::nullopt;
+    }
+}
+
+class BranchRelaxer {
+  public:
+    // Sets the size of each instruction and moves labels to match.
+    // Expects labels placed with every instruction 4 bytes long.
+    static void relax(AssemblerState &assemblerState);
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Helpers shared by the binary formats (token caches, object files). Values
+ * are copied in host byte order, and every read is checked against the end
+ * of the bytes, so a truncated file is an error rather than a misread.
+ * */
+
+template <typename T>
+void appendBytes(std::vector<std::byte> &out, const T &value) {
+    const size_t size = out.size();
+    out.resize(size + sizeof(T));
+    std::memcpy(out.data() + size, &value, sizeof(T));
+}
+
+// The index-th record of an array of T stored in bytes
+template <typename T>
+auto recordAt(std::span<const std::byte> records, size_t index) -> T {
+    T record;
+    std::memcpy(&record, records.data() + index * sizeof(T), sizeof(T));
+    return record;
+}
+
+// Reads the bytes front to back
+class ByteReader {
+  private:
+    std::span<const std::byte> bytes;
+    std::string_view format; // Named in errors, e.g. "Token cache"
+    size_t position{0};
+
+  public:
+    ByteReader(std::span<const std::byte> bytes, std::string_view format)
+        : bytes(bytes), format(format) {}
+
+    auto take(size_t size) -> std::span<const std::byte> {
+        if (size > this->bytes.size() - this->position) {
+            std::string message(this->format);
+            message.append(" is truncated");
+            throw std::runtime_error(message);
+        }
+        const auto taken = this->bytes.subspan(this->position, size);
+        this->position += size;
+        return taken;
+    }
+
+    template <typename T> auto read() -> T {
+        T value;
+        std::memcpy(&value, this->take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    auto readString(size_t size) -> std::string_view {
+        const auto taken = this->take(size);
+        return {reinterpret_cast<const char *>(taken.data()), size};
+    }
+
+    [[nodiscard]] auto atEnd() const -> bool {
+        return this->position == this->bytes.size();
+    }
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "assembler_state.h"
+#include <cstddef>
+#include <vector>
+
+/*
+ * Goal of DebugLine: Let a debugger map the emitted code back to its source.
+ * Produces a DWARF 4 .debug_line section from the source map (see
+ * source_map.h), with one row per instruction and one sequence per section,
+ * in a single pass over the instructions. Addresses are image addresses, so
+ * the state must be parsed (its sections placed). Literal pools are data and
+ * get no rows.
+ * */
+
+class DebugLine {
+  public:
+    static auto emit(const AssemblerState &assemblerState)
+        -> std::vector<std::byte>;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "argument_validation.h"
+#include "mnemonic.h"
+#include "token.h"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+ * Goal of Disassembling: Turn 32-bit machine words back into instructions
+ * Words are matched against a decode table built at compile time from
+ * instructionEncodings (see encoding.h), so anything the encoder can produce
+ * the disassembler can read back. Decoded instructions are plain structs so
+ * that large buffers can be decoded without allocating; they can be turned
+ * into Tokens or text afterwards.
+ * Branch targets have no name in machine code, so labels are named after the
+ * address they point to (L_<hex address>, or L_m<hex distance> before 0).
+ * */
+
+struct DecodedOperand {
+    TokenType type;
+    int val; // Register enum value, immediate value, or label byte offset
+};
+
+struct DecodedInstruction {
+    uint32_t word;
+    bool valid; // False if the word matched no known encoding
+    Mnemonic mnemonic;
+    ArgFormat format;
+    uint8_t operandCount;
+    std::array<DecodedOperand, 3> operands;
+};
+
+class Disassembler {
+  public:
+    static auto decode(uint32_t word) -> DecodedInstruction;
+    // Decodes words[i] into out[i]; out must be at least as large as words
+    static void decode(std::span<const uint32_t> words,
+                       std::span<DecodedInstruction> out);
+    static auto labelName(int address) -> std::string;
+    // pc is the address of the instruction, used to name label arguments
+    static auto toTokens(const DecodedInstruction &instruction, int pc = 0)
+        -> std::vector<Token>;
+    static auto toText(const DecodedInstruction &instruction, int pc = 0)
+        -> std::string;
+    // Source for a run of instructions starting at address 0, with a label
+    // defined at every branch target so that it can be assembled again.
+    // Targets outside the run are named in a comment at the top instead,
+    // and must be defined by whatever the listing is assembled with.
+    static auto toListing(std::span<const DecodedInstruction> instructions)
+        -> std::string;
+};
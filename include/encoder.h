@@ -0,0 +1,51 @@
+#pragma once
+
+#include "assembler_state.h"
+#include "encoding.h"
+#include "instruction.h"
+#include "token.h"
+#include <array>
+#include <cstdint>
+#include <span>
+
+/*
+ * Goal of Encoding: Turn parsed instructions into 32-bit machine words
+ * Each mnemonic instruction is looked up in instructionEncodings (see
+ * encoding.h) by its mnemonic and the argument format the parser matched, and
+ * its arguments are OR'd into the fields that entry describes.
+ * Encoding is split in two: resolving checks the arguments and turns them into
+ * raw field values (label offsets need the instruction's address), after which
+ * building the word is pure bit math.
+ * */
+
+struct ResolvedInstruction {
+    const InstructionEncoding *encoding;
+    std::array<uint32_t, 3> operands; // Field values, checked and scaled
+    bool is32Bit;
+};
+
+class Encoder {
+  public:
+    // tokens is the instruction's line, mnemonic first, and pc its address in
+    // the image (labels are looked up in assemblerState, whose sections must
+    // be placed)
+    static auto resolveInstruction(std::span<const Token> tokens,
+                                   ArgFormat format,
+                                   const AssemblerState &assemblerState,
+                                   int pc) -> ResolvedInstruction;
+    // The two instructions a branch expanded by relaxation becomes
+    static auto resolveExpandedBranch(std::span<const Token> tokens,
+                                      const AssemblerState &assemblerState,
+                                      int pc)
+        -> std::array<ResolvedInstruction, 2>;
+    // Writes a literal pool's words, instruction.size / 4 of them
+    static void encodeLiteralPool(const AssemblerState &assemblerState,
+                                  uint32_t pool, std::span<uint32_t> out);
+    static auto encodeResolved(const ResolvedInstruction &resolved)
+        -> uint32_t;
+    static auto encodeInstruction(std::span<const Token> tokens,
+                                  ArgFormat format,
+                                  const AssemblerState &assemblerState,
+                                  int pc) -> uint32_t;
+    static void encode(AssemblerState &assemblerState);
+};
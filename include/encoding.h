@@ -0,0 +1,80 @@
+#pragma once
+
+#include "argument_validation.h"
+#include "mnemonic.h"
+#include "register.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Instruction description shared by the encoder and the disassembler.
+ * Every (mnemonic, argument format) pair the assembler supports has one entry
+ * giving the fixed bits of its X register and W register forms and the bit
+ * field each argument is written to. The table itself (instructionEncodings)
+ * and the switch-based findEncoding/encodeFields are generated from
+ * isa/aarch64.isa.
+ * */
+
+enum class FieldKind : uint8_t {
+    REG,    // Register, W or X to match the instruction
+    XREG,   // Register that is always an X register
+    UIMM,   // Unsigned immediate
+    SHIFT,  // Shift amount, below the register width
+    SCALED, // Byte offset, stored divided by the register width in bytes
+    PCREL,  // Label, stored as a signed word offset from the instruction
+};
+
+struct OperandField {
+    FieldKind kind;
+    uint8_t lsb;
+    uint8_t width;
+};
+
+struct InstructionEncoding {
+    Mnemonic mnemonic;
+    ArgFormat format;
+    uint32_t base64;                    // Fixed bits of the X register form
+    uint32_t base32;                    // Fixed bits of the W register form
+    std::array<OperandField, 3> fields; // Field for each argument, in order
+    uint8_t operandCount;
+};
+
+// Generated. The table is an inline variable, so entries have one address
+// across translation units.
+#include "isa_encodings.h"
+
+constexpr auto encodingIndex(const InstructionEncoding &encoding) -> size_t {
+    return static_cast<size_t>(&encoding - instructionEncodings.data());
+}
+
+constexpr auto fieldMask(OperandField field) -> uint32_t {
+    return static_cast<uint32_t>(((1ULL << field.width) - 1ULL)
+                                 << field.lsb);
+}
+
+// Bits that must match the base for a word to be this instruction
+constexpr auto fixedBitsMask(const InstructionEncoding &encoding) -> uint32_t {
+    uint32_t mask = ~0U;
+    for (size_t i{0}; i < encoding.operandCount; i++) {
+        mask &= ~fieldMask(encoding.fields[i]);
+    }
+    return mask;
+}
+
+// log2 of the access size that SCALED fields are measured in
+constexpr auto scaleShift(bool is32Bit) -> uint32_t { return is32Bit ? 2 : 3; }
+
+constexpr auto isWRegister(Register reg) -> bool { return reg >= Register::W0; }
+
+// Register number as written into an Rd/Rn/Rm field (X32/W32 do not fit)
+constexpr auto registerNumber(Register reg) -> uint32_t {
+    const auto index = static_cast<uint32_t>(reg);
+    return isWRegister(reg) ? index - static_cast<uint32_t>(Register::W0)
+                            : index;
+}
+
+constexpr auto registerFromNumber(uint32_t number, bool is64Bit) -> Register {
+    return static_cast<Register>(
+        is64Bit ? number : number + static_cast<uint32_t>(Register::W0));
+}
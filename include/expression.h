@@ -0,0 +1,237 @@
+#pragma once
+
+#include "symbol_table.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Goal of expressions: Let immediates be computed, as in #(end - start) / 4
+ * or #TABLE_SIZE * 8.
+ * The lexer parses each expression into nodes in one arena. One that only
+ * uses numbers and constants already defined with .equ is folded on the
+ * spot and its nodes are dropped again. One that needs a label keeps its
+ * nodes and is evaluated once, after the parser has placed every label.
+ * */
+
+enum class ExpressionOp : uint8_t {
+    NUMBER,
+    SYMBOL, // A .equ constant or a label
+    NEGATE,
+    NOT,
+    MULTIPLY,
+    DIVIDE,
+    REMAINDER,
+    ADD,
+    SUBTRACT,
+    SHIFT_LEFT,
+    SHIFT_RIGHT,
+    AND,
+    XOR,
+    OR,
+};
+
+struct ExpressionNode {
+    ExpressionOp op;
+    // NUMBER: low and high halves of the value. SYMBOL: offset and size of
+    // the name. Otherwise the operand nodes (rhs is unused for unary ops).
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+class Expressions {
+  private:
+    // Nested .equ constants deeper than this are taken to be circular
+    static constexpr int MAX_CONSTANT_DEPTH = 64;
+
+    std::vector<ExpressionNode> nodes;
+    std::string names; // Names of SYMBOL nodes
+    SymbolTable<uint32_t> constants; // .equ name to its root node
+
+    auto push(ExpressionNode node) -> uint32_t;
+
+    [[nodiscard]] auto nameOf(const ExpressionNode &node) const
+        -> std::string_view {
+        return std::string_view(this->names).substr(node.lhs, node.rhs);
+    }
+
+    [[nodiscard]] static auto valueOf(const ExpressionNode &node)
+        -> int64_t {
+        return static_cast<int64_t>(static_cast<uint64_t>(node.lhs) |
+                                    (static_cast<uint64_t>(node.rhs) << 32U));
+    }
+
+    // Throws on division by zero and on shifts of 64 or more bits
+    static auto apply(ExpressionOp op, int64_t lhs, int64_t rhs) -> int64_t;
+
+    template <typename LabelValue>
+    auto evaluateNode(uint32_t index, const LabelValue &labelValue,
+                      int depth) const -> std::optional<int64_t> {
+        const ExpressionNode &node = this->nodes[index];
+        switch (node.op) {
+        case ExpressionOp::NUMBER:
+            return Expressions::valueOf(node);
+        case ExpressionOp::SYMBOL: {
+            const uint32_t *constant =
+                this->constants.find(this->nameOf(node));
+            if (constant == nullptr) {
+                return labelValue(this->nameOf(node));
+            }
+            if (depth == MAX_CONSTANT_DEPTH) {
+                throw std::runtime_error("Circular .equ definition of " +
+                                         std::string(this->nameOf(node)));
+            }
+            return this->evaluateNode(*constant, labelValue, depth + 1);
+        }
+        case ExpressionOp::NEGATE:
+        case ExpressionOp::NOT: {
+            const std::optional<int64_t> operand =
+                this->evaluateNode(node.lhs, labelValue, depth);
+            if (!operand) {
+                return std::nullopt;
+            }
+            return Expressions::apply(node.op, *operand, 0);
+        }
+        default: {
+            const std::optional<int64_t> lhs =
+                this->evaluateNode(node.lhs, labelValue, depth);
+            const std::optional<int64_t> rhs =
+                this->evaluateNode(node.rhs, labelValue, depth);
+            if (!lhs || !rhs) {
+                return std::nullopt;
+            }
+            return Expressions::apply(node.op, *lhs, *rhs);
+        }
+        }
+    }
+
+    template <size_t Sections, typename SectionOf>
+    auto labelTermsOf(uint32_t index, const SectionOf &sectionOf,
+                      int depth) const -> std::array<int64_t, Sections> {
+        const ExpressionNode &node = this->nodes[index];
+        std::array<int64_t, Sections> terms{};
+        switch (node.op) {
+        case ExpressionOp::NUMBER:
+            return terms;
+        case ExpressionOp::SYMBOL: {
+            const uint32_t *constant =
+                this->constants.find(this->nameOf(node));
+            if (constant == nullptr) {
+                terms[sectionOf(this->nameOf(node))] = 1;
+                return terms;
+            }
+            if (depth == MAX_CONSTANT_DEPTH) {
+                throw std::runtime_error("Circular .equ definition of " +
+                                         std::string(this->nameOf(node)));
+            }
+            return this->labelTermsOf<Sections>(*constant, sectionOf,
+                                                depth + 1);
+        }
+        case ExpressionOp::NEGATE:
+            terms = this->labelTermsOf<Sections>(node.lhs, sectionOf, depth);
+            for (int64_t &term : terms) {
+                term = -term;
+            }
+            return terms;
+        case ExpressionOp::NOT:
+            Expressions::checkNoLabels(
+                this->labelTermsOf<Sections>(node.lhs, sectionOf, depth));
+            return terms;
+        case ExpressionOp::ADD:
+        case ExpressionOp::SUBTRACT: {
+            terms = this->labelTermsOf<Sections>(node.lhs, sectionOf, depth);
+            const auto rhs =
+                this->labelTermsOf<Sections>(node.rhs, sectionOf, depth);
+            for (size_t i{0}; i < Sections; i++) {
+                terms[i] += node.op == ExpressionOp::ADD ? rhs[i] : -rhs[i];
+            }
+            return terms;
+        }
+        default:
+            Expressions::checkNoLabels(
+                this->labelTermsOf<Sections>(node.lhs, sectionOf, depth));
+            Expressions::checkNoLabels(
+                this->labelTermsOf<Sections>(node.rhs, sectionOf, depth));
+            return terms;
+        }
+    }
+
+    template <size_t Sections>
+    static void checkNoLabels(const std::array<int64_t, Sections> &terms) {
+        for (const int64_t term : terms) {
+            if (term != 0) {
+                throw std::runtime_error(
+                    "Label addresses can only be added and subtracted in "
+                    "a relocatable unit");
+            }
+        }
+    }
+
+  public:
+    // Where the arena ends, so that a folded expression can be dropped
+    struct Mark {
+        size_t nodes;
+        size_t names;
+    };
+
+    auto number(int64_t value) -> uint32_t;
+    auto symbol(std::string_view name) -> uint32_t;
+    auto unary(ExpressionOp op, uint32_t operand) -> uint32_t;
+    auto binary(ExpressionOp op, uint32_t lhs, uint32_t rhs) -> uint32_t;
+
+    [[nodiscard]] auto mark() const -> Mark {
+        return Mark{this->nodes.size(), this->names.size()};
+    }
+    void rewind(Mark mark);
+
+    // Returns false if the name is already a constant
+    auto define(std::string_view name, uint32_t root) -> bool;
+
+    // The arena as it is, for the token cache (see token_cache.h)
+    [[nodiscard]] auto allNodes() const -> std::span<const ExpressionNode> {
+        return this->nodes;
+    }
+    [[nodiscard]] auto allNames() const -> std::string_view {
+        return this->names;
+    }
+    template <typename Visit> void forEachConstant(const Visit &visit) const {
+        this->constants.forEach(visit);
+    }
+    // Replaces the nodes and names (constants are defined separately)
+    void load(std::span<const ExpressionNode> nodes, std::string_view names);
+
+    // Value of the expression at root, or nullopt if it needs a symbol that
+    // is neither a constant nor known to labelValue (which maps a name to
+    // an optional address)
+    template <typename LabelValue>
+    auto evaluate(uint32_t root, const LabelValue &labelValue) const
+        -> std::optional<int64_t> {
+        return this->evaluateNode(root, labelValue, 0);
+    }
+
+    // Per section (sectionOf maps a label's name to its index), how many
+    // times the expression adds the address of one of its labels, less the
+    // times it subtracts one: all zero if moving whole sections leaves the
+    // value as it is. Throws if an address goes through any other operation.
+    template <size_t Sections, typename SectionOf>
+    auto labelTerms(uint32_t root, const SectionOf &sectionOf) const
+        -> std::array<int64_t, Sections> {
+        return this->labelTermsOf<Sections>(root, sectionOf, 0);
+    }
+
+    // Value of the expression if it needs no labels
+    [[nodiscard]] auto fold(uint32_t root) const -> std::optional<int64_t> {
+        return this->evaluate(root, [](std::string_view /*name*/) {
+            return std::optional<int64_t>();
+        });
+    }
+
+    // Empties everything but keeps the allocated capacity for reuse
+    void clear();
+};
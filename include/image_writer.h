@@ -0,0 +1,63 @@
+#pragma once
+
+#include "section.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+ * Goal of the image writers: Package a flat image of machine code (from the
+ * assembler or the linker) for loading it.
+ * Every format's size is known from the image alone, so write() creates the
+ * output at its final size, maps it (see MappedOutput) and the format is
+ * written straight into it: no records are streamed and no second copy of a
+ * large image is built in memory.
+ *    - binary: the image's bytes, to be loaded at the load address
+ *    - ihex: Intel HEX, 16 data bytes per record, with an extended linear
+ * address record at the start of every 64 KiB and a start address record
+ * for _start. Bytes are turned into digits through a 256-entry table.
+ *    - elf: a static AArch64 executable, a single loadable, writable and
+ * executable segment holding the headers in its first page and the image
+ * after them. The code only addresses itself relative to the pc, so it runs
+ * at any address.
+ * */
+
+// A flat image of machine code, as the assembler or the linker lays it out
+struct Image {
+    std::vector<uint32_t> words;
+    std::array<int, SECTION_COUNT> sectionBases{}; // In bytes
+    std::optional<int> entry; // Offset of the global _start, if defined
+};
+
+enum class ImageFormat {
+    BINARY,
+    IHEX,
+    ELF,
+};
+
+// Virtual address of the ELF segment, and where its image starts within it
+constexpr uint64_t ELF_LOAD_ADDRESS = 0x400000;
+constexpr uint64_t ELF_IMAGE_OFFSET = 0x1000;
+
+class ImageWriter {
+  public:
+    // Bytes of the image in the format, for an image of imageBytes loaded
+    // at loadAddress (ihex only)
+    static auto size(ImageFormat format, size_t imageBytes,
+                     uint32_t loadAddress, bool hasEntry) -> size_t;
+
+    // Writes exactly size(...) bytes to out
+    static void binary(const Image &image, std::span<std::byte> out);
+    // Throws if the image does not fit below 4 GiB
+    static void ihex(const Image &image, uint32_t loadAddress,
+                     std::span<std::byte> out);
+    static void elf(const Image &image, std::span<std::byte> out);
+
+    // Creates the file at path holding the image in the format
+    static void write(const std::string &path, const Image &image,
+                      ImageFormat format, uint32_t loadAddress);
+};
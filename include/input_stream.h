@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Goal of InputStream: Lex input from stdin or a pipe while it is still
+ * arriving, so a generator piping into the assembler overlaps with it.
+ * A reader thread fills a ring of fixed-size chunks from the descriptor
+ * while the lexer takes the chunks already filled (see
+ * Lexer::tokenizeStream). With the default two chunks the ring is double
+ * buffered: the reader fills one while the lexer works on the other, and
+ * waits when both are full, so the input held in memory never exceeds the
+ * ring (plus any line split between chunks, which the lexer carries over).
+ * A chunk is handed over once it is full, or as soon as the descriptor has
+ * no more bytes ready, so a slow producer's lines are lexed as they arrive.
+ * The reader polls the descriptor together with an eventfd that closing
+ * the stream signals, so an error in the lexer stops it at once, even while
+ * the producer is still writing nothing.
+ * */
+
+constexpr size_t DEFAULT_CHUNK_SIZE = size_t{1} << 20;
+
+class InputStream {
+  private:
+    enum class Readiness {
+        READY,  // Bytes (or the end, or an error) can be read without waiting
+        EMPTY,  // Nothing is ready yet
+        CLOSED, // The stream was closed
+    };
+
+    int fd;
+    int wakeup; // eventfd, signalled once the stream is closed
+    std::vector<std::vector<char>> chunks;
+    std::vector<size_t> sizes; // Bytes read into each chunk
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t full{0};   // Chunks read and not yet handed back, in order
+    size_t first{0};  // The oldest of them, the lexer's
+    bool held{false}; // Whether the lexer has the first full chunk
+    bool ended{false};
+    bool closed{false}; // The lexer is done, so the reader stops
+    std::exception_ptr error;
+    std::thread reader;
+
+    void read();
+    // Waits for input or for the stream to close, unless block is false
+    auto poll(bool block) -> Readiness;
+    void fail(const std::string &message);
+
+  public:
+    // Starts reading fd, which stays open, on a new thread
+    explicit InputStream(int fd, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                         size_t chunkCount = 2);
+    // Stops the reader, even if the input was not read to its end
+    ~InputStream();
+
+    InputStream(const InputStream &) = delete;
+    auto operator=(const InputStream &) -> InputStream & = delete;
+    InputStream(InputStream &&) = delete;
+    auto operator=(InputStream &&) -> InputStream & = delete;
+
+    // Hands the previous chunk back to the reader and waits for the next.
+    // Empty at the end of the input; throws if reading failed.
+    auto next() -> std::string_view;
+};
@@ -1,11 +1,38 @@
 #pragma once
 
+#include "argument_validation.h"
+#include "section.h"
 #include "token.h"
-#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 
+// An instruction is a run of AssemblerState::tokens (one source line), stored
+// as indices so that parsing allocates nothing per instruction
 struct Instruction {
-    std::vector<Token> tokens;
+    size_t firstToken;
+    size_t tokenCount;
+    // Argument format matched during parsing (only set for mnemonics)
+    std::optional<ArgFormat> format = std::nullopt;
+    // Bytes of machine code: 0 for labels, 4 for an instruction, 8 for a
+    // branch expanded by branch relaxation and the pool's size for a literal
+    // pool
+    int size = 0;
+    Section section = Section::TEXT;
+    // Set for the literal pools the parser places between instructions (they
+    // have no format)
+    uint32_t literalPool = NO_LITERAL;
+};
+
+// A CBZ/CBNZ as seen by branch relaxation. Offsets into the branch's section
+// are as laid out before relaxation; a position's final offset is its
+// original one plus 4 bytes for every expanded branch before it.
+struct RelaxableBranch {
+    uint32_t instruction; // Index into AssemblerState::instructions
+    Section section;
+    int address;
+    int target;
+    uint32_t branchesBeforeTarget; // Relaxable branches placed before target
+    uint32_t expandedBefore;       // Expanded branches placed before this one
+    bool expanded;
 };
-inline bool operator==(const Instruction &lhs, const Instruction &rhs) {
-    return lhs.tokens == rhs.tokens;
-}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "expression.h"
+#include "source_index.h"
+#include "symbol_table.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Goal of lazy assembly: Let a JIT load a large library but only pay for the
+ * functions it calls. Construction only indexes the source (see
+ * source_index.h). The first assembleSymbol of a name lexes, parses and
+ * encodes just that symbol's lines, from its label to the next symbol's,
+ * appends the words to code() and caches the address.
+ * Symbols are the labels named by .global, or every label if there is no
+ * .global. Each body is assembled as a relocatable unit (see object_file.h)
+ * after the library's .equ/.set constants, which are lexed once. Branches to
+ * other symbols are relocations: the symbols they name are assembled too,
+ * then the branches are patched. So a body must not fall through into the
+ * next symbol, and its immediate expressions may only use differences of
+ * its own labels in one section: a label's address is not known until the
+ * body is placed, so any other use is an error, as in any relocatable unit.
+ *
+ * The source is a view, which must outlive the assembler.
+ * */
+
+struct AssembledSymbol {
+    int address; // In code(), in bytes
+    int size;    // Bytes of the symbol's body, literal pools and data
+};
+
+class LazyAssembler {
+  private:
+    std::string_view source;
+    std::string file;
+    SourceIndex index;
+    // Symbols, in source order; each runs to the start of the next
+    std::vector<SourcePosition> symbolStarts;
+    SymbolTable<size_t> symbols; // Name to index into symbolStarts
+    std::optional<Expressions> constants; // Lexed on first use
+    std::vector<uint32_t> words;
+    SymbolTable<AssembledSymbol> assembled;
+
+    // Copies the symbol's lines, with the constants blanked out (they are
+    // already defined) and a .data line first if it starts in .data
+    [[nodiscard]] auto bodyOf(size_t symbol) const -> std::string;
+    auto constantsOf() -> const Expressions &;
+
+  public:
+    // Throws if the index finds invalid or duplicate labels
+    explicit LazyAssembler(std::string_view assembly,
+                           std::string_view file = {});
+
+    // Assembles the symbol (and the symbols it branches to) on first use.
+    // Throws if it is unknown or does not assemble, leaving code() as it was.
+    auto assembleSymbol(std::string_view name) -> AssembledSymbol;
+
+    [[nodiscard]] auto code() const -> std::span<const uint32_t> {
+        return this->words;
+    }
+    [[nodiscard]] auto symbolCount() const -> size_t {
+        return this->symbolStarts.size();
+    }
+    [[nodiscard]] auto assembledCount() const -> size_t {
+        return this->assembled.size();
+    }
+};
@@ -1,47 +1,110 @@
 #pragma once
 
 #include "assembler_state.h"
+#include "expression.h"
+#include "input_stream.h"
+#include "source_index.h"
 #include "token.h"
+#include <cstdint>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <string_view>
 #include <vector>
 
+/*
+ * The lexer works on views into the source, so tokenizing allocates nothing
+ * beyond the tokens themselves (and label names too long for std::string's
+ * small buffer). It has no state of its own: everything a call produces goes
+ * into the AssemblerState passed in, so threads can tokenize concurrently as
+ * long as each uses its own state.
+ * */
+
 class Lexer {
 
   private:
-    std::unordered_map<std::string, Label> stringToLabels;
+    static auto processMnemonic(std::string_view line, const int lineNum)
+        -> Token;
+
+    // Folds the expression after # if it needs no labels
+    static auto processImmediate(std::string_view immediate,
+                                 const int lineNum, Expressions &expressions)
+        -> Token;
+
+    // Parses a whole expression into the arena, returning its root node
+    static auto processExpression(std::string_view expression,
+                                  const int lineNum, Expressions &expressions)
+        -> uint32_t;
+
+    // Operands joined by operators of at least minPrecedence, from position
+    static auto parseBinary(std::string_view expression, size_t &position,
+                            int minPrecedence, const int lineNum,
+                            Expressions &expressions) -> uint32_t;
 
-    static auto processMnemonic(const std::string &line, const int lineNum)
+    // A number, symbol, unary operation or parenthesized expression
+    static auto parseOperand(std::string_view expression, size_t &position,
+                             const int lineNum, Expressions &expressions)
+        -> uint32_t;
+
+    // .equ (or .set) NAME, expression
+    static void processConstant(std::string_view arguments, const int lineNum,
+                                Expressions &expressions);
+
+    static auto processLiteral(std::string_view literal, const int lineNum)
         -> Token;
 
-    static auto processImmediate(const std::string &immediate,
-                                 const int lineNum) -> Token;
+    // Two's complement value of a number no greater than `limit`, or no
+    // less than -negativeLimit
+    static auto parseNumber(std::string_view number, uint64_t limit,
+                            uint64_t negativeLimit, const int lineNum)
+        -> uint64_t;
 
-    static auto processRegister(const std::string &argument, const int lineNum)
+    static auto processRegister(std::string_view argument, const int lineNum)
         -> Token;
 
-    static auto processDirective(const std::string &directive,
-                                 const int lineNum) -> std::vector<Token>;
+    static void processDirective(std::string_view directive,
+                                 const int lineNum,
+                                 AssemblerState &assemblerState);
+
+    // Returns the argument starting at `start` and moves `start` past its
+    // comma (to npos after the last argument)
+    static auto nextArgument(std::string_view line, size_t &start,
+                             const int lineNum) -> std::string_view;
 
-    static auto gatherArguments(std::string &line, const size_t argStartIndex,
-                                const int lineNum) -> std::vector<std::string>;
+    static auto trimWhitespace(std::string_view line) -> std::string_view;
 
-    static auto trimWhitespace(const std::string &line) -> std::string;
+    static auto trimComments(std::string_view line) -> std::string_view;
 
-    static auto trimComments(const std::string &line) -> std::string;
+    static auto isLabelName(std::string_view name) -> bool;
 
-    auto processLabel(const std::string &line, const int lineNum) -> Token;
+    // The name of a label line (name:), which must be valid
+    static auto labelName(std::string_view line, const int lineNum)
+        -> std::string_view;
 
-    auto processArgument(const std::string &argument, const int lineNum)
+    static auto processLabel(std::string_view line, const int lineNum)
         -> Token;
 
-    auto processLine(std::string &line, const int lineNum)
-        -> std::vector<Token>;
+    static auto processArgument(std::string_view argument, const int lineNum,
+                                Expressions &expressions) -> Token;
 
-    void populateLabelsSet(std::unordered_set<Label> &labels);
+    static void processLine(std::string_view line, const int lineNum,
+                            AssemblerState &assemblerState);
+
+    // Tokenizes one line, after a newline token unless it is the input's
+    // first line, and records where it came from
+    static void addLine(std::string_view line, const int lineNum,
+                        bool firstLine, AssemblerState &assemblerState);
 
   public:
-    Lexer();
-    void tokenize(const std::string &assembly, AssemblerState &state);
+    // Lines are recorded in the state's source map as coming from file,
+    // numbered from firstLine
+    static void tokenize(std::string_view assembly, AssemblerState &state,
+                         std::string_view file = {}, int firstLine = 1);
+
+    // Tokenizes the input as its chunks arrive, lexing each line once all
+    // of it has been read (see input_stream.h)
+    static void tokenizeStream(InputStream &input, AssemblerState &state,
+                               std::string_view file = {});
+
+    // Finds the labels, .global names and .equ/.set lines by the start of
+    // each line, checking only the label and .global names
+    static void index(std::string_view assembly, SourceIndex &index);
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "image_writer.h"
+#include "object_file.h"
+#include "section.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/*
+ * Goal of the linker: Combine object files (see object_file.h) into one
+ * image without an outside toolchain.
+ * Each section of every unit is placed in unit order, all text before all
+ * data, as in a single unit's image. Work is split over threads in runs of
+ * consecutive units: loading the objects, copying their sections into the
+ * merged image, adding their globals to a symbol table sharded by name (so
+ * threads defining different names rarely wait on each other) and, once
+ * every global is known, patching the relocations of their own stretch of
+ * the image, which no other thread writes to.
+ * */
+
+class Linker {
+  public:
+    // threads = 0 uses every hardware thread
+    static auto load(std::span<const std::span<const std::byte>> objects,
+                     unsigned threads = 0) -> std::vector<ObjectFile>;
+    // Throws on undefined or duplicate globals and on relocations that are
+    // out of range of their instruction
+    static auto link(std::span<const ObjectFile> units, unsigned threads = 0)
+        -> Image;
+    // Writes the offset from pc to target into the word, throwing if it is
+    // out of range of the instruction (named by the symbol it targets)
+    static void relocate(const Relocation &relocation, int pc, int target,
+                         std::string_view name, uint32_t &word);
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "section.h"
+#include "token.h"
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+/*
+ * Goal of literal pools: Give ldr xN, =value somewhere to load value from.
+ * Each section collects its values into an open pool, sharing one entry
+ * between identical values through a hash table. The pool is written out at
+ * .ltorg, at the end of the section, or just before its first load would
+ * fall out of LDR (literal) range, in which case a B over the pool is
+ * written first so execution never runs into it.
+ * X values come first in a pool and are aligned to 8 bytes, so no load of
+ * one is unaligned. Such a pool keeps one spare word, which goes before its
+ * data or after it depending on where the pool ends up, so that moving the
+ * pool never changes its size, and its section is aligned to 8 in the image.
+ * */
+
+struct LiteralEntry {
+    uint64_t value;
+    Section section;
+    bool is64Bit;      // 8 bytes for X registers, 4 for W registers
+    // Bytes from the start of the pool's data once it is closed, and from
+    // the start of the entries of its size while it is open
+    int offset;
+    uint32_t pool;     // Index of the pool, NO_LITERAL while it is open
+};
+
+struct LiteralPool {
+    Section section;
+    int offset;    // Of the pool's first byte in its section
+    bool branchOver;
+    int size;      // Bytes, including the branch and any spare word
+    int wideBytes; // Of the X values, which come before the W values
+    uint32_t firstEntry;
+    uint32_t entryCount;
+};
+
+class LiteralPools {
+  private:
+    static constexpr int NO_DISTANCE = std::numeric_limits<int>::min() / 2;
+
+    // Entries of a section's open pool, which are not contiguous in
+    // `entries` when sections are interleaved
+    struct OpenPool {
+        std::vector<uint32_t> entries;
+        int wideBytes{0};   // Of the X values
+        int narrowBytes{0}; // Of the W values
+        // Largest (entry offset - address of its first load) among the X
+        // and the W values, which limits how far away the pool can be placed
+        int worstWide{NO_DISTANCE};
+        int worstNarrow{NO_DISTANCE};
+        int relaxableBranches{0}; // Branches since the first load
+
+        // Bytes of data, with the spare word that aligns X values
+        [[nodiscard]] auto size() const -> int {
+            return this->wideBytes + this->narrowBytes +
+                   (this->wideBytes > 0 ? 4 : 0);
+        }
+
+        void clear() {
+            this->entries.clear();
+            this->wideBytes = 0;
+            this->narrowBytes = 0;
+            this->worstWide = NO_DISTANCE;
+            this->worstNarrow = NO_DISTANCE;
+            this->relaxableBranches = 0;
+        }
+    };
+
+    std::vector<LiteralEntry> entries;
+    std::vector<uint32_t> pooledEntries; // Entry indices of each pool, in order
+    std::vector<LiteralPool> pools;
+    std::array<OpenPool, SECTION_COUNT> open;
+    std::vector<uint32_t> slots; // Dedup table: entry index + 1, 0 if empty
+    size_t usedSlots{0};
+
+    [[nodiscard]] auto slotFor(uint64_t value, Section section,
+                               bool is64Bit) const -> size_t;
+    void rehash(size_t capacity);
+
+  public:
+    // Returns the entry holding value in the section's open pool, adding
+    // one if there is none. pc is the address of the load.
+    auto add(Section section, uint64_t value, bool is64Bit, int pc)
+        -> uint32_t;
+
+    // A CBZ/CBNZ placed since the first load could later grow by 4 bytes
+    void noteRelaxableBranch(Section section);
+
+    // Whether the section's open pool must be written out before placing an
+    // instruction at pc, for its loads to stay in range
+    [[nodiscard]] auto mustFlush(Section section, int pc) const -> bool;
+
+    // Closes the section's open pool, placing it at offset. Returns its
+    // index, or NO_LITERAL if there was nothing in it. A pool with X values
+    // needs its section aligned to 8 bytes.
+    auto flush(Section section, int offset, bool branchOver) -> uint32_t;
+
+    [[nodiscard]] auto pool(uint32_t index) const -> const LiteralPool &;
+    // When the peephole pass or branch relaxation moves the code before it
+    void movePool(uint32_t index, int offset);
+
+    // Where the entry's value is, once its pool is placed
+    [[nodiscard]] auto entryLocation(uint32_t entry) const -> LabelAddress;
+    [[nodiscard]] auto entryCount() const -> size_t;
+
+    // Writes the pool's words (the branch over it, then its values) to out
+    void write(uint32_t index, uint32_t branchWord,
+               std::span<uint32_t> out) const;
+
+    // Empties everything but keeps the allocated capacity for reuse
+    void clear();
+};
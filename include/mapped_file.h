@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+/*
+ * Goal of MappedFile: Read a file without copying it. The file is mapped
+ * into memory read only, and stays mapped for as long as the object lives.
+ * */
+
+class MappedFile {
+  private:
+    const std::byte *data{nullptr};
+    size_t length{0};
+
+  public:
+    // Throws if the file cannot be opened or mapped
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    auto operator=(const MappedFile &) -> MappedFile & = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    auto operator=(MappedFile &&other) noexcept -> MappedFile &;
+
+    [[nodiscard]] auto bytes() const -> std::span<const std::byte> {
+        return {this->data, this->length};
+    }
+};
+
+/*
+ * Goal of MappedOutput: Write a file whose size is known up front in place.
+ * The file is created at its final size (with its blocks allocated, so a
+ * full disk is an error here rather than a crash while writing) and mapped
+ * writable, and is complete once the object is destroyed.
+ * */
+
+class MappedOutput {
+  private:
+    std::byte *data{nullptr};
+    size_t length{0};
+
+  public:
+    // Throws if the file cannot be created, sized or mapped
+    MappedOutput(const std::string &path, size_t size);
+    ~MappedOutput();
+
+    MappedOutput(const MappedOutput &) = delete;
+    auto operator=(const MappedOutput &) -> MappedOutput & = delete;
+    MappedOutput(MappedOutput &&) = delete;
+    auto operator=(MappedOutput &&) -> MappedOutput & = delete;
+
+    [[nodiscard]] auto bytes() const -> std::span<std::byte> {
+        return {this->data, this->length};
+    }
+};
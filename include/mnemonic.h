@@ -1,11 +1,11 @@
+#pragma once
+
+// Mnemonic, lookupMnemonic and mnemonicToString are generated from
+// isa/aarch64.isa
+#include "isa_mnemonics.h"
+
 #include <cstddef>
 #include <functional>
-enum class Mnemonic {
-    ADD,
-    MOV,
-    SUB,
-    JUMP,
-};
 
 // Specialize std::hash for Mnemonic
 namespace std {
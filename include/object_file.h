@@ -0,0 +1,77 @@
+#pragma once
+
+#include "assembler_state.h"
+#include "section.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Goal of object files: Assemble a program as separate units and combine
+ * them later with the linker (see linker.h).
+ * A unit is assembled with AssemblerState::relocatable set, so branches to
+ * labels it does not define are left for the linker. Its object file keeps
+ * each section's words apart, the symbols the linker needs and one
+ * relocation per instruction whose label the linker must place: branches to
+ * undefined labels, and branches across sections (which merging moves
+ * apart). Labels in immediate expressions are resolved within the unit, so
+ * only differences between labels of one section are allowed in them: any
+ * other use of a label's address is an error when assembling the unit.
+ * Each section keeps its alignment, which the linker places it at.
+ *
+ * Layout, in host byte order: a header, each section's words, then the
+ * symbol and relocation records, then the symbol names.
+ * */
+
+constexpr uint32_t OBJECT_FILE_VERSION = 2;
+
+enum class SymbolBinding : uint8_t {
+    LOCAL,     // Defined in the unit, visible only to its relocations
+    GLOBAL,    // Defined in the unit and exported with .global
+    UNDEFINED, // Defined by another unit
+};
+
+struct ObjectSymbol {
+    uint32_t nameOffset; // Position of the name in ObjectFile::names
+    uint32_t nameSize;
+    SymbolBinding binding;
+    Section section; // Unused for UNDEFINED
+    int offset;      // Into the section, unused for UNDEFINED
+};
+
+// The PC-relative word offset from the instruction to the symbol goes in the
+// instruction's field [lsb, lsb + width)
+struct Relocation {
+    Section section;
+    uint8_t lsb;
+    uint8_t width;
+    uint32_t offset; // Of the instruction, in bytes into its section
+    uint32_t symbol; // Index into ObjectFile::symbols
+};
+
+class ObjectFile {
+  public:
+    std::array<std::vector<uint32_t>, SECTION_COUNT> sections;
+    std::array<int, SECTION_COUNT> alignments{4, 4}; // Bytes, as SectionBuffer
+    std::vector<ObjectSymbol> symbols;
+    std::string names;
+    std::vector<Relocation> relocations;
+
+    [[nodiscard]] auto nameOf(const ObjectSymbol &symbol) const
+        -> std::string_view {
+        return std::string_view(this->names)
+            .substr(symbol.nameOffset, symbol.nameSize);
+    }
+
+    // The unit assembled into the state, which must be relocatable, parsed
+    // and encoded. Throws if it exports a name it does not define.
+    static auto fromState(const AssemblerState &assemblerState) -> ObjectFile;
+
+    [[nodiscard]] auto serialize() const -> std::vector<std::byte>;
+    // Throws if the bytes are truncated, corrupt or from another version
+    static auto load(std::span<const std::byte> bytes) -> ObjectFile;
+};
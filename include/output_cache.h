@@ -0,0 +1,63 @@
+#pragma once
+
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+/*
+ * Goal of the output cache: Skip assembling a file whose output is already
+ * known. Outputs are stored in a directory under a key hashed from the input
+ * bytes, the assembler version and the options, so a hit needs no lexing or
+ * parsing at all: the stored output is mapped and copied out.
+ * Several processes may share a directory. Each output is written to a
+ * temporary file, synced to disk and renamed into place, so readers see a
+ * whole output or none, even after a crash. Every lookup also adds one to a
+ * hit or miss counter in a fixed-size counters file, which every process
+ * using the directory maps shared and adds to atomically, so the file never
+ * grows however many lookups there are.
+ * */
+
+#ifndef ASSEMBLER_VERSION
+#define ASSEMBLER_VERSION "unknown"
+#endif
+
+struct CacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+};
+
+class OutputCache {
+  private:
+    std::filesystem::path directory;
+    CacheStats stats;
+
+  public:
+    // Creates the directory if needed
+    explicit OutputCache(std::filesystem::path directory);
+
+    // 128-bit key, as 32 hex digits. options holds every flag that changes
+    // the output.
+    static auto keyOf(std::span<const std::byte> input,
+                      std::string_view options) -> std::string;
+
+    // The stored output for key, if there is one
+    auto lookup(const std::string &key) -> std::optional<MappedFile>;
+
+    // Stores the output for key. Caching is best effort, so this returns
+    // false rather than throwing if the output could not be written.
+    auto store(const std::string &key, std::span<const std::byte> output)
+        -> bool;
+
+    // Hits and misses of this object's lookups
+    [[nodiscard]] auto sessionStats() const -> CacheStats {
+        return this->stats;
+    }
+
+    // Hits and misses of every lookup in the directory
+    [[nodiscard]] auto totalStats() const -> CacheStats;
+};
@@ -4,6 +4,7 @@
 #include "assembler_state.h"
 #include "instruction.h"
 #include "token.h"
+#include <optional>
 #include <span>
 #include <vector>
 
@@ -15,24 +16,53 @@
  *    2. Ensure that each instruction is valid (we know tokens are valid by this
  * point but doesn't neccesarily mean they form a valid instruction)
  *    3.After processing of an instruction, increment pc by 4 (in ARM64 each
- * instruction takes up 4 bytes)
- *    4. Return the new instruction (an instruction is just a vector of tokens)
+ * instruction takes up 4 bytes). Each section (.text, .data) has its own pc,
+ * and labels record the section they are in
+ *    4. Return the new instruction (an instruction is just a range of tokens)
+ *    5. Collect ldr xN, =value constants into literal pools and place the
+ * pools (see literal_pool.h)
+ *    6. With -O1, remove instructions that change nothing, which moves the
+ * labels after them (see peephole.h)
+ *    7. Relax branches that cannot reach their label, which moves the labels
+ * after them (see branch_relaxation.h), then place the sections
+ *    8. Fill in the immediates whose expressions use labels (see
+ * expression.h), now that every label has its address
  * */
 
 class Parser {
   private:
-    int pc; // program counter - used to track the number of bytes taken up by
-            // assembly so far
-    auto parseInstruction(std::vector<Token> &tokens, LabelMap &labelMap)
-        -> Instruction;
-    auto parseDirectiveInstruction(const std::vector<Token> &tokens);
+    // Parses the tokens [lineStart, lineEnd), returning the section that
+    // following lines go to
+    static auto parseLine(AssemblerState &assemblerState, size_t lineStart,
+                          size_t lineEnd, Section section) -> Section;
+    // pc (program counter) tracks the bytes taken up by assembly so far in
+    // the current section
+    static auto parseInstruction(std::span<const Token> tokens,
+                                 LabelMap &labelMap, Section section, int &pc)
+        -> std::optional<ArgFormat>;
+    // Returns the section that following lines go to
+    static auto parseDirective(std::span<const Token> tokens, Section section)
+        -> Section;
+    // Puts the literal of the ldr =value at tokens[token] into the pool
+    static void addLiteral(AssemblerState &assemblerState, size_t token,
+                           Section section, int pc);
+    // Places the section's open literal pool (if not empty) at the
+    // section's current end, as an instruction of the given tokens
+    static void placeLiteralPool(AssemblerState &assemblerState,
+                                 Section section, size_t firstToken,
+                                 size_t tokenCount, bool branchOver);
+    // Evaluates the immediates whose expressions need labels, once every
+    // label is placed
+    static void resolveImmediates(AssemblerState &assemblerState);
+    // In a relocatable unit, throws unless the expression's value stays the
+    // same wherever the linker puts each section (see object_file.h)
+    static void checkRelocatable(const AssemblerState &assemblerState,
+                                 size_t token, uint32_t expression);
     static auto validateMnemonicArguments(Mnemonic mnemonic,
                                           const std::span<const Token> &args)
-        -> bool;
-    static auto gatherValidationRules(const std::vector<ArgFormat> &formats)
-        -> std::vector<ValidationRule>;
+        -> std::optional<ArgFormat>;
 
   public:
-    Parser();
-    void parse(AssemblerState &assemblerState);
+    // Every parse starts at address 0; all state lives in assemblerState
+    static void parse(AssemblerState &assemblerState);
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "argument_validation.h"
+#include "assembler_state.h"
+#include "mnemonic.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Goal of the peephole pass: Remove instructions that change nothing, with
+ * -O1 (AssemblerState::optimize). A window of two instructions slides over
+ * the program, matched against pattern tables generated from
+ * isa/aarch64.isa:
+ *    - noop patterns match one instruction that leaves every register as it
+ *      was (mov x1, x1 or add x2, x2, #0), which is removed
+ *    - overwrite patterns match two instructions in a row writing the same
+ *      register, the second without reading it (mov x1, x2 then mov x1, #3),
+ *      and the first is removed
+ * Labels and literal pools end a window, since code can branch to them.
+ * It runs in Parser::parse once labels and literal pools are placed, before
+ * branch relaxation. Each label and pool moves back by the bytes removed
+ * before it in its section as the window passes it, so the layout is fixed
+ * up in the same single pass. Code only shrinks, so every load stays in
+ * reach of its pool. Removed instructions are still checked by the encoder,
+ * so -O1 rejects the same programs as -O0.
+ * */
+
+enum class PatternArgument : uint8_t {
+    DESTINATION, // The first argument's X register
+    ZERO,        // An immediate 0
+    ANY,
+};
+
+struct NoopPattern {
+    Mnemonic mnemonic;
+    ArgFormat format;
+    std::array<PatternArgument, 3> arguments;
+    uint8_t argumentCount;
+};
+
+// Generated: noopPatterns, findNoopPattern and isOverwrite
+#include "isa_peepholes.h"
+
+class Peephole {
+  public:
+    // Removes the instructions the patterns match and moves the labels,
+    // literal pools and section sizes to match. Expects labels placed with
+    // every instruction 4 bytes long. Returns the number removed.
+    static auto optimize(AssemblerState &assemblerState) -> size_t;
+};
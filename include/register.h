@@ -1,5 +1,8 @@
+#pragma once
+
 enum class Register {
     // X registers
+    X0,
     X1,
     X2,
     X3,
@@ -34,6 +37,7 @@ enum class Register {
     X32,
 
     // W registers
+    W0,
     W1,
     W2,
     W3,
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Output sections. Each has its own location counter and output buffer, so
+ * switching between them with .text/.data costs nothing and their contents
+ * never need sorting apart. Sections are placed one after another, in enum
+ * order, in the flat image (AssemblerState::machineCode), each at a multiple
+ * of its alignment with zero words in any gap.
+ * */
+
+enum class Section : uint8_t {
+    TEXT,
+    DATA,
+};
+
+constexpr size_t SECTION_COUNT = 2;
+
+struct SectionBuffer {
+    int size{0}; // Bytes, known once parsing (and relaxation) is done
+    int base{0}; // Address of the section's first byte in the image
+    int alignment{4}; // Of base, 8 once it holds an X literal
+    std::vector<uint32_t> words; // Encoded contents
+
+    void clear() {
+        this->size = 0;
+        this->base = 0;
+        this->alignment = 4;
+        this->words.clear();
+    }
+};
+
+// The first multiple of alignment at or after value
+template <typename T>
+constexpr auto alignUp(T value, T alignment) -> T {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Where a label points: an offset into a section, which becomes an address
+// once sections are placed
+struct LabelAddress {
+    Section section;
+    int offset;
+
+    auto operator==(const LabelAddress &other) const -> bool = default;
+};
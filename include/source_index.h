@@ -0,0 +1,30 @@
+#pragma once
+
+#include "section.h"
+#include "symbol_table.h"
+#include <cstddef>
+#include <vector>
+
+/*
+ * Where the labels, exported names and constants of a source are, found by
+ * Lexer::index from the start of each line without lexing the rest of it.
+ * Used to assemble a source one symbol at a time (see lazy_assembler.h).
+ * */
+
+struct SourcePosition {
+    size_t offset; // Of the first byte of the line
+    int line;
+    Section section; // In effect at the line
+};
+
+struct SourceIndex {
+    SymbolTable<SourcePosition> labels;
+    SymbolTable<int> globals; // Names exported with .global, to the line
+    std::vector<SourcePosition> constants; // .equ and .set lines, in order
+
+    void clear() {
+        this->labels.clear();
+        this->globals.clear();
+        this->constants.clear();
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Goal of the source map: Know where each line of tokens came from without
+ * storing a position in every Token. The lexer records one entry per line
+ * that produced tokens, holding the index of its first token and its file,
+ * line and column, and an instruction is found through its firstToken.
+ * Entries are delta encoded: a typical line (the next line of the same
+ * file, one more token line down, in the same column as the last) takes a
+ * single byte. Every CHECKPOINT_INTERVAL entries the full position is kept
+ * as well, so a lookup decodes at most that many entries.
+ * */
+
+struct SourceLocation {
+    uint32_t file{0};
+    int line{0}; // 1-based, 0 if unknown
+    int column{0};
+};
+
+class SourceMap {
+  private:
+    static constexpr size_t CHECKPOINT_INTERVAL = 64;
+
+    struct Entry {
+        size_t firstToken{0};
+        SourceLocation location;
+    };
+
+    struct Checkpoint {
+        size_t offset; // Of the entry after this one in `encoded`
+        Entry entry;
+    };
+
+    std::vector<uint8_t> encoded;
+    std::vector<Checkpoint> checkpoints;
+    std::string fileNames;           // All names, back to back
+    std::vector<uint32_t> fileEnds;  // End of each name in fileNames
+    uint32_t currentFile{0};
+    size_t entryCount{0};
+    Entry last; // The most recent entry, which the next is relative to
+
+    // Decodes the entry at offset, relative to previous, and moves offset
+    // past it
+    static auto decode(std::span<const uint8_t> encoded, size_t &offset,
+                       const Entry &previous) -> Entry;
+
+  public:
+    // Walks the entries in order, for lookups of increasing tokens
+    class Cursor {
+      private:
+        const SourceMap *map;
+        size_t offset{0};
+        Entry current;
+        Entry next;
+        bool hasNext{false};
+
+        void advance();
+
+      public:
+        explicit Cursor(const SourceMap &map);
+        auto locate(size_t token) -> SourceLocation;
+    };
+
+    // Later lines belong to this file until the next call
+    auto addFile(std::string_view name) -> uint32_t;
+    void addLine(size_t firstToken, int line, int column);
+
+    // Where the line holding the token is (the last line for tokens past
+    // the end)
+    [[nodiscard]] auto locate(size_t token) const -> SourceLocation;
+    [[nodiscard]] auto fileName(uint32_t file) const -> std::string_view;
+    [[nodiscard]] auto fileCount() const -> size_t {
+        return this->fileEnds.size();
+    }
+    // "file:line:column", or "line N, column C" for an unnamed file
+    [[nodiscard]] auto describe(size_t token) const -> std::string;
+
+    // The delta-encoded entries, e.g. for the token cache
+    [[nodiscard]] auto bytes() const -> std::span<const uint8_t> {
+        return this->encoded;
+    }
+    [[nodiscard]] auto size() const -> size_t { return this->entryCount; }
+    // Replaces the map with saved entries, which are checked as they are
+    // decoded. Names are the files' names, in order.
+    void load(std::span<const uint8_t> bytes,
+              std::span<const std::string_view> names);
+
+    // Empties everything but keeps the allocated capacity for reuse
+    void clear();
+};
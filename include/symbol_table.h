@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * Hash table from names to values, used for labels.
+ * Names are copied into one shared character arena and entries live in a
+ * flat, linearly probed slot array, so clear() keeps every buffer and
+ * refilling a cleared table with as many names allocates nothing.
+ * */
+
+template <typename Value> class SymbolTable {
+  private:
+    struct Slot {
+        size_t hash;
+        uint32_t nameOffset; // Position of the name in `names`
+        uint32_t nameSize;
+        bool used;
+        Value value;
+    };
+
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    std::vector<Slot> slots; // Size is zero or a power of two
+    std::string names;
+    size_t count{0};
+
+    [[nodiscard]] auto nameOf(const Slot &slot) const -> std::string_view {
+        return std::string_view(this->names)
+            .substr(slot.nameOffset, slot.nameSize);
+    }
+
+    // Slot holding `name`, or the empty slot where it would go
+    [[nodiscard]] auto probe(std::string_view name, size_t hash) const
+        -> size_t {
+        const size_t mask = this->slots.size() - 1;
+        size_t index = hash & mask;
+        while (this->slots[index].used &&
+               (this->slots[index].hash != hash ||
+                this->nameOf(this->slots[index]) != name)) {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    void grow() {
+        std::vector<Slot> old(
+            std::max(MIN_CAPACITY, this->slots.size() * 2));
+        old.swap(this->slots);
+        for (const Slot &slot : old) {
+            if (slot.used) {
+                this->slots[this->probe(this->nameOf(slot), slot.hash)] = slot;
+            }
+        }
+    }
+
+  public:
+    // Returns false (and keeps the old value) if the name is already present
+    auto insert(std::string_view name, const Value &value) -> bool {
+        if ((this->count + 1) * 2 > this->slots.size()) {
+            this->grow();
+        }
+        const size_t hash = std::hash<std::string_view>()(name);
+        Slot &slot = this->slots[this->probe(name, hash)];
+        if (slot.used) {
+            return false;
+        }
+        slot = Slot{hash, static_cast<uint32_t>(this->names.size()),
+                    static_cast<uint32_t>(name.size()), true, value};
+        this->names.append(name);
+        this->count++;
+        return true;
+    }
+
+    [[nodiscard]] auto find(std::string_view name) const -> const Value * {
+        if (this->count == 0) {
+            return nullptr;
+        }
+        const Slot &slot = this->slots[this->probe(
+            name, std::hash<std::string_view>()(name))];
+        return slot.used ? &slot.value : nullptr;
+    }
+
+    auto find(std::string_view name) -> Value * {
+        return const_cast<Value *>(std::as_const(*this).find(name));
+    }
+
+    [[nodiscard]] auto contains(std::string_view name) const -> bool {
+        return this->find(name) != nullptr;
+    }
+
+    [[nodiscard]] auto at(std::string_view name) const -> const Value & {
+        const Value *value = this->find(name);
+        if (value == nullptr) {
+            throw std::out_of_range("Symbol not found: " + std::string(name));
+        }
+        return *value;
+    }
+
+    [[nodiscard]] auto size() const -> size_t { return this->count; }
+
+    // Calls visit(name, value) for every entry, in no particular order
+    template <typename Visit> void forEach(const Visit &visit) const {
+        for (const Slot &slot : this->slots) {
+            if (slot.used) {
+                visit(this->nameOf(slot), slot.value);
+            }
+        }
+    }
+
+    [[nodiscard]] auto empty() const -> bool { return this->count == 0; }
+
+    // Forgets every name but keeps the slot array and the name arena
+    void clear() {
+        for (Slot &slot : this->slots) {
+            slot.used = false;
+        }
+        this->names.clear();
+        this->count = 0;
+    }
+};
@@ -3,6 +3,7 @@
 #include "mnemonic.h"
 #include "register.h"
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <variant>
@@ -11,6 +12,7 @@ enum class Directive {
     GLOBAL,
     DATA,
     TEXT,
+    LTORG,
 };
 
 struct Label {
@@ -27,8 +29,22 @@ template <> struct hash<Label> {
 };
 } // namespace std
 
+constexpr uint32_t NO_EXPRESSION = UINT32_MAX;
+
 struct Immediate {
     int val;
+    // Root node of an expression that needs labels (see expression.h),
+    // whose value the parser fills in once they are placed
+    uint32_t expression = NO_EXPRESSION;
+};
+
+constexpr uint32_t NO_LITERAL = UINT32_MAX;
+
+// =value in ldr xN, =value: a constant loaded from a literal pool
+struct Literal {
+    uint64_t val; // Two's complement for negative values
+    // Pool entry holding the value, filled in by the parser
+    uint32_t entry = NO_LITERAL;
 };
 
 enum class TokenType {
@@ -37,13 +53,16 @@ enum class TokenType {
     Directive,
     Label,
     Immediate,
+    Literal,
+    LeftBracket,
+    RightBracket,
     Newline,
 };
 
 struct Token {
     TokenType type;
     std::variant<std::monostate, Mnemonic, Register, Directive, Label,
-                 Immediate>
+                 Immediate, Literal>
         token;
 
     // Factory Methods to create Tokens
@@ -67,6 +86,18 @@ struct Token {
         return Token{TokenType::Immediate, immediate};
     }
 
+    static Token createLiteral(Literal literal) {
+        return Token{TokenType::Literal, literal};
+    }
+
+    static Token createLeftBracket() {
+        return Token{TokenType::LeftBracket, std::monostate()};
+    }
+
+    static Token createRightBracket() {
+        return Token{TokenType::RightBracket, std::monostate()};
+    }
+
     static Token createNewline() {
         return Token{TokenType::Newline, std::monostate()};
     }
@@ -78,6 +109,11 @@ inline bool operator==(const Label &lhs, const Label &rhs) {
 }
 
 inline bool operator==(const Immediate &lhs, const Immediate &rhs) {
+    return lhs.val == rhs.val && lhs.expression == rhs.expression;
+}
+
+// The pool entry is left out, since it is not part of what was written
+inline bool operator==(const Literal &lhs, const Literal &rhs) {
     return lhs.val == rhs.val;
 }
 
@@ -108,6 +144,15 @@ inline std::ostream &operator<<(std::ostream &os, const Token &token) {
     case TokenType::Immediate:
         os << "Immediate: " << std::get<Immediate>(token.token).val;
         break;
+    case TokenType::Literal:
+        os << "Literal: " << std::get<Literal>(token.token).val;
+        break;
+    case TokenType::LeftBracket:
+        os << "LeftBracket";
+        break;
+    case TokenType::RightBracket:
+        os << "RightBracket";
+        break;
     case TokenType::Newline:
         os << "Newline";
     }
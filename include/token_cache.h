@@ -0,0 +1,42 @@
+#pragma once
+
+#include "assembler_state.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+ * Goal of the token cache: Assemble generated source many times without
+ * lexing it each time. The tokens are saved in a compact binary form along
+ * with the label string table, the arena of immediate expressions and the
+ * source map, and loading a cache (usually from a MappedFile) replaces
+ * Lexer::tokenize before Parser::parse.
+ *
+ * Layout, in host byte order: a header, then the tokens, each a type byte
+ * and one to eight bytes of payload, then the expression nodes, the .equ
+ * constants, the label table and the files, then the names, and finally
+ * the source map (see source_map.h). Each name is stored once however often
+ * it is used.
+ * The cache is tied to the ISA its assembler was built with, so the header
+ * holds the format version and the number of mnemonics, and a mismatch is an
+ * error rather than a misread.
+ * */
+
+// Bump whenever the layout or the meaning of a record changes
+constexpr uint32_t TOKEN_CACHE_VERSION = 2;
+
+class TokenCache {
+  public:
+    // Saves the tokens (and expressions) of the state. Values the parser
+    // fills in (literal pool entries, label dependent immediates) are
+    // recomputed when the cache is parsed, so the state may be parsed or
+    // not.
+    static auto serialize(const AssemblerState &assemblerState)
+        -> std::vector<std::byte>;
+
+    // Clears the state and fills it as Lexer::tokenize would have. Throws
+    // if the cache is truncated, corrupt or from another version.
+    static void load(std::span<const std::byte> cache,
+                     AssemblerState &assemblerState);
+};
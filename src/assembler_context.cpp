@@ -0,0 +1,19 @@
+#include "assembler_context.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+
+void AssemblerContext::reset() { this->state.clear(); }
+
+auto AssemblerContext::assemble(std::string_view assembly)
+    -> std::span<const uint32_t> {
+    this->reset();
+    Lexer::tokenize(assembly, this->state);
+    Parser::parse(this->state);
+    Encoder::encode(this->state);
+    return this->state.machineCode;
+}
+
+auto AssemblerContext::getState() const -> const AssemblerState & {
+    return this->state;
+}
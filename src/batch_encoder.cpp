@@ -0,0 +1,207 @@
+#include "batch_encoder.h"
+#include "branch_relaxation.h"
+#include "encoder.h"
+#include "encoding.h"
+#include "token.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BATCH_ENCODER_X86 1
+#endif
+
+namespace {
+
+// Computes one batch into out[offsets[i]], starting from index `first`
+void encodeScalar(const InstructionEncoding &encoding, uint32_t base,
+                  const EncodingBatch &batch, size_t first,
+                  std::span<uint32_t> out) {
+    for (size_t i{first}; i < batch.size(); i++) {
+        uint32_t word = base;
+        for (size_t field{0}; field < encoding.operandCount; field++) {
+            word |= batch.operands[field][i] << encoding.fields[field].lsb;
+        }
+        out[batch.offsets[i]] = word;
+    }
+}
+
+#ifdef BATCH_ENCODER_X86
+
+// There is no scatter store before AVX-512, so lanes are written one by one
+template <size_t LANES>
+void scatter(const std::array<uint32_t, LANES> &words,
+             const uint32_t *offsets, std::span<uint32_t> out) {
+    for (size_t lane{0}; lane < LANES; lane++) {
+        out[offsets[lane]] = words[lane];
+    }
+}
+
+void encodeSse2(const InstructionEncoding &encoding, uint32_t batchBase,
+                const EncodingBatch &batch, std::span<uint32_t> out) {
+    constexpr size_t LANES = 4;
+    const __m128i base = _mm_set1_epi32(static_cast<int>(batchBase));
+    std::array<uint32_t, LANES> words{};
+    size_t i{0};
+    for (; i + LANES <= batch.size(); i += LANES) {
+        __m128i word = base;
+        for (size_t field{0}; field < encoding.operandCount; field++) {
+            const __m128i operand = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(&batch.operands[field][i]));
+            word = _mm_or_si128(
+                word, _mm_sll_epi32(operand, _mm_cvtsi32_si128(
+                                                 encoding.fields[field].lsb)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(words.data()), word);
+        scatter(words, &batch.offsets[i], out);
+    }
+    encodeScalar(encoding, batchBase, batch, i, out);
+}
+
+__attribute__((target("avx2"))) void
+encodeAvx2(const InstructionEncoding &encoding, uint32_t batchBase,
+           const EncodingBatch &batch, std::span<uint32_t> out) {
+    constexpr size_t LANES = 8;
+    const __m256i base = _mm256_set1_epi32(static_cast<int>(batchBase));
+    std::array<uint32_t, LANES> words{};
+    size_t i{0};
+    for (; i + LANES <= batch.size(); i += LANES) {
+        __m256i word = base;
+        for (size_t field{0}; field < encoding.operandCount; field++) {
+            const __m256i operand = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(&batch.operands[field][i]));
+            word = _mm256_or_si256(
+                word, _mm256_sll_epi32(operand,
+                                       _mm_cvtsi32_si128(
+                                           encoding.fields[field].lsb)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words.data()), word);
+        scatter(words, &batch.offsets[i], out);
+    }
+    encodeScalar(encoding, batchBase, batch, i, out);
+}
+
+#endif
+
+} // namespace
+
+void EncodingBatch::push(const ResolvedInstruction &resolved,
+                         uint32_t offset) {
+    this->offsets.push_back(offset);
+    for (size_t field{0}; field < resolved.encoding->operandCount; field++) {
+        this->operands[field].push_back(resolved.operands[field]);
+    }
+}
+
+void EncodingBatch::clear() {
+    this->offsets.clear();
+    for (auto &column : this->operands) {
+        column.clear();
+    }
+}
+
+auto BatchEncoder::detectSimdLevel() -> SimdLevel {
+#ifdef BATCH_ENCODER_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE2; // Always available on x86-64
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+void BatchEncoder::addInstruction(EncodingBatches &batches,
+                                  const ResolvedInstruction &resolved,
+                                  uint32_t offset) {
+    batches[batchIndex(encodingIndex(*resolved.encoding), resolved.is32Bit)]
+        .push(resolved, offset);
+}
+
+void BatchEncoder::encodeBatches(const EncodingBatches &batches,
+                                 std::span<uint32_t> out, SimdLevel level) {
+    for (size_t i{0}; i < batches.size(); i++) {
+        const InstructionEncoding &encoding = instructionEncodings[i / 2];
+        const bool is32Bit = i != batchIndex(i / 2, false);
+        const uint32_t base = is32Bit ? encoding.base32 : encoding.base64;
+        const EncodingBatch &batch = batches[i];
+        switch (level) {
+#ifdef BATCH_ENCODER_X86
+        case SimdLevel::AVX2:
+            encodeAvx2(encoding, base, batch, out);
+            break;
+        case SimdLevel::SSE2:
+            encodeSse2(encoding, base, batch, out);
+            break;
+#else
+        case SimdLevel::AVX2:
+        case SimdLevel::SSE2:
+#endif
+        case SimdLevel::SCALAR:
+            encodeScalar(encoding, base, batch, 0, out);
+            break;
+        }
+    }
+}
+
+void BatchEncoder::encode(AssemblerState &assemblerState) {
+    // Words are scattered straight to their place in the image, each section
+    // filling its own range, which is then copied to the section's buffer
+    EncodingBatches batches;
+    const auto start = static_cast<uint32_t>(assemblerState.machineCode.size());
+    std::array<uint32_t, SECTION_COUNT> offsets{};
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        offsets[i] = start + static_cast<uint32_t>(
+                                 assemblerState.sections[i].base / 4);
+    }
+    assemblerState.machineCode.resize(
+        start + static_cast<size_t>(assemblerState.imageSize() / 4));
+
+    for (const auto &instruction : assemblerState.instructions) {
+        uint32_t &offset = offsets[static_cast<size_t>(instruction.section)];
+        if (instruction.literalPool != NO_LITERAL) {
+            // Pools are data, written as they are
+            const auto words = static_cast<size_t>(instruction.size / 4);
+            Encoder::encodeLiteralPool(
+                assemblerState, instruction.literalPool,
+                std::span<uint32_t>(assemblerState.machineCode)
+                    .subspan(offset, words));
+            offset += static_cast<uint32_t>(words);
+            continue;
+        }
+        if (!instruction.format) {
+            continue; // Labels take up no space
+        }
+        const auto tokens = assemblerState.tokensOf(instruction);
+        const auto pc = static_cast<int>((offset - start) * 4);
+        try {
+            if (instruction.size == EXPANDED_BRANCH_SIZE) {
+                for (const auto &resolved : Encoder::resolveExpandedBranch(
+                         tokens, assemblerState, pc)) {
+                    BatchEncoder::addInstruction(batches, resolved, offset++);
+                }
+                continue;
+            }
+            BatchEncoder::addInstruction(
+                batches,
+                Encoder::resolveInstruction(tokens, *instruction.format,
+                                            assemblerState, pc),
+                offset);
+        } catch (const std::runtime_error &error) {
+            throw assemblerState.errorAt(instruction.firstToken, error.what());
+        }
+        offset++;
+    }
+
+    BatchEncoder::encodeBatches(batches, assemblerState.machineCode);
+
+    for (auto &section : assemblerState.sections) {
+        const auto first = assemblerState.machineCode.begin() + start +
+                           section.base / 4;
+        section.words.assign(first, first + section.size / 4);
+    }
+}
@@ -0,0 +1,140 @@
+#include "branch_relaxation.h"
+#include "instruction.h"
+#include "section.h"
+#include "token.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+constexpr int SHORT_BRANCH_REACH = 1 << 18; // Words, for a 19-bit offset
+
+// Orders the table by section, then by offset within it
+auto branchBefore(const RelaxableBranch &branch, Section section, int address)
+    -> bool {
+    return std::tie(branch.section, branch.address) <
+           std::tie(section, address);
+}
+
+void findRelaxableBranches(const AssemblerState &assemblerState,
+                           std::vector<RelaxableBranch> &branches) {
+    branches.clear();
+    for (size_t section{0}; section < SECTION_COUNT; section++) {
+        int pc = 0;
+        for (size_t i{0}; i < assemblerState.instructions.size(); i++) {
+            const Instruction &instruction = assemblerState.instructions[i];
+            if (static_cast<size_t>(instruction.section) != section) {
+                continue;
+            }
+            const auto tokens = assemblerState.tokensOf(instruction);
+            if (instruction.format &&
+                invertedBranch(std::get<Mnemonic>(tokens[0].token))) {
+                // Undefined labels are left for the encoder to report, as
+                // are labels in other sections, which relaxation can't move
+                const LabelAddress *target =
+                    assemblerState.labelToAddress.find(
+                        std::get<Label>(tokens.back().token).val);
+                if (target != nullptr &&
+                    target->section == instruction.section) {
+                    branches.push_back(RelaxableBranch{
+                        static_cast<uint32_t>(i), instruction.section, pc,
+                        target->offset, 0, 0, false});
+                }
+            }
+            pc += instruction.size;
+        }
+    }
+
+    // The table is sorted, so it is its own search index
+    for (auto &branch : branches) {
+        branch.branchesBeforeTarget = static_cast<uint32_t>(
+            std::lower_bound(branches.begin(), branches.end(), branch,
+                             [](const RelaxableBranch &other,
+                                const RelaxableBranch &search) {
+                                 return branchBefore(other, search.section,
+                                                     search.target);
+                             }) -
+            branches.begin());
+    }
+}
+
+// Expands every short branch that cannot reach its target with the current
+// layout. Returns whether any branch was expanded.
+auto expandOutOfRange(std::vector<RelaxableBranch> &branches,
+                      std::array<uint32_t, SECTION_COUNT> &expanded) -> bool {
+    expanded.fill(0);
+    for (auto &branch : branches) {
+        uint32_t &sectionExpanded =
+            expanded[static_cast<size_t>(branch.section)];
+        branch.expandedBefore = sectionExpanded;
+        sectionExpanded += branch.expanded ? 1 : 0;
+    }
+
+    bool changed = false;
+    for (auto &branch : branches) {
+        if (branch.expanded) {
+            continue;
+        }
+        // A target after the section's last branch follows all of them
+        const size_t after = branch.branchesBeforeTarget;
+        const uint32_t expandedBeforeTarget =
+            after < branches.size() && branches[after].section == branch.section
+                ? branches[after].expandedBefore
+                : expanded[static_cast<size_t>(branch.section)];
+        const int64_t address =
+            branch.address + 4 * static_cast<int64_t>(branch.expandedBefore);
+        const int64_t target =
+            branch.target + 4 * static_cast<int64_t>(expandedBeforeTarget);
+        const int64_t offset = (target - address) / 4;
+        if (offset < -SHORT_BRANCH_REACH || offset >= SHORT_BRANCH_REACH) {
+            branch.expanded = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+void BranchRelaxer::relax(AssemblerState &assemblerState) {
+    std::vector<RelaxableBranch> &branches = assemblerState.relaxableBranches;
+    findRelaxableBranches(assemblerState, branches);
+
+    // Expanding only ever moves targets further away, so a branch found out
+    // of range with a stale count of expansions stays out of range
+    std::array<uint32_t, SECTION_COUNT> expanded{};
+    bool anyExpanded = false;
+    while (expandOutOfRange(branches, expanded)) {
+        anyExpanded = true;
+    }
+    if (!anyExpanded) {
+        return;
+    }
+
+    for (const auto &branch : branches) {
+        if (branch.expanded) {
+            assemblerState.instructions[branch.instruction].size =
+                EXPANDED_BRANCH_SIZE;
+            assemblerState.section(branch.section).size +=
+                EXPANDED_BRANCH_SIZE - 4;
+        }
+    }
+
+    // One pass to move the labels and literal pools to their final offsets
+    std::array<int, SECTION_COUNT> pcs{};
+    for (const Instruction &instruction : assemblerState.instructions) {
+        int &pc = pcs[static_cast<size_t>(instruction.section)];
+        if (instruction.literalPool != NO_LITERAL) {
+            assemblerState.literalPools.movePool(instruction.literalPool, pc);
+        } else if (!instruction.format) {
+            const auto &label =
+                std::get<Label>(assemblerState.tokensOf(instruction)[0].token);
+            assemblerState.labelToAddress.find(label.val)->offset = pc;
+        }
+        pc += instruction.size;
+    }
+}
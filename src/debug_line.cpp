@@ -0,0 +1,211 @@
+#include "debug_line.h"
+#include "source_map.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Line program parameters, as written to the header
+constexpr uint16_t DWARF_VERSION = 4;
+constexpr uint8_t MIN_INSTRUCTION_LENGTH = 4;
+constexpr int8_t LINE_BASE = -5;
+constexpr uint8_t LINE_RANGE = 14;
+constexpr uint8_t OPCODE_BASE = 13;
+constexpr std::array<uint8_t, OPCODE_BASE - 1> STANDARD_OPCODE_LENGTHS = {
+    0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1};
+
+// Standard and extended opcodes
+constexpr uint8_t DW_LNS_COPY = 1;
+constexpr uint8_t DW_LNS_ADVANCE_PC = 2;
+constexpr uint8_t DW_LNS_ADVANCE_LINE = 3;
+constexpr uint8_t DW_LNS_SET_FILE = 4;
+constexpr uint8_t DW_LNS_SET_COLUMN = 5;
+constexpr uint8_t DW_LNE_END_SEQUENCE = 1;
+constexpr uint8_t DW_LNE_SET_ADDRESS = 2;
+
+void appendByte(std::vector<std::byte> &out, unsigned value) {
+    out.push_back(static_cast<std::byte>(value));
+}
+
+void appendUleb(std::vector<std::byte> &out, uint64_t value) {
+    while (value >= 0x80) {
+        appendByte(out, static_cast<unsigned>((value & 0x7FU) | 0x80U));
+        value >>= 7U;
+    }
+    appendByte(out, static_cast<unsigned>(value));
+}
+
+void appendSleb(std::vector<std::byte> &out, int64_t value) {
+    while (true) {
+        const auto byte = static_cast<unsigned>(value & 0x7F);
+        value >>= 7; // Arithmetic, so the sign is kept
+        if ((value == 0 && (byte & 0x40U) == 0) ||
+            (value == -1 && (byte & 0x40U) != 0)) {
+            appendByte(out, byte);
+            return;
+        }
+        appendByte(out, byte | 0x80U);
+    }
+}
+
+template <typename T> void appendFixed(std::vector<std::byte> &out, T value) {
+    const size_t size = out.size();
+    out.resize(size + sizeof(T));
+    std::memcpy(out.data() + size, &value, sizeof(T)); // Little endian
+}
+
+void appendExtended(std::vector<std::byte> &out, uint8_t opcode,
+                    std::initializer_list<std::byte> operands) {
+    appendByte(out, 0);
+    appendUleb(out, 1 + operands.size());
+    appendByte(out, opcode);
+    out.insert(out.end(), operands.begin(), operands.end());
+}
+
+// The line program of one section, built up row by row
+class Sequence {
+  private:
+    std::vector<std::byte> program;
+    uint64_t address{0};
+    int line{1};
+    int column{0};
+    uint32_t file{1};
+    bool started{false};
+
+    void setAddress(uint64_t newAddress) {
+        std::array<std::byte, 8> bytes{};
+        std::memcpy(bytes.data(), &newAddress, sizeof(newAddress));
+        appendExtended(this->program, DW_LNE_SET_ADDRESS,
+                       {bytes[0], bytes[1], bytes[2], bytes[3], bytes[4],
+                        bytes[5], bytes[6], bytes[7]});
+        this->address = newAddress;
+    }
+
+    void advanceTo(uint64_t newAddress) {
+        if (newAddress != this->address) {
+            appendByte(this->program, DW_LNS_ADVANCE_PC);
+            appendUleb(this->program,
+                       (newAddress - this->address) / MIN_INSTRUCTION_LENGTH);
+            this->address = newAddress;
+        }
+    }
+
+  public:
+    void addRow(uint64_t rowAddress, const SourceLocation &location) {
+        if (!this->started) {
+            this->setAddress(rowAddress);
+            this->started = true;
+        }
+        if (location.file + 1 != this->file) {
+            this->file = location.file + 1; // DWARF counts files from 1
+            appendByte(this->program, DW_LNS_SET_FILE);
+            appendUleb(this->program, this->file);
+        }
+        if (location.column != this->column) {
+            this->column = location.column;
+            appendByte(this->program, DW_LNS_SET_COLUMN);
+            appendUleb(this->program, static_cast<uint64_t>(this->column));
+        }
+
+        int64_t lineDelta = location.line - this->line;
+        this->line = location.line;
+        if (lineDelta < LINE_BASE || lineDelta >= LINE_BASE + LINE_RANGE) {
+            appendByte(this->program, DW_LNS_ADVANCE_LINE);
+            appendSleb(this->program, lineDelta);
+            lineDelta = 0;
+        }
+        // A special opcode advances both the address and the line, and
+        // appends the row, in one byte
+        uint64_t operations =
+            (rowAddress - this->address) / MIN_INSTRUCTION_LENGTH;
+        const uint64_t lineOperand =
+            static_cast<uint64_t>(lineDelta - LINE_BASE) + OPCODE_BASE;
+        if (lineOperand + LINE_RANGE * operations > 255) {
+            this->advanceTo(rowAddress);
+            operations = 0;
+        }
+        appendByte(this->program, static_cast<unsigned>(
+                                      lineOperand + LINE_RANGE * operations));
+        this->address = rowAddress;
+    }
+
+    // Ends the sequence after the section's last byte
+    void finish(uint64_t endAddress, std::vector<std::byte> &out) {
+        if (!this->started) {
+            return;
+        }
+        this->advanceTo(endAddress);
+        appendExtended(this->program, DW_LNE_END_SEQUENCE, {});
+        out.insert(out.end(), this->program.begin(), this->program.end());
+    }
+};
+
+} // namespace
+
+auto DebugLine::emit(const AssemblerState &assemblerState)
+    -> std::vector<std::byte> {
+    const SourceMap &sourceMap = assemblerState.sourceMap;
+
+    // Everything after header_length, up to the line program
+    std::vector<std::byte> header;
+    appendByte(header, MIN_INSTRUCTION_LENGTH);
+    appendByte(header, 1); // maximum_operations_per_instruction
+    appendByte(header, 1); // default_is_stmt
+    appendByte(header, static_cast<uint8_t>(LINE_BASE));
+    appendByte(header, LINE_RANGE);
+    appendByte(header, OPCODE_BASE);
+    for (const uint8_t length : STANDARD_OPCODE_LENGTHS) {
+        appendByte(header, length);
+    }
+    appendByte(header, 0); // No include directories
+    for (uint32_t file{0}; file < sourceMap.fileCount(); file++) {
+        std::string_view name = sourceMap.fileName(file);
+        if (name.empty()) {
+            name = "<input>";
+        }
+        const auto *bytes = reinterpret_cast<const std::byte *>(name.data());
+        header.insert(header.end(), bytes, bytes + name.size());
+        appendByte(header, 0);
+        appendUleb(header, 0); // Directory
+        appendUleb(header, 0); // Modification time
+        appendUleb(header, 0); // Length
+    }
+    appendByte(header, 0);
+
+    // One pass over the instructions, each row going to its section's
+    // sequence
+    std::array<Sequence, SECTION_COUNT> sequences;
+    std::array<uint64_t, SECTION_COUNT> addresses{};
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        addresses[i] = assemblerState.loadAddress +
+                       static_cast<uint64_t>(assemblerState.sections[i].base);
+    }
+    SourceMap::Cursor cursor(sourceMap);
+    for (const Instruction &instruction : assemblerState.instructions) {
+        const auto section = static_cast<size_t>(instruction.section);
+        if (instruction.format) {
+            sequences[section].addRow(addresses[section],
+                                      cursor.locate(instruction.firstToken));
+        }
+        addresses[section] += static_cast<uint64_t>(instruction.size);
+    }
+    std::vector<std::byte> program;
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        sequences[i].finish(addresses[i], program);
+    }
+
+    std::vector<std::byte> out;
+    const auto unitLength = static_cast<uint32_t>(
+        sizeof(uint16_t) + sizeof(uint32_t) + header.size() + program.size());
+    appendFixed(out, unitLength);
+    appendFixed(out, DWARF_VERSION);
+    appendFixed(out, static_cast<uint32_t>(header.size()));
+    out.insert(out.end(), header.begin(), header.end());
+    out.insert(out.end(), program.begin(), program.end());
+    return out;
+}
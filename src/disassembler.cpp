@@ -0,0 +1,294 @@
+#include "disassembler.h"
+#include "encoding.h"
+#include "token.h"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// One bit pattern to match: the X or W form of an instruction encoding
+struct DecodePattern {
+    uint32_t base;
+    uint32_t mask;
+    uint8_t encoding; // Index into instructionEncodings
+    bool is32Bit;
+};
+
+constexpr size_t MAX_PATTERNS = instructionEncodings.size() * 2;
+
+struct DecodePatterns {
+    std::array<DecodePattern, MAX_PATTERNS> patterns;
+    size_t size;
+};
+
+// Instructions without registers have one form; encodings that produce the
+// same words as an earlier one (ADD REG_IMM_REG) are never decoded
+constexpr auto buildDecodePatterns() -> DecodePatterns {
+    DecodePatterns result{};
+    for (size_t i{0}; i < instructionEncodings.size(); i++) {
+        const InstructionEncoding &encoding = instructionEncodings[i];
+        for (const bool is32Bit : {false, true}) {
+            if (is32Bit && encoding.base32 == encoding.base64) {
+                continue;
+            }
+            const DecodePattern pattern{
+                is32Bit ? encoding.base32 : encoding.base64,
+                fixedBitsMask(encoding), static_cast<uint8_t>(i), is32Bit};
+            bool duplicate = false;
+            for (size_t j{0}; j < result.size; j++) {
+                duplicate = duplicate ||
+                            (result.patterns[j].base == pattern.base &&
+                             result.patterns[j].mask == pattern.mask);
+            }
+            if (!duplicate) {
+                result.patterns[result.size++] = pattern;
+            }
+        }
+    }
+    return result;
+}
+
+constexpr DecodePatterns decodePatterns = buildDecodePatterns();
+
+// Words are bucketed by bits [31:21], which hold the opcode of every
+// supported encoding, so a lookup only checks a couple of candidates
+constexpr uint32_t INDEX_SHIFT = 21;
+constexpr size_t INDEX_SIZE = 1U << 11;
+constexpr size_t MAX_CANDIDATES = 4;
+constexpr uint8_t NO_CANDIDATE = 0xFF;
+
+using DecodeSlot = std::array<uint8_t, MAX_CANDIDATES>;
+
+// Candidates in a slot are ordered most fixed bits first, so aliases such as
+// MOV (ORR with XZR) win over the general instruction
+constexpr auto buildDecodeTable() -> std::array<DecodeSlot, INDEX_SIZE> {
+    std::array<DecodeSlot, INDEX_SIZE> table{};
+    for (auto &slot : table) {
+        slot.fill(NO_CANDIDATE);
+    }
+
+    for (size_t i{0}; i < decodePatterns.size; i++) {
+        const DecodePattern &pattern = decodePatterns.patterns[i];
+        const uint32_t indexMask = pattern.mask >> INDEX_SHIFT;
+        for (size_t index{0}; index < INDEX_SIZE; index++) {
+            if (((index ^ (pattern.base >> INDEX_SHIFT)) & indexMask) != 0) {
+                continue;
+            }
+            DecodeSlot &slot = table[index];
+            if (slot.back() != NO_CANDIDATE) {
+                throw std::logic_error("Too many candidates in decode slot");
+            }
+            size_t position{0};
+            while (slot[position] != NO_CANDIDATE &&
+                   std::popcount(decodePatterns.patterns[slot[position]]
+                                     .mask) >= std::popcount(pattern.mask)) {
+                position++;
+            }
+            for (size_t j{MAX_CANDIDATES - 1}; j > position; j--) {
+                slot[j] = slot[j - 1];
+            }
+            slot[position] = static_cast<uint8_t>(i);
+        }
+    }
+    return table;
+}
+
+constexpr std::array<DecodeSlot, INDEX_SIZE> decodeTable = buildDecodeTable();
+
+auto registerToString(Register reg) -> std::string {
+    return (isWRegister(reg) ? "w" : "x") + std::to_string(registerNumber(reg));
+}
+
+auto operandToToken(const DecodedOperand &operand, int pc) -> Token {
+    switch (operand.type) {
+    case TokenType::Register:
+        return Token::createRegister(static_cast<Register>(operand.val));
+    case TokenType::Label:
+        return Token::createLabel(
+            Label{Disassembler::labelName(pc + operand.val)});
+    default:
+        return Token::createImmediate(Immediate{operand.val});
+    }
+}
+
+} // namespace
+
+auto Disassembler::decode(uint32_t word) -> DecodedInstruction {
+    DecodedInstruction decoded{};
+    decoded.word = word;
+
+    for (const uint8_t candidate : decodeTable[word >> INDEX_SHIFT]) {
+        if (candidate == NO_CANDIDATE) {
+            break;
+        }
+        const DecodePattern &pattern = decodePatterns.patterns[candidate];
+        if ((word & pattern.mask) != pattern.base) {
+            continue;
+        }
+
+        const InstructionEncoding &encoding =
+            instructionEncodings[pattern.encoding];
+        decoded.valid = true;
+        decoded.mnemonic = encoding.mnemonic;
+        decoded.format = encoding.format;
+        decoded.operandCount = encoding.operandCount;
+        for (size_t i{0}; i < encoding.operandCount; i++) {
+            const OperandField field = encoding.fields[i];
+            const uint32_t bits = (word & fieldMask(field)) >> field.lsb;
+            DecodedOperand &operand = decoded.operands[i];
+            switch (field.kind) {
+            case FieldKind::REG:
+            case FieldKind::XREG:
+                operand.type = TokenType::Register;
+                operand.val = static_cast<int>(registerFromNumber(
+                    bits, field.kind == FieldKind::XREG || !pattern.is32Bit));
+                break;
+            case FieldKind::UIMM:
+            case FieldKind::SHIFT:
+                operand.type = TokenType::Immediate;
+                operand.val = static_cast<int>(bits);
+                break;
+            case FieldKind::SCALED:
+                operand.type = TokenType::Immediate;
+                operand.val =
+                    static_cast<int>(bits << scaleShift(pattern.is32Bit));
+                break;
+            case FieldKind::PCREL: {
+                // Sign extend the word offset, then convert it to bytes
+                const uint32_t signBit = 1U << (field.width - 1);
+                operand.type = TokenType::Label;
+                operand.val = (static_cast<int>(bits ^ signBit) -
+                               static_cast<int>(signBit)) *
+                              4;
+                break;
+            }
+            }
+        }
+        return decoded;
+    }
+    return decoded;
+}
+
+void Disassembler::decode(std::span<const uint32_t> words,
+                          std::span<DecodedInstruction> out) {
+    if (out.size() < words.size()) {
+        throw std::runtime_error("Disassembly output buffer is too small");
+    }
+    for (size_t i{0}; i < words.size(); i++) {
+        out[i] = Disassembler::decode(words[i]);
+    }
+}
+
+auto Disassembler::labelName(int address) -> std::string {
+    // Targets before address 0 are named by their distance, as L_m<hex>
+    std::array<char, 16> name{};
+    std::snprintf(name.data(), name.size(), address < 0 ? "L_m%llx" : "L_%llx",
+                  static_cast<unsigned long long>(
+                      address < 0 ? -int64_t{address} : int64_t{address}));
+    return name.data();
+}
+
+auto Disassembler::toTokens(const DecodedInstruction &instruction, int pc)
+    -> std::vector<Token> {
+    if (!instruction.valid) {
+        throw std::runtime_error("Cannot tokenize an undecodable word");
+    }
+    std::vector<Token> tokens{Token::createMnemonic(instruction.mnemonic)};
+    size_t operand{0};
+    for (const TokenType type : validationRule(instruction.format)) {
+        if (type == TokenType::LeftBracket) {
+            tokens.push_back(Token::createLeftBracket());
+        } else if (type == TokenType::RightBracket) {
+            tokens.push_back(Token::createRightBracket());
+        } else {
+            tokens.push_back(
+                operandToToken(instruction.operands[operand++], pc));
+        }
+    }
+    return tokens;
+}
+
+auto Disassembler::toText(const DecodedInstruction &instruction, int pc)
+    -> std::string {
+    if (!instruction.valid) {
+        std::array<char, 16> hex{};
+        std::snprintf(hex.data(), hex.size(), "0x%08x", instruction.word);
+        return std::string(".word ") + hex.data();
+    }
+    std::string text(mnemonicToString(instruction.mnemonic));
+    text += " ";
+    bool needsSeparator = false;
+    for (const Token &token : Disassembler::toTokens(instruction, pc)) {
+        switch (token.type) {
+        case TokenType::Mnemonic:
+            continue;
+        case TokenType::RightBracket:
+            text += "]";
+            continue;
+        default:
+            break;
+        }
+        if (needsSeparator) {
+            text += ", ";
+        }
+        needsSeparator = token.type != TokenType::LeftBracket;
+        switch (token.type) {
+        case TokenType::LeftBracket:
+            text += "[";
+            break;
+        case TokenType::Register:
+            text += registerToString(std::get<Register>(token.token));
+            break;
+        case TokenType::Label:
+            text += std::get<Label>(token.token).val;
+            break;
+        default:
+            text += "#" + std::to_string(std::get<Immediate>(token.token).val);
+            break;
+        }
+    }
+    return text;
+}
+
+auto Disassembler::toListing(std::span<const DecodedInstruction> instructions)
+    -> std::string {
+    std::set<int> targets;
+    for (size_t i{0}; i < instructions.size(); i++) {
+        for (size_t j{0}; j < instructions[i].operandCount; j++) {
+            const DecodedOperand &operand = instructions[i].operands[j];
+            if (instructions[i].valid && operand.type == TokenType::Label) {
+                targets.insert(static_cast<int>(i * 4) + operand.val);
+            }
+        }
+    }
+
+    // Labels are only defined inside the run, so targets outside it are
+    // named up front for whoever assembles the listing to define
+    std::string listing;
+    const auto end = static_cast<int>(instructions.size() * 4);
+    for (const int target : targets) {
+        if (target < 0 || target > end) {
+            listing += "; " + Disassembler::labelName(target) +
+                       " is outside this listing\n";
+        }
+    }
+    for (size_t i{0}; i <= instructions.size(); i++) {
+        const auto pc = static_cast<int>(i * 4);
+        if (targets.contains(pc)) {
+            listing += Disassembler::labelName(pc) + ":\n";
+        }
+        if (i < instructions.size()) {
+            listing += Disassembler::toText(instructions[i], pc) + "\n";
+        }
+    }
+    return listing;
+}
@@ -0,0 +1,253 @@
+#include "encoder.h"
+#include "branch_relaxation.h"
+#include "encoding.h"
+#include "instruction.h"
+#include "token.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+auto checkField(OperandField field, uint32_t value) -> uint32_t {
+    if ((value >> field.width) != 0) {
+        throw std::runtime_error("Value " + std::to_string(value) +
+                                 " does not fit in a " +
+                                 std::to_string(field.width) + "-bit field");
+    }
+    return value;
+}
+
+auto checkImmediate(OperandField field, int val, bool is32Bit) -> uint32_t {
+    if (val < 0) {
+        throw std::runtime_error("Negative immediate " + std::to_string(val) +
+                                 " cannot be encoded");
+    }
+    auto value = static_cast<uint32_t>(val);
+    switch (field.kind) {
+    case FieldKind::SHIFT:
+        if (value >= (is32Bit ? 32U : 64U)) {
+            throw std::runtime_error("Shift amount " + std::to_string(val) +
+                                     " is not below the register width");
+        }
+        break;
+    case FieldKind::SCALED: {
+        const uint32_t shift = scaleShift(is32Bit);
+        if ((value & ((1U << shift) - 1U)) != 0) {
+            throw std::runtime_error("Offset " + std::to_string(val) +
+                                     " is not a multiple of " +
+                                     std::to_string(1U << shift));
+        }
+        value >>= shift;
+        break;
+    }
+    default:
+        break;
+    }
+    return checkField(field, value);
+}
+
+auto checkLabelOffset(OperandField field, const Label &label,
+                      const AssemblerState &assemblerState, int pc)
+    -> uint32_t {
+    const LabelAddress *address =
+        assemblerState.labelToAddress.find(label.val);
+    if (address == nullptr) {
+        if (assemblerState.relocatable) {
+            return 0; // Relocated by the linker (see object_file.h)
+        }
+        throw std::runtime_error("Undefined label: " + label.val);
+    }
+    const int offset = (assemblerState.addressOf(*address) - pc) / 4;
+    const int limit = 1 << (field.width - 1);
+    if (offset < -limit || offset >= limit) {
+        throw std::runtime_error("Label " + label.val +
+                                 " is out of range of the instruction");
+    }
+    return static_cast<uint32_t>(offset) & (fieldMask(field) >> field.lsb);
+}
+
+auto checkLiteralOffset(OperandField field, const Literal &literal,
+                        const AssemblerState &assemblerState, int pc)
+    -> uint32_t {
+    const int offset = (assemblerState.addressOf(
+                            assemblerState.literalPools.entryLocation(
+                                literal.entry)) -
+                        pc) /
+                       4;
+    const int limit = 1 << (field.width - 1);
+    if (offset < -limit || offset >= limit) {
+        throw std::runtime_error("Literal pool is out of range of the load");
+    }
+    return static_cast<uint32_t>(offset) & (fieldMask(field) >> field.lsb);
+}
+
+} // namespace
+
+void Encoder::encode(AssemblerState &assemblerState) {
+    // Each section is encoded into its own buffer, then the buffers are
+    // joined into the image
+    for (const auto &instruction : assemblerState.instructions) {
+        SectionBuffer &section = assemblerState.section(instruction.section);
+        const auto pc = static_cast<int>(section.base +
+                                         section.words.size() * 4);
+        if (instruction.literalPool != NO_LITERAL) {
+            section.words.resize(section.words.size() +
+                                 static_cast<size_t>(instruction.size / 4));
+            Encoder::encodeLiteralPool(
+                assemblerState, instruction.literalPool,
+                std::span<uint32_t>(section.words)
+                    .last(static_cast<size_t>(instruction.size / 4)));
+            continue;
+        }
+        if (!instruction.format) {
+            continue; // Labels take up no space
+        }
+        const auto tokens = assemblerState.tokensOf(instruction);
+        try {
+            if (instruction.size == EXPANDED_BRANCH_SIZE) {
+                for (const auto &resolved : Encoder::resolveExpandedBranch(
+                         tokens, assemblerState, pc)) {
+                    section.words.push_back(Encoder::encodeResolved(resolved));
+                }
+            } else {
+                section.words.push_back(Encoder::encodeInstruction(
+                    tokens, *instruction.format, assemblerState, pc));
+            }
+        } catch (const std::runtime_error &error) {
+            throw assemblerState.errorAt(instruction.firstToken, error.what());
+        }
+    }
+
+    // Zero words fill any gap before an aligned section
+    const size_t start = assemblerState.machineCode.size();
+    for (const auto &section : assemblerState.sections) {
+        assemblerState.machineCode.resize(
+            start + static_cast<size_t>(section.base / 4));
+        assemblerState.machineCode.insert(assemblerState.machineCode.end(),
+                                          section.words.begin(),
+                                          section.words.end());
+    }
+}
+
+auto Encoder::encodeInstruction(std::span<const Token> tokens,
+                                ArgFormat format,
+                                const AssemblerState &assemblerState, int pc)
+    -> uint32_t {
+    return Encoder::encodeResolved(
+        Encoder::resolveInstruction(tokens, format, assemblerState, pc));
+}
+
+auto Encoder::resolveInstruction(std::span<const Token> tokens,
+                                 ArgFormat format,
+                                 const AssemblerState &assemblerState, int pc)
+    -> ResolvedInstruction {
+    const Mnemonic mnemonic = std::get<Mnemonic>(tokens[0].token);
+    const InstructionEncoding *encoding = findEncoding(mnemonic, format);
+    if (encoding == nullptr) {
+        throw std::runtime_error(
+            "No encoding for mnemonic and argument format");
+    }
+
+    // Brackets only shape the syntax, each remaining argument fills a field
+    std::array<const Token *, 3> args{};
+    size_t argCount{0};
+    for (const Token &token : tokens.subspan(1)) {
+        if (token.type != TokenType::LeftBracket &&
+            token.type != TokenType::RightBracket && argCount < args.size()) {
+            args[argCount++] = &token;
+        }
+    }
+
+    // Registers decide the width first, since immediates may depend on it
+    ResolvedInstruction resolved{encoding, {}, false};
+    std::optional<bool> is32Bit;
+    for (size_t i{0}; i < encoding->operandCount; i++) {
+        const OperandField field = encoding->fields[i];
+        if (field.kind != FieldKind::REG && field.kind != FieldKind::XREG) {
+            continue;
+        }
+        const auto reg = std::get<Register>(args[i]->token);
+        if (field.kind == FieldKind::XREG) {
+            if (isWRegister(reg)) {
+                throw std::runtime_error("Expected an X register as base");
+            }
+        } else {
+            if (is32Bit && *is32Bit != isWRegister(reg)) {
+                throw std::runtime_error(
+                    "Cannot mix W and X registers in one instruction");
+            }
+            is32Bit = isWRegister(reg);
+        }
+        resolved.operands[i] = checkField(field, registerNumber(reg));
+    }
+    resolved.is32Bit = is32Bit.value_or(false);
+
+    for (size_t i{0}; i < encoding->operandCount; i++) {
+        const OperandField field = encoding->fields[i];
+        if (args[i]->type == TokenType::Immediate) {
+            resolved.operands[i] =
+                checkImmediate(field, std::get<Immediate>(args[i]->token).val,
+                               resolved.is32Bit);
+        } else if (args[i]->type == TokenType::Label) {
+            resolved.operands[i] = checkLabelOffset(
+                field, std::get<Label>(args[i]->token), assemblerState, pc);
+        } else if (args[i]->type == TokenType::Literal) {
+            resolved.operands[i] = checkLiteralOffset(
+                field, std::get<Literal>(args[i]->token), assemblerState, pc);
+        }
+    }
+    return resolved;
+}
+
+auto Encoder::resolveExpandedBranch(std::span<const Token> tokens,
+                                    const AssemblerState &assemblerState,
+                                    int pc)
+    -> std::array<ResolvedInstruction, 2> {
+    const Mnemonic mnemonic = std::get<Mnemonic>(tokens[0].token);
+    const std::optional<Mnemonic> inverted = invertedBranch(mnemonic);
+    if (!inverted) {
+        throw std::runtime_error("Branch cannot be expanded");
+    }
+
+    // The inverted branch skips over the B when the original is not taken
+    const InstructionEncoding *skip =
+        findEncoding(*inverted, ArgFormat::REG_LABEL);
+    const auto reg = std::get<Register>(tokens[1].token);
+    const ResolvedInstruction skipResolved{
+        skip,
+        {checkField(skip->fields[0], registerNumber(reg)),
+         EXPANDED_BRANCH_SIZE / 4, 0},
+        isWRegister(reg)};
+
+    const InstructionEncoding *branch =
+        findEncoding(Mnemonic::B, ArgFormat::LABEL);
+    const ResolvedInstruction branchResolved{
+        branch,
+        {checkLabelOffset(branch->fields[0],
+                          std::get<Label>(tokens.back().token),
+                          assemblerState, pc + 4),
+         0, 0},
+        false};
+    return {skipResolved, branchResolved};
+}
+
+void Encoder::encodeLiteralPool(const AssemblerState &assemblerState,
+                                uint32_t pool, std::span<uint32_t> out) {
+    // The branch (if any) jumps to the first word after the pool
+    const InstructionEncoding *branch =
+        findEncoding(Mnemonic::B, ArgFormat::LABEL);
+    const auto words =
+        static_cast<uint32_t>(assemblerState.literalPools.pool(pool).size / 4);
+    assemblerState.literalPools.write(
+        pool, Encoder::encodeResolved({branch, {words, 0, 0}, false}), out);
+}
+
+auto Encoder::encodeResolved(const ResolvedInstruction &resolved) -> uint32_t {
+    return encodeFields(encodingIndex(*resolved.encoding), resolved.is32Bit,
+                        resolved.operands);
+}
@@ -0,0 +1,103 @@
+#include "expression.h"
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+auto Expressions::push(ExpressionNode node) -> uint32_t {
+    this->nodes.push_back(node);
+    return static_cast<uint32_t>(this->nodes.size() - 1);
+}
+
+auto Expressions::number(int64_t value) -> uint32_t {
+    const auto bits = static_cast<uint64_t>(value);
+    return this->push(ExpressionNode{ExpressionOp::NUMBER,
+                                     static_cast<uint32_t>(bits),
+                                     static_cast<uint32_t>(bits >> 32U)});
+}
+
+auto Expressions::symbol(std::string_view name) -> uint32_t {
+    const auto offset = static_cast<uint32_t>(this->names.size());
+    this->names.append(name);
+    return this->push(ExpressionNode{ExpressionOp::SYMBOL, offset,
+                                     static_cast<uint32_t>(name.size())});
+}
+
+auto Expressions::unary(ExpressionOp op, uint32_t operand) -> uint32_t {
+    return this->push(ExpressionNode{op, operand, 0});
+}
+
+auto Expressions::binary(ExpressionOp op, uint32_t lhs, uint32_t rhs)
+    -> uint32_t {
+    return this->push(ExpressionNode{op, lhs, rhs});
+}
+
+void Expressions::rewind(Mark mark) {
+    this->nodes.resize(mark.nodes);
+    this->names.resize(mark.names);
+}
+
+void Expressions::load(std::span<const ExpressionNode> nodes,
+                       std::string_view names) {
+    this->nodes.assign(nodes.begin(), nodes.end());
+    this->names.assign(names);
+}
+
+auto Expressions::define(std::string_view name, uint32_t root) -> bool {
+    return this->constants.insert(name, root);
+}
+
+auto Expressions::apply(ExpressionOp op, int64_t lhs, int64_t rhs)
+    -> int64_t {
+    // Arithmetic wraps around like the registers do, rather than overflowing
+    const auto left = static_cast<uint64_t>(lhs);
+    const auto right = static_cast<uint64_t>(rhs);
+    switch (op) {
+    case ExpressionOp::NEGATE:
+        return static_cast<int64_t>(0U - left);
+    case ExpressionOp::NOT:
+        return static_cast<int64_t>(~left);
+    case ExpressionOp::MULTIPLY:
+        return static_cast<int64_t>(left * right);
+    case ExpressionOp::DIVIDE:
+    case ExpressionOp::REMAINDER:
+        if (rhs == 0) {
+            throw std::runtime_error("Division by zero in expression");
+        }
+        if (rhs == -1) { // INT64_MIN / -1 does not fit
+            return op == ExpressionOp::DIVIDE ? static_cast<int64_t>(0U - left)
+                                              : 0;
+        }
+        return op == ExpressionOp::DIVIDE ? lhs / rhs : lhs % rhs;
+    case ExpressionOp::ADD:
+        return static_cast<int64_t>(left + right);
+    case ExpressionOp::SUBTRACT:
+        return static_cast<int64_t>(left - right);
+    case ExpressionOp::SHIFT_LEFT:
+    case ExpressionOp::SHIFT_RIGHT:
+        if (rhs < 0 || rhs >= 64) {
+            throw std::runtime_error("Shift amount out of range in "
+                                     "expression");
+        }
+        return op == ExpressionOp::SHIFT_LEFT
+                   ? static_cast<int64_t>(left << right)
+                   : lhs >> rhs;
+    case ExpressionOp::AND:
+        return static_cast<int64_t>(left & right);
+    case ExpressionOp::XOR:
+        return static_cast<int64_t>(left ^ right);
+    case ExpressionOp::OR:
+        return static_cast<int64_t>(left | right);
+    case ExpressionOp::NUMBER:
+    case ExpressionOp::SYMBOL:
+        break;
+    }
+    throw std::runtime_error("Invalid expression operator");
+}
+
+void Expressions::clear() {
+    this->nodes.clear();
+    this->names.clear();
+    this->constants.clear();
+}
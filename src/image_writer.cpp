@@ -0,0 +1,229 @@
+#include "image_writer.h"
+#include "mapped_file.h"
+
+#include <elf.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Words are copied out as they are, and AArch64 code is little-endian
+static_assert(std::endian::native == std::endian::little);
+
+namespace {
+
+constexpr size_t IHEX_RECORD_BYTES = 16;   // Data bytes per record
+constexpr uint64_t IHEX_SEGMENT = 0x10000; // Reach of a record's address
+// ':', byte count, address, type, checksum and newline around the data
+constexpr size_t IHEX_RECORD_OVERHEAD = 12;
+
+enum class IhexType : uint8_t {
+    DATA = 0x00,
+    END = 0x01,
+    EXTENDED_LINEAR_ADDRESS = 0x04, // Upper 16 bits of later addresses
+    START_LINEAR_ADDRESS = 0x05,
+};
+
+// The two hex digits of every byte, so encoding a byte is one copy
+constexpr auto makeHexTable() -> std::array<char, 512> {
+    constexpr std::string_view digits = "0123456789ABCDEF";
+    std::array<char, 512> table{};
+    for (size_t byte{0}; byte < 256; byte++) {
+        table[byte * 2] = digits[byte >> 4U];
+        table[byte * 2 + 1] = digits[byte & 0xFU];
+    }
+    return table;
+}
+
+constexpr std::array<char, 512> HEX_DIGITS = makeHexTable();
+
+auto imageBytes(const Image &image) -> std::span<const std::byte> {
+    return std::as_bytes(std::span<const uint32_t>(image.words));
+}
+
+void checkIhexFits(size_t imageBytes, uint32_t loadAddress) {
+    if (uint64_t{loadAddress} + imageBytes > uint64_t{1} << 32U) {
+        throw std::runtime_error("Image does not fit below 4 GiB for Intel "
+                                 "HEX");
+    }
+}
+
+// Writes Intel HEX records into the output, front to back
+class IhexWriter {
+  private:
+    std::span<std::byte> out;
+    size_t position{0};
+
+    void putByte(uint8_t byte, uint8_t &checksum) {
+        std::memcpy(this->out.data() + this->position, &HEX_DIGITS[byte * 2],
+                    2);
+        this->position += 2;
+        checksum = static_cast<uint8_t>(checksum + byte);
+    }
+
+  public:
+    explicit IhexWriter(std::span<std::byte> out) : out(out) {}
+
+    void record(IhexType type, uint16_t address,
+                std::span<const std::byte> data) {
+        if (IHEX_RECORD_OVERHEAD + data.size() * 2 >
+            this->out.size() - this->position) {
+            throw std::runtime_error("Intel HEX output is too small");
+        }
+        uint8_t checksum{0};
+        this->out[this->position++] = std::byte{':'};
+        this->putByte(static_cast<uint8_t>(data.size()), checksum);
+        this->putByte(static_cast<uint8_t>(address >> 8U), checksum);
+        this->putByte(static_cast<uint8_t>(address & 0xFFU), checksum);
+        this->putByte(static_cast<uint8_t>(type), checksum);
+        for (const std::byte byte : data) {
+            this->putByte(static_cast<uint8_t>(byte), checksum);
+        }
+        uint8_t ignored{0};
+        this->putByte(static_cast<uint8_t>(0x100U - checksum), ignored);
+        this->out[this->position++] = std::byte{'\n'};
+    }
+
+    // A big-endian value as the record's data
+    template <typename T> void record(IhexType type, T value) {
+        std::array<std::byte, sizeof(T)> data{};
+        for (size_t i{0}; i < sizeof(T); i++) {
+            data[i] = static_cast<std::byte>(
+                (value >> (8 * (sizeof(T) - 1 - i))) & 0xFFU);
+        }
+        this->record(type, 0, data);
+    }
+
+    [[nodiscard]] auto done() const -> bool {
+        return this->position == this->out.size();
+    }
+};
+
+} // namespace
+
+auto ImageWriter::size(ImageFormat format, size_t imageBytes,
+                       uint32_t loadAddress, bool hasEntry) -> size_t {
+    switch (format) {
+    case ImageFormat::BINARY:
+        return imageBytes;
+    case ImageFormat::ELF:
+        return ELF_IMAGE_OFFSET + imageBytes;
+    case ImageFormat::IHEX:
+        break;
+    }
+
+    checkIhexFits(imageBytes, loadAddress);
+    size_t size{0};
+    const uint64_t end = uint64_t{loadAddress} + imageBytes;
+    for (uint64_t address = loadAddress; address < end;) {
+        // An address record, then the segment's data records
+        const uint64_t segmentEnd =
+            std::min(end, (address / IHEX_SEGMENT + 1) * IHEX_SEGMENT);
+        const uint64_t bytes = segmentEnd - address;
+        const uint64_t records =
+            (bytes + IHEX_RECORD_BYTES - 1) / IHEX_RECORD_BYTES;
+        size += IHEX_RECORD_OVERHEAD + 2 * 2;
+        size += records * IHEX_RECORD_OVERHEAD + bytes * 2;
+        address = segmentEnd;
+    }
+    if (hasEntry) {
+        size += IHEX_RECORD_OVERHEAD + 4 * 2;
+    }
+    return size + IHEX_RECORD_OVERHEAD; // The end of file record
+}
+
+void ImageWriter::binary(const Image &image, std::span<std::byte> out) {
+    const auto bytes = imageBytes(image);
+    std::copy(bytes.begin(), bytes.end(), out.begin());
+}
+
+void ImageWriter::ihex(const Image &image, uint32_t loadAddress,
+                       std::span<std::byte> out) {
+    const auto bytes = imageBytes(image);
+    checkIhexFits(bytes.size(), loadAddress);
+    IhexWriter writer(out);
+    uint64_t address = loadAddress;
+    for (size_t offset{0}; offset < bytes.size();) {
+        if (offset == 0 || address % IHEX_SEGMENT == 0) {
+            writer.record(IhexType::EXTENDED_LINEAR_ADDRESS,
+                          static_cast<uint16_t>(address >> 16U));
+        }
+        // Records stop at the end of their 64 KiB segment
+        const size_t length = std::min(
+            {IHEX_RECORD_BYTES, bytes.size() - offset,
+             static_cast<size_t>(IHEX_SEGMENT - address % IHEX_SEGMENT)});
+        writer.record(IhexType::DATA,
+                      static_cast<uint16_t>(address & 0xFFFFU),
+                      bytes.subspan(offset, length));
+        offset += length;
+        address += length;
+    }
+    if (image.entry) {
+        writer.record(IhexType::START_LINEAR_ADDRESS,
+                      loadAddress + static_cast<uint32_t>(*image.entry));
+    }
+    writer.record(IhexType::END, 0, {});
+    if (!writer.done()) {
+        throw std::runtime_error("Intel HEX output has the wrong size");
+    }
+}
+
+void ImageWriter::elf(const Image &image, std::span<std::byte> out) {
+    Elf64_Ehdr header{};
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_NONE;
+    header.e_type = ET_EXEC;
+    header.e_machine = EM_AARCH64;
+    header.e_version = EV_CURRENT;
+    header.e_entry = ELF_LOAD_ADDRESS + ELF_IMAGE_OFFSET +
+                     static_cast<uint64_t>(image.entry.value_or(0));
+    header.e_phoff = sizeof(Elf64_Ehdr);
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_phentsize = sizeof(Elf64_Phdr);
+    header.e_phnum = 1;
+
+    const auto bytes = imageBytes(image);
+    Elf64_Phdr segment{};
+    segment.p_type = PT_LOAD;
+    segment.p_flags = PF_R | PF_W | PF_X;
+    segment.p_offset = 0;
+    segment.p_vaddr = ELF_LOAD_ADDRESS;
+    segment.p_paddr = ELF_LOAD_ADDRESS;
+    segment.p_filesz = ELF_IMAGE_OFFSET + bytes.size();
+    segment.p_memsz = ELF_IMAGE_OFFSET + bytes.size();
+    segment.p_align = ELF_IMAGE_OFFSET;
+
+    // The rest of the first page stays zero
+    std::fill(out.begin(), out.begin() + ELF_IMAGE_OFFSET, std::byte{0});
+    std::memcpy(out.data(), &header, sizeof(header));
+    std::memcpy(out.data() + sizeof(header), &segment, sizeof(segment));
+    std::copy(bytes.begin(), bytes.end(), out.begin() + ELF_IMAGE_OFFSET);
+}
+
+void ImageWriter::write(const std::string &path, const Image &image,
+                        ImageFormat format, uint32_t loadAddress) {
+    const MappedOutput file(
+        path, ImageWriter::size(format, image.words.size() * 4, loadAddress,
+                                image.entry.has_value()));
+    switch (format) {
+    case ImageFormat::BINARY:
+        ImageWriter::binary(image, file.bytes());
+        break;
+    case ImageFormat::IHEX:
+        ImageWriter::ihex(image, loadAddress, file.bytes());
+        break;
+    case ImageFormat::ELF:
+        ImageWriter::elf(image, file.bytes());
+        break;
+    }
+}
@@ -0,0 +1,145 @@
+#include "input_stream.h"
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+InputStream::InputStream(int fd, size_t chunkSize, size_t chunkCount)
+    : fd(fd), wakeup(-1), chunks(chunkCount, std::vector<char>(chunkSize)),
+      sizes(chunkCount) {
+    if (chunkSize == 0 || chunkCount == 0) {
+        throw std::invalid_argument("Chunks must hold at least one byte");
+    }
+    this->wakeup = eventfd(0, EFD_CLOEXEC);
+    if (this->wakeup < 0) {
+        throw std::runtime_error(std::string("Could not create eventfd: ") +
+                                 std::strerror(errno));
+    }
+    this->reader = std::thread([this] { this->read(); });
+}
+
+InputStream::~InputStream() {
+    {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+    }
+    this->changed.notify_all();
+    // Wakes the reader if it is polling the descriptor
+    const uint64_t one{1};
+    [[maybe_unused]] const ssize_t written =
+        write(this->wakeup, &one, sizeof(one));
+    this->reader.join();
+    close(this->wakeup);
+}
+
+auto InputStream::poll(bool block) -> Readiness {
+    if (this->fd < 0) {
+        return Readiness::READY; // poll skips it, so read reports it
+    }
+    std::array<pollfd, 2> fds{pollfd{this->fd, POLLIN, 0},
+                              pollfd{this->wakeup, POLLIN, 0}};
+    while (::poll(fds.data(), fds.size(), block ? -1 : 0) < 0) {
+        if (errno != EINTR) {
+            return Readiness::READY; // Left for read to report
+        }
+    }
+    if (fds[1].revents != 0) {
+        return Readiness::CLOSED;
+    }
+    // Any event, hang-ups and errors included, means read will not wait
+    return fds[0].revents != 0 ? Readiness::READY : Readiness::EMPTY;
+}
+
+void InputStream::fail(const std::string &message) {
+    const std::lock_guard<std::mutex> lock(this->mutex);
+    this->error = std::make_exception_ptr(std::runtime_error(message));
+    this->ended = true;
+    this->changed.notify_all();
+}
+
+void InputStream::read() {
+    const size_t count = this->chunks.size();
+    for (size_t chunk{0};; chunk = (chunk + 1) % count) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->changed.wait(lock, [this, count] {
+                return this->closed || this->full < count;
+            });
+            if (this->closed) {
+                return;
+            }
+        }
+
+        // A chunk is filled while bytes are ready, and handed over when it
+        // is full or the producer falls behind, so that a fast producer's
+        // chunks are whole and a slow producer's lines are not held back
+        std::vector<char> &buffer = this->chunks[chunk];
+        size_t size{0};
+        bool atEnd = false;
+        while (size < buffer.size()) {
+            const Readiness readiness = this->poll(size == 0);
+            if (readiness == Readiness::CLOSED) {
+                return;
+            }
+            if (readiness == Readiness::EMPTY) {
+                break;
+            }
+            const ssize_t bytes =
+                ::read(this->fd, buffer.data() + size, buffer.size() - size);
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes < 0) {
+                this->fail(std::string("Could not read input: ") +
+                           std::strerror(errno));
+                return;
+            }
+            if (bytes == 0) {
+                atEnd = true;
+                break;
+            }
+            size += static_cast<size_t>(bytes);
+        }
+
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        if (size > 0) {
+            this->sizes[chunk] = size;
+            this->full++;
+        }
+        this->ended = atEnd;
+        this->changed.notify_all();
+        if (atEnd) {
+            return;
+        }
+    }
+}
+
+auto InputStream::next() -> std::string_view {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->held) {
+        this->held = false;
+        this->full--;
+        this->first = (this->first + 1) % this->chunks.size();
+        this->changed.notify_all();
+    }
+    this->changed.wait(lock,
+                       [this] { return this->full > 0 || this->ended; });
+    if (this->full > 0) {
+        this->held = true;
+        return {this->chunks[this->first].data(), this->sizes[this->first]};
+    }
+    if (this->error) {
+        std::rethrow_exception(this->error);
+    }
+    return {};
+}
@@ -0,0 +1,189 @@
+#include "lazy_assembler.h"
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "linker.h"
+#include "object_file.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view DATA_LINE = ".data\n";
+
+// A body placed in the code, waiting for its relocations
+struct PlacedUnit {
+    ObjectFile object;
+    std::array<int, SECTION_COUNT> bases; // Of each section, in the code
+};
+
+} // namespace
+
+LazyAssembler::LazyAssembler(std::string_view assembly, std::string_view file)
+    : source(assembly), file(file) {
+    Lexer::index(assembly, this->index);
+
+    const bool everyLabel = this->index.globals.empty();
+    std::vector<std::pair<SourcePosition, std::string_view>> starts;
+    this->index.labels.forEach(
+        [&](std::string_view name, const SourcePosition &position) {
+            if (everyLabel || this->index.globals.contains(name)) {
+                starts.emplace_back(position, name);
+            }
+        });
+    std::sort(starts.begin(), starts.end(),
+              [](const auto &lhs, const auto &rhs) {
+                  return lhs.first.offset < rhs.first.offset;
+              });
+    this->symbolStarts.reserve(starts.size());
+    for (const auto &[position, name] : starts) {
+        this->symbols.insert(name, this->symbolStarts.size());
+        this->symbolStarts.push_back(position);
+    }
+}
+
+auto LazyAssembler::constantsOf() -> const Expressions & {
+    if (!this->constants) {
+        AssemblerState state;
+        for (const SourcePosition &constant : this->index.constants) {
+            const size_t end = this->source.find('\n', constant.offset);
+            Lexer::tokenize(this->source.substr(constant.offset,
+                                                end - constant.offset),
+                            state, this->file, constant.line);
+        }
+        this->constants = std::move(state.expressions);
+    }
+    return *this->constants;
+}
+
+auto LazyAssembler::bodyOf(size_t symbol) const -> std::string {
+    const SourcePosition &start = this->symbolStarts[symbol];
+    const size_t end = symbol + 1 < this->symbolStarts.size()
+                           ? this->symbolStarts[symbol + 1].offset
+                           : this->source.size();
+    std::string body;
+    body.reserve(DATA_LINE.size() + end - start.offset);
+    if (start.section == Section::DATA) {
+        body.append(DATA_LINE);
+    }
+    // Constant lines are left empty, so later lines keep their numbers
+    size_t copied = start.offset;
+    auto constant = std::lower_bound(
+        this->index.constants.begin(), this->index.constants.end(),
+        start.offset, [](const SourcePosition &position, size_t offset) {
+            return position.offset < offset;
+        });
+    for (; constant != this->index.constants.end() && constant->offset < end;
+         constant++) {
+        body.append(this->source.substr(copied, constant->offset - copied));
+        copied = std::min(end, this->source.find('\n', constant->offset));
+    }
+    body.append(this->source.substr(copied, end - copied));
+    return body;
+}
+
+auto LazyAssembler::assembleSymbol(std::string_view name) -> AssembledSymbol {
+    if (const AssembledSymbol *symbol = this->assembled.find(name)) {
+        return *symbol;
+    }
+
+    // Symbols are only cached once every branch between them is patched
+    const size_t oldSize = this->words.size();
+    SymbolTable<AssembledSymbol> added;
+    std::vector<PlacedUnit> units;
+    std::vector<std::string> pending{std::string(name)};
+    try {
+        while (!pending.empty()) {
+            const std::string next = std::move(pending.back());
+            pending.pop_back();
+            if (this->assembled.contains(next) || added.contains(next)) {
+                continue;
+            }
+            const size_t *symbol = this->symbols.find(next);
+            if (symbol == nullptr) {
+                throw std::runtime_error("Undefined symbol: " + next);
+            }
+
+            AssemblerState state;
+            state.relocatable = true;
+            state.expressions = this->constantsOf();
+            const SourcePosition &start = this->symbolStarts[*symbol];
+            Lexer::tokenize(this->bodyOf(*symbol), state, this->file,
+                            start.section == Section::DATA ? start.line - 1
+                                                           : start.line);
+            Parser::parse(state);
+            Encoder::encode(state);
+            // A body may hold the .global of a later symbol, and every
+            // symbol is already known from the index
+            state.globalSymbols.clear();
+
+            // The body's sections in order, as the linker places a unit
+            PlacedUnit unit{ObjectFile::fromState(state), {}};
+            const size_t first = this->words.size();
+            for (size_t i{0}; i < SECTION_COUNT; i++) {
+                this->words.resize(alignUp(
+                    this->words.size(),
+                    static_cast<size_t>(unit.object.alignments[i] / 4)));
+                unit.bases[i] = static_cast<int>(this->words.size() * 4);
+                this->words.insert(this->words.end(),
+                                   unit.object.sections[i].begin(),
+                                   unit.object.sections[i].end());
+            }
+            const LabelAddress label = state.labelToAddress.at(next);
+            added.insert(next, AssembledSymbol{
+                                   unit.bases[static_cast<size_t>(
+                                       label.section)] +
+                                       label.offset,
+                                   static_cast<int>(
+                                       (this->words.size() - first) * 4)});
+            for (const ObjectSymbol &target : unit.object.symbols) {
+                if (target.binding == SymbolBinding::UNDEFINED) {
+                    pending.emplace_back(unit.object.nameOf(target));
+                }
+            }
+            units.push_back(std::move(unit));
+        }
+
+        for (const PlacedUnit &unit : units) {
+            for (const Relocation &relocation : unit.object.relocations) {
+                const ObjectSymbol &target =
+                    unit.object.symbols[relocation.symbol];
+                const std::string_view targetName = unit.object.nameOf(target);
+                int address{0};
+                if (target.binding == SymbolBinding::UNDEFINED) {
+                    const AssembledSymbol *symbol =
+                        this->assembled.find(targetName);
+                    address = (symbol != nullptr ? symbol
+                                                 : added.find(targetName))
+                                  ->address;
+                } else {
+                    address =
+                        unit.bases[static_cast<size_t>(target.section)] +
+                        target.offset;
+                }
+                const int pc =
+                    unit.bases[static_cast<size_t>(relocation.section)] +
+                    static_cast<int>(relocation.offset);
+                Linker::relocate(relocation, pc, address, targetName,
+                                 this->words[static_cast<size_t>(pc) / 4]);
+            }
+        }
+    } catch (...) {
+        this->words.resize(oldSize);
+        throw;
+    }
+
+    added.forEach([this](std::string_view symbol, AssembledSymbol value) {
+        this->assembled.insert(symbol, value);
+    });
+    return this->assembled.at(name);
+}
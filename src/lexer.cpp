@@ -1,53 +1,109 @@
 #include "lexer.h"
 #include "lexer_constants.h"
 #include "token.h"
-#include "util.h"
 
+#include <algorithm>
 #include <cctype>
-#include <sstream>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <optional>
 #include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <system_error>
 #include <vector>
 
-Lexer::Lexer() : stringToLabels({}) {};
+void Lexer::tokenize(std::string_view assembly,
+                     AssemblerState &assemblerState, std::string_view file,
+                     int firstLine) {
+    int lineNum = firstLine - 1;
+    size_t lineStart = 0;
+    assemblerState.sourceMap.addFile(file);
 
-void Lexer::tokenize(const std::string &assembly,
-                     AssemblerState &assemblerState) {
-    std::istringstream stream(assembly);
-    std::string line;
-    int lineNum = 0;
-
-    while (std::getline(stream, line)) {
+    while (lineStart < assembly.size()) {
         // Process line by line
         lineNum++;
+        size_t lineEnd = assembly.find('\n', lineStart);
+        if (lineEnd == std::string_view::npos) {
+            lineEnd = assembly.size();
+        }
+        Lexer::addLine(assembly.substr(lineStart, lineEnd - lineStart),
+                       lineNum, lineNum == firstLine, assemblerState);
+        lineStart = lineEnd + 1;
+    }
+}
 
-        std::vector<Token> tokensInLine = Lexer::processLine(line, lineNum);
-
-        assemblerState.tokens.insert(assemblerState.tokens.end(),
-                                     tokensInLine.begin(), tokensInLine.end());
+void Lexer::tokenizeStream(InputStream &input, AssemblerState &assemblerState,
+                           std::string_view file) {
+    int lineNum = 0;
+    assemblerState.sourceMap.addFile(file);
+    // The start of a line the previous chunk ended in the middle of
+    std::string carried;
 
-        if (!assemblerState.tokens.empty() && stream.peek() != EOF) {
-            assemblerState.tokens.push_back(Token::createNewline());
+    for (std::string_view chunk = input.next(); !chunk.empty();
+         chunk = input.next()) {
+        size_t lineStart = 0;
+        if (!carried.empty()) {
+            const size_t lineEnd = chunk.find('\n');
+            if (lineEnd == std::string_view::npos) {
+                carried.append(chunk); // A line longer than a chunk
+                continue;
+            }
+            carried.append(chunk.substr(0, lineEnd));
+            lineNum++;
+            Lexer::addLine(carried, lineNum, lineNum == 1, assemblerState);
+            carried.clear();
+            lineStart = lineEnd + 1;
+        }
+        for (size_t lineEnd = chunk.find('\n', lineStart);
+             lineEnd != std::string_view::npos;
+             lineEnd = chunk.find('\n', lineStart)) {
+            lineNum++;
+            Lexer::addLine(chunk.substr(lineStart, lineEnd - lineStart),
+                           lineNum, lineNum == 1, assemblerState);
+            lineStart = lineEnd + 1;
         }
+        // Tokens hold no views of the chunk, so it can be reused after this
+        carried.assign(chunk.substr(lineStart));
+    }
+    if (!carried.empty()) {
+        lineNum++;
+        Lexer::addLine(carried, lineNum, lineNum == 1, assemblerState);
     }
 }
 
-auto Lexer::processLine(std::string &line, const int lineNum)
-    -> std::vector<Token> {
+void Lexer::addLine(std::string_view line, const int lineNum,
+                    bool firstLine, AssemblerState &assemblerState) {
+    // Lines are separated by a newline once there are tokens to separate
+    if (!firstLine && !assemblerState.tokens.empty()) {
+        assemblerState.tokens.push_back(Token::createNewline());
+    }
+    const size_t firstToken = assemblerState.tokens.size();
+    Lexer::processLine(line, lineNum, assemblerState);
+    if (assemblerState.tokens.size() > firstToken) {
+        // Columns are 1-based, like lines
+        assemblerState.sourceMap.addLine(
+            firstToken, lineNum,
+            static_cast<int>(line.find_first_not_of(" \t")) + 1);
+    }
+}
 
-    std::vector<Token> tokens = {};
-    line = Lexer::trimComments(Lexer::trimWhitespace(line));
+void Lexer::processLine(std::string_view line, const int lineNum,
+                        AssemblerState &assemblerState) {
+    std::vector<Token> &tokens = assemblerState.tokens;
+    line = Lexer::trimWhitespace(Lexer::trimComments(line));
 
     if (line.empty()) {
-        return tokens;
+        return;
     }
     if (line[0] == '.') {
-        return Lexer::processDirective(line, lineNum);
+        Lexer::processDirective(line, lineNum, assemblerState);
+        return;
     }
     if (line.back() == ':') {
         tokens.push_back(Lexer::processLabel(line, lineNum));
-        return tokens;
+        return;
     }
 
     // TODO: Check if the line contains a label for macros
@@ -55,80 +111,178 @@ auto Lexer::processLine(std::string &line, const int lineNum)
     tokens.push_back(Lexer::processMnemonic(line, lineNum));
 
     // Then process arguments and turn them into the appropriate tokens
-    size_t argStartIndex = line.find(' ') + 1;
-    if (argStartIndex >= line.size()) {
+    size_t start = line.find(' ') + 1;
+    if (start >= line.size()) {
         throw std::runtime_error("Expected arguments at line " +
                                  std::to_string(lineNum));
     }
-    std::vector<std::string> arguments =
-        Lexer::gatherArguments(line, argStartIndex, lineNum);
-
-    for (const auto &argument : arguments) {
-        tokens.push_back(this->processArgument(argument, lineNum));
+    while (start != std::string_view::npos) {
+        std::string_view argument =
+            Lexer::nextArgument(line, start, lineNum);
+        // Memory operands are written [base] or [base, #offset], so brackets
+        // arrive attached to the first and last argument inside them
+        const bool opensMemory = argument.front() == '[';
+        if (opensMemory) {
+            tokens.push_back(Token::createLeftBracket());
+            argument = Lexer::trimWhitespace(argument.substr(1));
+        }
+        const bool closesMemory = !argument.empty() && argument.back() == ']';
+        if (closesMemory) {
+            argument = Lexer::trimWhitespace(
+                argument.substr(0, argument.size() - 1));
+        }
+        if (argument.empty()) {
+            throw std::runtime_error("Expected argument inside brackets on "
+                                     "line " +
+                                     std::to_string(lineNum));
+        }
+        const Token token = Lexer::processArgument(
+            argument, lineNum, assemblerState.expressions);
+        if (token.type == TokenType::Immediate &&
+            std::get<Immediate>(token.token).expression != NO_EXPRESSION) {
+            // Evaluated by the parser once labels are placed
+            assemblerState.deferredImmediates.push_back(tokens.size());
+        }
+        tokens.push_back(token);
+        if (closesMemory) {
+            tokens.push_back(Token::createRightBracket());
+        }
     }
-
-    return tokens;
 }
 
-auto Lexer::processArgument(const std::string &argument, const int lineNum)
-    -> Token {
-    if (util::isValidKey(argument, this->stringToLabels)) {
-        return Token::createLabel(this->stringToLabels.at(argument));
-    }
+auto Lexer::processArgument(std::string_view argument, const int lineNum,
+                            Expressions &expressions) -> Token {
     if (argument[0] == '#') {
-        return Lexer::processImmediate(argument, lineNum);
+        return Lexer::processImmediate(argument, lineNum, expressions);
+    }
+    if (argument[0] == '=') {
+        return Lexer::processLiteral(argument, lineNum);
     }
-    if (argument[0] == 'w' || argument[0] == 'x') {
+    if ((argument[0] == 'w' || argument[0] == 'x') && argument.size() > 1 &&
+        std::all_of(argument.begin() + 1, argument.end(),
+                    [](char byte) { return std::isdigit(byte) != 0; })) {
         return Lexer::processRegister(argument, lineNum);
     }
+    if (Lexer::isLabelName(argument)) {
+        // Labels may be referenced before they are defined
+        return Token::createLabel(Label{std::string(argument)});
+    }
     throw std::runtime_error("Invalid argument on line " +
-                             std::to_string(lineNum) + ": " + argument);
+                             std::to_string(lineNum) + ": " +
+                             std::string(argument));
+}
+
+auto Lexer::isLabelName(std::string_view name) -> bool {
+    if (name[0] != '_' && (std::isalpha(name[0]) == 0)) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char byte) {
+        return std::isalnum(byte) != 0 || byte == '_';
+    });
 }
 
-auto Lexer::processMnemonic(const std::string &line, const int lineNum)
+auto Lexer::processMnemonic(std::string_view line, const int lineNum)
     -> Token {
     size_t firstWhitespaceIdx = line.find(' ');
 
-    if (firstWhitespaceIdx == std::string::npos) {
+    if (firstWhitespaceIdx == std::string_view::npos) {
         throw std::runtime_error("Expected arguments after mnemonic on line " +
                                  std::to_string(lineNum));
     }
 
-    std::string mnemonic = line.substr(0, firstWhitespaceIdx);
-    if (!util::isValidKey(mnemonic, stringToMnemonic)) {
+    const std::optional<Mnemonic> mnemonic =
+        lookupMnemonic(line.substr(0, firstWhitespaceIdx));
+    if (!mnemonic) {
         throw std::runtime_error("Expected mnemonic as first string at line: " +
                                  std::to_string(lineNum));
     }
-    return Token::createMnemonic(stringToMnemonic.at(mnemonic));
+    return Token::createMnemonic(*mnemonic);
+}
+
+auto Lexer::nextArgument(std::string_view line, size_t &start,
+                         const int lineNum) -> std::string_view {
+    const size_t comma = line.find(',', start);
+    const std::string_view argument = Lexer::trimWhitespace(line.substr(
+        start,
+        comma == std::string_view::npos ? std::string_view::npos
+                                        : comma - start));
+    if (argument.empty()) {
+        throw std::runtime_error(
+            "Expected argument (label, register, or immediate) "
+            "before/after comma on line " +
+            std::to_string(lineNum));
+    }
+    start = comma == std::string_view::npos ? comma : comma + 1;
+    return argument;
 }
 
-auto Lexer::gatherArguments(std::string &line, const size_t argStartIndex,
-                            int lineNum) -> std::vector<std::string> {
-    std::vector<std::string> arguments;
-    std::string currentArgument;
-    line.push_back(','); // Forces last argument to be pushed to arguments list
-    for (size_t i = argStartIndex; i < line.size(); i++) {
-        if (line[i] == ' ') {
+void Lexer::index(std::string_view assembly, SourceIndex &index) {
+    int lineNum = 0;
+    size_t lineStart = 0;
+    Section section = Section::TEXT;
+
+    while (lineStart < assembly.size()) {
+        lineNum++;
+        size_t lineEnd = assembly.find('\n', lineStart);
+        if (lineEnd == std::string_view::npos) {
+            lineEnd = assembly.size();
+        }
+        const std::string_view text =
+            assembly.substr(lineStart, lineEnd - lineStart);
+        const SourcePosition position{lineStart, lineNum, section};
+        lineStart = lineEnd + 1;
+
+        // Most lines are instructions, which are passed over on sight
+        const size_t first = text.find_first_not_of(" \t");
+        if (first == std::string_view::npos ||
+            (text[first] != '.' &&
+             text.find(':', first) == std::string_view::npos)) {
+            continue;
+        }
+        const std::string_view line =
+            Lexer::trimWhitespace(Lexer::trimComments(text));
+        if (line.empty()) {
             continue;
         }
-        if (line[i] == ',') {
-            if (currentArgument.empty()) {
-                throw std::runtime_error(
-                    "Expected argument (label, register, or immediate) "
-                    "before/after comma on line " +
-                    std::to_string(lineNum));
+        if (line[0] == '.') {
+            // Only the directives that matter to other lines
+            const size_t space = line.find(' ');
+            const std::string_view name = line.substr(
+                1, space == std::string_view::npos ? space : space - 1);
+            if (name == "text") {
+                section = Section::TEXT;
+            } else if (name == "data") {
+                section = Section::DATA;
+            } else if (name == "equ" || name == "set") {
+                index.constants.push_back(position);
+            } else if (name == "global" && space != std::string_view::npos) {
+                const std::string_view symbol =
+                    Lexer::trimWhitespace(line.substr(space + 1));
+                if (symbol.empty() || !Lexer::isLabelName(symbol)) {
+                    throw std::runtime_error("Invalid .global symbol on line " +
+                                             std::to_string(lineNum) + ": " +
+                                             std::string(symbol));
+                }
+                index.globals.insert(symbol, lineNum);
+            }
+        } else if (line.back() == ':') {
+            const std::string_view name = Lexer::labelName(line, lineNum);
+            if (!index.labels.insert(name, position)) {
+                throw std::runtime_error("Duplicate label on line " +
+                                         std::to_string(lineNum) + ": " +
+                                         std::string(name));
             }
-            arguments.push_back(currentArgument);
-            currentArgument = "";
-        } else {
-            currentArgument.push_back(line[i]);
         }
     }
-    line.pop_back(); // Remove that last comma
-    return arguments;
 }
 
-auto Lexer::processLabel(const std::string &line, const int lineNum) -> Token {
+auto Lexer::processLabel(std::string_view line, const int lineNum) -> Token {
+    return Token::createLabel(
+        Label{std::string(Lexer::labelName(line, lineNum))});
+}
+
+auto Lexer::labelName(std::string_view line, const int lineNum)
+    -> std::string_view {
     // Verify that the label starts with either an underscore or alphabetic
     // character
     if (line[0] != '_' && (std::isalpha(line[0]) == 0)) {
@@ -138,85 +292,280 @@ auto Lexer::processLabel(const std::string &line, const int lineNum) -> Token {
             std::to_string(lineNum));
     }
 
-    // Verify none of the characters are non alphanumeric/underscores
-    for (auto byte : line) {
-        if ((std::isalnum(byte) == 0) && byte == '_') {
+    // Verify none of the characters are non alphanumeric/underscores (the
+    // trailing colon aside)
+    std::string_view name = line.substr(0, line.size() - 1);
+    for (auto byte : name) {
+        if (byte == ' ') {
             throw std::runtime_error(
-                "Unexpected character in label (only alphanumeric and "
-                "underscores allowed) at line " +
+                "No whitespaces allowed in label name at line " +
                 std::to_string(lineNum));
         }
-        if (byte == ' ') {
+        if ((std::isalnum(byte) == 0) && byte != '_') {
             throw std::runtime_error(
-                "No whitespaces allowed in label name at line " +
+                "Unexpected character in label (only alphanumeric and "
+                "underscores allowed) at line " +
                 std::to_string(lineNum));
         }
     }
-    std::string trimmedLine = line.substr(0, line.size() - 1);
-    Label label{trimmedLine};
-    this->stringToLabels.insert({trimmedLine, label});
-    return Token::createLabel(label);
+    return name;
 }
 
-auto Lexer::processImmediate(const std::string &immediate, const int lineNum)
-    -> Token {
-    // First we must determine if this number is in decimal, hex, or binary
+auto Lexer::processImmediate(std::string_view immediate, const int lineNum,
+                             Expressions &expressions) -> Token {
     // Remember first char in the immediate is a hashtag
-    int immediateVal = 0;
-    try {
-        if (immediate.size() >= 3 && immediate.substr(1, 2) == "0b") {
-            immediateVal = std::stoi(immediate.substr(3), nullptr, 2);
-        } else {
-            immediateVal =
-                std::stoi(immediate.substr(1), nullptr,
-                          0); // Auto-detect base (binary not supported)
-        }
-    } catch (const std::invalid_argument &e) {
-        throw std::runtime_error("Invalid immediate value on line " +
-                                 std::to_string(lineNum) + ": " + immediate +
-                                 "\n");
-    } catch (const std::out_of_range &e) {
+    const Expressions::Mark mark = expressions.mark();
+    const uint32_t root =
+        Lexer::processExpression(immediate.substr(1), lineNum, expressions);
+    const std::optional<int64_t> value = expressions.fold(root);
+    if (!value) {
+        return Token::createImmediate(Immediate{0, root});
+    }
+    // Nothing refers to the nodes of a folded expression
+    expressions.rewind(mark);
+    if (*value < INT_MIN || *value > INT_MAX) {
+        throw std::runtime_error("Immediate value out of range on line " +
+                                 std::to_string(lineNum));
+    }
+    return Token::createImmediate(Immediate{static_cast<int>(*value)});
+}
+
+auto Lexer::processExpression(std::string_view expression, const int lineNum,
+                              Expressions &expressions) -> uint32_t {
+    size_t position = 0;
+    const uint32_t root =
+        Lexer::parseBinary(expression, position, 1, lineNum, expressions);
+    if (position != expression.size()) {
+        throw std::runtime_error("Invalid expression on line " +
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(expression));
+    }
+    return root;
+}
+
+auto Lexer::parseBinary(std::string_view expression, size_t &position,
+                        int minPrecedence, const int lineNum,
+                        Expressions &expressions) -> uint32_t {
+    // Precedence climbing: operators binding tighter than minPrecedence are
+    // folded into the right hand side first
+    uint32_t lhs =
+        Lexer::parseOperand(expression, position, lineNum, expressions);
+    while (true) {
+        position = std::min(expression.find_first_not_of(" \t", position),
+                            expression.size());
+        const std::optional<ExpressionOperator> op =
+            lookupExpressionOperator(expression.substr(position));
+        if (!op || op->precedence < minPrecedence) {
+            return lhs;
+        }
+        position += op->symbol.size();
+        const uint32_t rhs = Lexer::parseBinary(
+            expression, position, op->precedence + 1, lineNum, expressions);
+        lhs = expressions.binary(op->op, lhs, rhs);
+    }
+}
+
+auto Lexer::parseOperand(std::string_view expression, size_t &position,
+                         const int lineNum, Expressions &expressions)
+    -> uint32_t {
+    position = expression.find_first_not_of(" \t", position);
+    if (position == std::string_view::npos) {
+        throw std::runtime_error("Expected operand in expression on line " +
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(expression));
+    }
+    const char first = expression[position];
+    if (first == '-' || first == '~' || first == '+') {
+        position++;
+        const uint32_t operand =
+            Lexer::parseOperand(expression, position, lineNum, expressions);
+        if (first == '+') {
+            return operand;
+        }
+        return expressions.unary(
+            first == '-' ? ExpressionOp::NEGATE : ExpressionOp::NOT, operand);
+    }
+    if (first == '(') {
+        position++;
+        const uint32_t inner =
+            Lexer::parseBinary(expression, position, 1, lineNum, expressions);
+        position = expression.find_first_not_of(" \t", position);
+        if (position == std::string_view::npos || expression[position] != ')') {
+            throw std::runtime_error("Expected ) in expression on line " +
+                                     std::to_string(lineNum));
+        }
+        position++;
+        return inner;
+    }
+
+    // A number or a symbol runs up to the next operator, bracket or space
+    const size_t end = std::min(
+        expression.find_first_of(" \t()+-*/%<>&^|~", position),
+        expression.size());
+    const std::string_view word = expression.substr(position, end - position);
+    position = end;
+    if (word.empty()) {
+        throw std::runtime_error("Invalid expression on line " +
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(expression));
+    }
+    if (std::isdigit(word[0]) != 0) {
+        return expressions.number(static_cast<int64_t>(
+            Lexer::parseNumber(word, INT64_MAX, 0, lineNum)));
+    }
+    if (!Lexer::isLabelName(word)) {
+        throw std::runtime_error("Invalid symbol in expression on line " +
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(word));
+    }
+    return expressions.symbol(word);
+}
+
+auto Lexer::processLiteral(std::string_view literal, const int lineNum)
+    -> Token {
+    // =value may be any 64-bit value, signed or unsigned
+    const uint64_t value =
+        Lexer::parseNumber(literal.substr(1), UINT64_MAX,
+                           1U + static_cast<uint64_t>(INT64_MAX), lineNum);
+    return Token::createLiteral(Literal{value});
+}
+
+auto Lexer::parseNumber(std::string_view number, uint64_t limit,
+                        uint64_t negativeLimit, const int lineNum)
+    -> uint64_t {
+    // First we must determine if this number is in decimal, hex, octal or
+    // binary
+    std::string_view digits = number;
+    const bool negative = !digits.empty() && digits[0] == '-';
+    if (negative) {
+        digits.remove_prefix(1);
+    }
+    int base = 10;
+    if (digits.size() > 2 && digits[0] == '0' &&
+        (digits[1] == 'x' || digits[1] == 'X')) {
+        base = 16;
+        digits.remove_prefix(2);
+    } else if (digits.size() > 2 && digits[0] == '0' && digits[1] == 'b') {
+        base = 2;
+        digits.remove_prefix(2);
+    } else if (digits.size() > 1 && digits[0] == '0') {
+        base = 8;
+        digits.remove_prefix(1);
+    }
+
+    // Parsed as unsigned so that the most negative value is in range
+    uint64_t magnitude = 0;
+    const auto [end, error] = std::from_chars(
+        digits.data(), digits.data() + digits.size(), magnitude, base);
+    if (error == std::errc::result_out_of_range ||
+        magnitude > (negative ? negativeLimit : limit)) {
         throw std::runtime_error("Immediate value out of range on line " +
                                  std::to_string(lineNum));
     }
-    return Token::createImmediate(Immediate{immediateVal});
+    if (error != std::errc() || end != digits.data() + digits.size()) {
+        throw std::runtime_error("Invalid immediate value on line " +
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(number) + "\n");
+    }
+    return negative ? 0U - magnitude : magnitude;
 }
 
-auto Lexer::processRegister(const std::string &argument, const int lineNum)
+auto Lexer::processRegister(std::string_view argument, const int lineNum)
     -> Token {
-    if (!util::isValidKey(argument, stringToRegister)) {
+    // x0-x32 and w0-w32, without leading zeros
+    unsigned int number = 0;
+    const std::string_view digits = argument.substr(1);
+    const auto [end, error] =
+        std::from_chars(digits.data(), digits.data() + digits.size(), number);
+    if (error != std::errc() || end != digits.data() + digits.size() ||
+        number >= static_cast<unsigned int>(Register::W0) || // X0-X32 first
+        (digits.size() > 1 && digits[0] == '0')) {
         throw std::runtime_error("Invalid register on line " +
-                                 std::to_string(lineNum) + ": " + argument);
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(argument));
     }
-    return Token::createRegister(stringToRegister.at(argument));
+    const Register first = argument[0] == 'x' ? Register::X0 : Register::W0;
+    return Token::createRegister(
+        static_cast<Register>(static_cast<unsigned int>(first) + number));
 }
 
-// TODO: Add directive processing. Issue is that arguments for directives don't
-// follow same patterns as other arguments so it's a pain to deal with.
-auto Lexer::processDirective(const std::string &directive, int lineNum)
-    -> std::vector<Token> {
+// Lexes .text, .data, .ltorg, .global <name> and .equ/.set <name>, <expr>
+void Lexer::processDirective(std::string_view directive, int lineNum,
+                             AssemblerState &assemblerState) {
     size_t firstWhitespaceIdx = directive.find(' ');
-    std::string directiveLiteral = directive.substr(
-        1, firstWhitespaceIdx == std::string::npos ? std::string::npos
-                                                   : firstWhitespaceIdx - 1);
+    const std::string_view name = directive.substr(
+        1, firstWhitespaceIdx == std::string_view::npos
+               ? std::string_view::npos
+               : firstWhitespaceIdx - 1);
+    if ((name == "equ" || name == "set") &&
+        firstWhitespaceIdx != std::string_view::npos) {
+        // Constants only matter to expressions, so no token is needed
+        Lexer::processConstant(directive.substr(firstWhitespaceIdx + 1),
+                               lineNum, assemblerState.expressions);
+        return;
+    }
+    const std::optional<Directive> directiveType = lookupDirective(name);
     // Ensure the directive is valid
-    if (!util::isValidKey(directiveLiteral, stringToDirective)) {
+    if (!directiveType) {
         throw std::runtime_error("Invalid directive at line " +
-                                 std::to_string(lineNum) + ": " + directive);
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(directive));
     }
 
-    if (firstWhitespaceIdx == std::string::npos) {
-        return std::vector{
-            Token::createDirective(stringToDirective.at(directiveLiteral))};
+    if (firstWhitespaceIdx == std::string_view::npos) {
+        assemblerState.tokens.push_back(
+            Token::createDirective(*directiveType));
+        return;
+    }
+    if (*directiveType == Directive::GLOBAL) {
+        // .global name: the name follows the directive as a label
+        const std::string_view symbol =
+            Lexer::trimWhitespace(directive.substr(firstWhitespaceIdx + 1));
+        if (symbol.empty() || !Lexer::isLabelName(symbol)) {
+            throw std::runtime_error("Invalid .global symbol on line " +
+                                     std::to_string(lineNum) + ": " +
+                                     std::string(symbol));
+        }
+        assemblerState.tokens.push_back(
+            Token::createDirective(*directiveType));
+        assemblerState.tokens.push_back(
+            Token::createLabel(Label{std::string(symbol)}));
+        return;
     }
 
     throw std::runtime_error("Directive parsing not fully implemented");
 }
 
-auto Lexer::trimWhitespace(const std::string &line) -> std::string {
+void Lexer::processConstant(std::string_view arguments, const int lineNum,
+                            Expressions &expressions) {
+    // .equ NAME, expression
+    size_t start = 0;
+    const std::string_view name =
+        Lexer::nextArgument(arguments, start, lineNum);
+    if (start == std::string_view::npos || !Lexer::isLabelName(name)) {
+        throw std::runtime_error("Expected .equ name, value on line " +
+                                 std::to_string(lineNum));
+    }
+    const Expressions::Mark mark = expressions.mark();
+    uint32_t root = Lexer::processExpression(
+        Lexer::trimWhitespace(arguments.substr(start)), lineNum, expressions);
+    const std::optional<int64_t> value = expressions.fold(root);
+    if (value) {
+        // Keep just the value, for later expressions to fold
+        expressions.rewind(mark);
+        root = expressions.number(*value);
+    }
+    if (!expressions.define(name, root)) {
+        throw std::runtime_error("Duplicate constant on line " +
+                                 std::to_string(lineNum) + ": " +
+                                 std::string(name));
+    }
+}
+
+auto Lexer::trimWhitespace(std::string_view line) -> std::string_view {
     size_t start =
         line.find_first_not_of(" \n\t\r"); // Find first non whitespace
-    if (start == std::string::npos) {
+    if (start == std::string_view::npos) {
         return "";
     }
     size_t end = line.find_last_not_of(" \n\t\r");
@@ -224,17 +573,13 @@ auto Lexer::trimWhitespace(const std::string &line) -> std::string {
     return line.substr(start, end - start + 1);
 }
 
-auto Lexer::trimComments(const std::string &line) -> std::string {
-    size_t end = std::string::npos;
-    for (size_t i = 0; i < line.size(); i++) {
-        if (line[i] == ';' ||
-            ((i + 1) < line.size() && line.substr(i, 2) == "//")) {
-            end = i;
-            break;
+auto Lexer::trimComments(std::string_view line) -> std::string_view {
+    size_t i = line.find_first_of(";/");
+    while (i != std::string_view::npos) {
+        if (line[i] == ';' || line.substr(i, 2) == "//") {
+            return line.substr(0, i);
         }
+        i = line.find_first_of(";/", i + 1);
     }
-    if (end == 0) {
-        return "";
-    }
-    return line.substr(0, end);
+    return line;
 }
@@ -0,0 +1,205 @@
+#include "linker.h"
+#include "encoding.h"
+#include "object_file.h"
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Global symbols of every unit, to their address in the image. Each name
+// belongs to one shard, chosen by the top bits of its hash (SymbolTable
+// probes with the low bits), and only its shard is locked to add it.
+class SharedSymbols {
+  private:
+    static constexpr unsigned SHARD_BITS = 6;
+
+    struct Shard {
+        std::mutex mutex;
+        SymbolTable<int> symbols;
+    };
+
+    std::array<Shard, size_t{1} << SHARD_BITS> shards;
+
+    auto shardOf(std::string_view name) -> Shard & {
+        return this->shards[std::hash<std::string_view>()(name) >>
+                            (std::numeric_limits<size_t>::digits -
+                             SHARD_BITS)];
+    }
+
+  public:
+    // Returns false if another unit already defined the name
+    auto define(std::string_view name, int address) -> bool {
+        Shard &shard = this->shardOf(name);
+        const std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.symbols.insert(name, address);
+    }
+
+    // Only once every define has returned, so no lock is needed
+    auto find(std::string_view name) -> const int * {
+        return this->shardOf(name).symbols.find(name);
+    }
+};
+
+auto threadCount(unsigned threads, size_t work) -> size_t {
+    if (threads == 0) {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    return std::max<size_t>(1, std::min<size_t>(threads, work));
+}
+
+// Calls work(first, last) for runs of consecutive indices in [0, count), one
+// run per thread, and rethrows the first error once every thread is done
+template <typename Work>
+void forEachRun(size_t count, unsigned threads, const Work &work) {
+    const size_t runs = threadCount(threads, count);
+    if (runs == 1) {
+        work(size_t{0}, count);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(runs);
+    std::vector<std::thread> workers;
+    workers.reserve(runs);
+    for (size_t run{0}; run < runs; run++) {
+        workers.emplace_back([&, run] {
+            try {
+                work(count * run / runs, count * (run + 1) / runs);
+            } catch (...) {
+                errors[run] = std::current_exception();
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+} // namespace
+
+void Linker::relocate(const Relocation &relocation, int pc, int target,
+                      std::string_view name, uint32_t &word) {
+    const int offset = (target - pc) / 4;
+    const int limit = 1 << (relocation.width - 1);
+    if (offset < -limit || offset >= limit) {
+        throw std::runtime_error("Symbol " + std::string(name) +
+                                 " is out of range of the instruction");
+    }
+    const OperandField field{FieldKind::PCREL, relocation.lsb,
+                             relocation.width};
+    word = (word & ~fieldMask(field)) |
+           ((static_cast<uint32_t>(offset) << field.lsb) & fieldMask(field));
+}
+
+auto Linker::load(std::span<const std::span<const std::byte>> objects,
+                  unsigned threads) -> std::vector<ObjectFile> {
+    std::vector<ObjectFile> units(objects.size());
+    forEachRun(objects.size(), threads, [&](size_t first, size_t last) {
+        for (size_t i{first}; i < last; i++) {
+            units[i] = ObjectFile::load(objects[i]);
+        }
+    });
+    return units;
+}
+
+auto Linker::link(std::span<const ObjectFile> units, unsigned threads)
+    -> Image {
+    // Where each unit's sections go: a prefix sum, cheap next to the rest
+    std::vector<std::array<int, SECTION_COUNT>> unitBases(units.size());
+    Image image;
+    size_t address{0};
+    for (size_t section{0}; section < SECTION_COUNT; section++) {
+        size_t alignment{4};
+        for (const ObjectFile &unit : units) {
+            alignment = std::max(
+                alignment, static_cast<size_t>(unit.alignments[section]));
+        }
+        address = alignUp(address, alignment);
+        image.sectionBases[section] = static_cast<int>(address);
+        for (size_t i{0}; i < units.size(); i++) {
+            // Zero words fill the gap before an aligned unit
+            address = alignUp(
+                address, static_cast<size_t>(units[i].alignments[section]));
+            unitBases[i][section] = static_cast<int>(address);
+            address += units[i].sections[section].size() * 4;
+        }
+    }
+    if (address > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error("Linked image is too large");
+    }
+    image.words.resize(address / 4);
+
+    SharedSymbols globals;
+    forEachRun(units.size(), threads, [&](size_t first, size_t last) {
+        for (size_t i{first}; i < last; i++) {
+            const ObjectFile &unit = units[i];
+            for (size_t section{0}; section < SECTION_COUNT; section++) {
+                std::copy(unit.sections[section].begin(),
+                          unit.sections[section].end(),
+                          image.words.begin() + unitBases[i][section] / 4);
+            }
+            for (const ObjectSymbol &symbol : unit.symbols) {
+                if (symbol.binding == SymbolBinding::GLOBAL &&
+                    !globals.define(
+                        unit.nameOf(symbol),
+                        unitBases[i][static_cast<size_t>(symbol.section)] +
+                            symbol.offset)) {
+                    throw std::runtime_error(
+                        "Duplicate global symbol: " +
+                        std::string(unit.nameOf(symbol)));
+                }
+            }
+        }
+    });
+
+    // Each unit's relocations only touch its own words
+    forEachRun(units.size(), threads, [&](size_t first, size_t last) {
+        for (size_t i{first}; i < last; i++) {
+            const ObjectFile &unit = units[i];
+            for (const Relocation &relocation : unit.relocations) {
+                const ObjectSymbol &symbol = unit.symbols[relocation.symbol];
+                const std::string_view name = unit.nameOf(symbol);
+                int target{0};
+                if (symbol.binding == SymbolBinding::UNDEFINED) {
+                    const int *global = globals.find(name);
+                    if (global == nullptr) {
+                        throw std::runtime_error("Undefined symbol: " +
+                                                 std::string(name));
+                    }
+                    target = *global;
+                } else {
+                    target =
+                        unitBases[i][static_cast<size_t>(symbol.section)] +
+                        symbol.offset;
+                }
+                const int pc =
+                    unitBases[i][static_cast<size_t>(relocation.section)] +
+                    static_cast<int>(relocation.offset);
+                Linker::relocate(relocation, pc, target, name,
+                                 image.words[static_cast<size_t>(pc) / 4]);
+            }
+        }
+    });
+
+    if (const int *entry = globals.find("_start")) {
+        image.entry = *entry;
+    }
+    return image;
+}
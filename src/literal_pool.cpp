@@ -0,0 +1,200 @@
+#include "literal_pool.h"
+#include "section.h"
+#include "token.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace {
+
+// Furthest forward an LDR (literal) reaches, in bytes (19-bit word offset)
+constexpr int LITERAL_REACH = ((1 << 18) - 1) * 4;
+// Checks run before each line, so a pool may have to go after the next
+// instruction (8 bytes if it is a branch relaxation expands)
+constexpr int LOOKAHEAD = 8;
+// Bigger pools are split, so that no load is ever left out of range
+constexpr int MAX_POOL_SIZE = 1 << 16;
+constexpr size_t MIN_SLOTS = 16;
+
+auto sectionIndex(Section section) -> size_t {
+    return static_cast<size_t>(section);
+}
+
+// Whether the pool's spare word goes before its data, to align its X values
+auto leadingSpare(const LiteralPool &pool) -> bool {
+    return pool.wideBytes > 0 &&
+           (pool.offset + (pool.branchOver ? 4 : 0)) % 8 != 0;
+}
+
+} // namespace
+
+auto LiteralPools::slotFor(uint64_t value, Section section,
+                           bool is64Bit) const -> size_t {
+    const size_t mask = this->slots.size() - 1;
+    const uint64_t key = value ^ (static_cast<uint64_t>(is64Bit) << 63U) ^
+                         static_cast<uint64_t>(section);
+    size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32U) &
+                  mask;
+    // Entries of closed pools are never matched, so they are skipped over
+    // until the next rehash drops them
+    while (this->slots[slot] != 0) {
+        const LiteralEntry &entry = this->entries[this->slots[slot] - 1];
+        if (entry.pool == NO_LITERAL && entry.value == value &&
+            entry.section == section && entry.is64Bit == is64Bit) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void LiteralPools::rehash(size_t capacity) {
+    this->slots.assign(capacity, 0);
+    this->usedSlots = 0;
+    for (const OpenPool &open : this->open) {
+        for (const uint32_t index : open.entries) {
+            const LiteralEntry &entry = this->entries[index];
+            this->slots[this->slotFor(entry.value, entry.section,
+                                      entry.is64Bit)] = index + 1;
+            this->usedSlots++;
+        }
+    }
+}
+
+auto LiteralPools::add(Section section, uint64_t value, bool is64Bit, int pc)
+    -> uint32_t {
+    if ((this->usedSlots + 1) * 2 > this->slots.size()) {
+        size_t openEntries{0};
+        for (const OpenPool &open : this->open) {
+            openEntries += open.entries.size();
+        }
+        this->rehash(std::max({MIN_SLOTS, this->slots.size(),
+                               std::bit_ceil((openEntries + 1) * 4)}));
+    }
+
+    const size_t slot = this->slotFor(value, section, is64Bit);
+    if (this->slots[slot] != 0) {
+        return this->slots[slot] - 1; // Shared with an earlier load
+    }
+
+    OpenPool &open = this->open[sectionIndex(section)];
+    int &bytes = is64Bit ? open.wideBytes : open.narrowBytes;
+    const auto index = static_cast<uint32_t>(this->entries.size());
+    this->entries.push_back(
+        LiteralEntry{value, section, is64Bit, bytes, NO_LITERAL});
+    this->slots[slot] = index + 1;
+    this->usedSlots++;
+
+    int &worst = is64Bit ? open.worstWide : open.worstNarrow;
+    worst = std::max(worst, bytes - pc);
+    open.entries.push_back(index);
+    bytes += is64Bit ? 8 : 4;
+    return index;
+}
+
+void LiteralPools::noteRelaxableBranch(Section section) {
+    OpenPool &open = this->open[sectionIndex(section)];
+    if (!open.entries.empty()) {
+        open.relaxableBranches++;
+    }
+}
+
+auto LiteralPools::mustFlush(Section section, int pc) const -> bool {
+    const OpenPool &open = this->open[sectionIndex(section)];
+    if (open.entries.empty()) {
+        return false;
+    }
+    // Placed after the lookahead, a branch over it, a leading spare word
+    // and every branch that may yet be expanded. W values follow the X ones.
+    const int poolData = pc + LOOKAHEAD + 4 + (open.wideBytes > 0 ? 4 : 0) +
+                         4 * open.relaxableBranches;
+    const int worstDistance =
+        std::max(open.worstWide, open.wideBytes + open.worstNarrow);
+    return poolData + worstDistance > LITERAL_REACH ||
+           open.size() >= MAX_POOL_SIZE;
+}
+
+auto LiteralPools::flush(Section section, int offset, bool branchOver)
+    -> uint32_t {
+    OpenPool &open = this->open[sectionIndex(section)];
+    if (open.entries.empty()) {
+        return NO_LITERAL;
+    }
+    const auto index = static_cast<uint32_t>(this->pools.size());
+    this->pools.push_back(LiteralPool{
+        section, offset, branchOver, open.size() + (branchOver ? 4 : 0),
+        open.wideBytes, static_cast<uint32_t>(this->pooledEntries.size()),
+        static_cast<uint32_t>(open.entries.size())});
+    // X values first, each keeping its offset among them
+    for (const bool wide : {true, false}) {
+        for (const uint32_t entry : open.entries) {
+            LiteralEntry &literal = this->entries[entry];
+            if (literal.is64Bit == wide) {
+                literal.pool = index;
+                literal.offset += wide ? 0 : open.wideBytes;
+                this->pooledEntries.push_back(entry);
+            }
+        }
+    }
+    open.clear();
+    return index;
+}
+
+auto LiteralPools::pool(uint32_t index) const -> const LiteralPool & {
+    return this->pools[index];
+}
+
+void LiteralPools::movePool(uint32_t index, int offset) {
+    this->pools[index].offset = offset;
+}
+
+auto LiteralPools::entryLocation(uint32_t entry) const -> LabelAddress {
+    const LiteralEntry &literal = this->entries[entry];
+    const LiteralPool &pool = this->pools[literal.pool];
+    return LabelAddress{literal.section,
+                        pool.offset + (pool.branchOver ? 4 : 0) +
+                            (leadingSpare(pool) ? 4 : 0) + literal.offset};
+}
+
+auto LiteralPools::entryCount() const -> size_t {
+    return this->entries.size();
+}
+
+void LiteralPools::write(uint32_t index, uint32_t branchWord,
+                         std::span<uint32_t> out) const {
+    const LiteralPool &pool = this->pools[index];
+    size_t word{0};
+    if (pool.branchOver) {
+        out[word++] = branchWord;
+    }
+    if (leadingSpare(pool)) {
+        out[word++] = 0;
+    }
+    // Values are little-endian, low word first
+    for (uint32_t i{0}; i < pool.entryCount; i++) {
+        const LiteralEntry &entry =
+            this->entries[this->pooledEntries[pool.firstEntry + i]];
+        out[word++] = static_cast<uint32_t>(entry.value);
+        if (entry.is64Bit) {
+            out[word++] = static_cast<uint32_t>(entry.value >> 32U);
+        }
+    }
+    if (word < static_cast<size_t>(pool.size / 4)) {
+        out[word] = 0; // The spare word, after the data
+    }
+}
+
+void LiteralPools::clear() {
+    this->entries.clear();
+    this->pooledEntries.clear();
+    this->pools.clear();
+    for (OpenPool &open : this->open) {
+        open.clear();
+    }
+    std::fill(this->slots.begin(), this->slots.end(), 0);
+    this->usedSlots = 0;
+}
@@ -1,6 +1,369 @@
+#include "assembler_state.h"
+#include "batch_encoder.h"
+#include "debug_line.h"
+#include "disassembler.h"
+#include "image_writer.h"
+#include "input_stream.h"
+#include "lexer.h"
+#include "linker.h"
+#include "mapped_file.h"
+#include "object_file.h"
+#include "output_cache.h"
+#include "parser.h"
+#include "token_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The input name that reads source from stdin as it arrives
+constexpr std::string_view STDIN_INPUT = "-";
+
+enum class Mode {
+    ASSEMBLE,
+    EMIT_TOKENS,
+    FROM_TOKENS,
+    OBJECT,
+    LINK,
+    DISASSEMBLE,
+    CACHE_STATS,
+};
+
+struct Options {
+    Mode mode{Mode::ASSEMBLE};
+    std::string input;
+    std::vector<std::string> objects; // Inputs of --link
+    ImageFormat format{ImageFormat::BINARY};
+    uint32_t loadAddress{0};
+    bool hasFormat{false}; // -O or --base
+    bool optimize{false};  // -O1
+    std::string output{"a.out"};
+    bool hasOutput{false};
+    std::optional<std::string> cacheDir;
+    std::optional<std::string> debugLine; // Where to write .debug_line
+};
+
+auto readFile(const std::string &path) -> std::string {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    return {std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>()};
+}
+
+void writeBytes(const std::string &path, std::span<const std::byte> bytes) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    file.write(reinterpret_cast<const char *>(bytes.data()),
+               static_cast<std::streamsize>(bytes.size()));
+}
+
+auto readWords(const std::string &path) -> std::vector<uint32_t> {
+    const std::string bytes = readFile(path);
+    if (bytes.size() % 4 != 0) {
+        throw std::runtime_error(path + " is not a whole number of words");
+    }
+    std::vector<uint32_t> words(bytes.size() / 4);
+    for (size_t i{0}; i < words.size(); i++) {
+        for (size_t byte{0}; byte < 4; byte++) {
+            words[i] |= static_cast<uint32_t>(
+                            static_cast<unsigned char>(bytes[i * 4 + byte]))
+                        << (byte * 8);
+        }
+    }
+    return words;
+}
+
+// Source from the input file, or from stdin while it is being written
+void tokenizeSource(const Options &options, AssemblerState &state) {
+    if (options.input == STDIN_INPUT) {
+        InputStream input(STDIN_FILENO);
+        Lexer::tokenizeStream(input, state, "<stdin>");
+    } else {
+        Lexer::tokenize(readFile(options.input), state, options.input);
+    }
+}
+
+// Assembles source or a token cache, as the mode says
+auto assembleInput(const Options &options, std::span<const std::byte> input)
+    -> Image {
+    AssemblerState state;
+    state.loadAddress = options.loadAddress;
+    state.optimize = options.optimize;
+    if (options.mode == Mode::FROM_TOKENS) {
+        // Lexing is skipped: the tokens are read straight from the cache
+        TokenCache::load(input, state);
+    } else if (options.input == STDIN_INPUT) {
+        tokenizeSource(options, state);
+    } else {
+        Lexer::tokenize(
+            std::string_view(reinterpret_cast<const char *>(input.data()),
+                             input.size()),
+            state, options.input);
+    }
+    Parser::parse(state);
+    BatchEncoder::encode(state);
+    if (options.debugLine) {
+        writeBytes(*options.debugLine, DebugLine::emit(state));
+    }
+    Image image{std::move(state.machineCode), {}, std::nullopt};
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        image.sectionBases[i] = state.sections[i].base;
+    }
+    if (const LabelAddress *entry = state.labelToAddress.find("_start")) {
+        image.entry = state.addressOf(*entry);
+    }
+    return image;
+}
+
+void assembleFile(const Options &options) {
+    if (options.input == STDIN_INPUT) {
+        ImageWriter::write(options.output, assembleInput(options, {}),
+                           options.format, options.loadAddress);
+        return;
+    }
+    const MappedFile input(options.input);
+    if (!options.cacheDir) {
+        ImageWriter::write(options.output,
+                           assembleInput(options, input.bytes()),
+                           options.format, options.loadAddress);
+        return;
+    }
+    // Source and token caches of the same program are different inputs, so
+    // the mode and the options shaping the output make up the key
+    OutputCache cache(*options.cacheDir);
+    std::string keyOptions =
+        options.mode == Mode::FROM_TOKENS ? "from-tokens" : "assemble";
+    keyOptions.append(" format=")
+        .append(std::to_string(static_cast<int>(options.format)))
+        .append(" base=")
+        .append(std::to_string(options.loadAddress))
+        .append(options.optimize ? " -O1" : "");
+    const std::string key = OutputCache::keyOf(input.bytes(), keyOptions);
+    if (const std::optional<MappedFile> cached = cache.lookup(key)) {
+        writeBytes(options.output, cached->bytes());
+        return;
+    }
+    ImageWriter::write(options.output, assembleInput(options, input.bytes()),
+                       options.format, options.loadAddress);
+    cache.store(key, MappedFile(options.output).bytes());
+}
+
+void emitTokens(const Options &options) {
+    AssemblerState state;
+    tokenizeSource(options, state);
+    writeBytes(options.output, TokenCache::serialize(state));
+}
+
+void assembleObject(const Options &options) {
+    AssemblerState state;
+    state.relocatable = true;
+    state.optimize = options.optimize;
+    tokenizeSource(options, state);
+    Parser::parse(state);
+    BatchEncoder::encode(state);
+    writeBytes(options.output, ObjectFile::fromState(state).serialize());
+}
+
+void linkObjects(const Options &options) {
+    std::vector<MappedFile> files;
+    std::vector<std::span<const std::byte>> objects;
+    files.reserve(options.objects.size());
+    for (const std::string &path : options.objects) {
+        objects.push_back(files.emplace_back(path).bytes());
+    }
+    ImageWriter::write(options.output, Linker::link(Linker::load(objects)),
+                       options.format, options.loadAddress);
+}
+
+void disassembleFile(const std::string &inputPath) {
+    const std::vector<uint32_t> words = readWords(inputPath);
+    std::vector<DecodedInstruction> decoded(words.size());
+    Disassembler::decode(words, decoded);
+    for (size_t i{0}; i < decoded.size(); i++) {
+        std::printf("%8zx:  %08x  %s\n", i * 4, words[i],
+                    Disassembler::toText(decoded[i], static_cast<int>(i * 4))
+                        .c_str());
+    }
+}
+
+void printCacheStats(const std::string &directory) {
+    const CacheStats stats = OutputCache(directory).totalStats();
+    const uint64_t lookups = stats.hits + stats.misses;
+    std::printf("%llu lookups, %llu hits, %llu misses (%.1f%% hit rate)\n",
+                static_cast<unsigned long long>(lookups),
+                static_cast<unsigned long long>(stats.hits),
+                static_cast<unsigned long long>(stats.misses),
+                lookups == 0 ? 0.0
+                             : 100.0 * static_cast<double>(stats.hits) /
+                                   static_cast<double>(lookups));
+}
+
+void printUsage() {
+    std::cerr
+        << "Usage: assembler <input.s> [-o <output>] [--cache-dir <dir>]\n"
+        << "                 [--debug-line <output.debug_line>] [-O1] "
+           "[<image>]\n"
+        << "       assembler --emit-tokens <input.s> -o <output.tok>\n"
+        << "       assembler --from-tokens <input.tok> [-o <output>] "
+           "[--cache-dir <dir>]\n"
+        << "                 [--debug-line <output.debug_line>] [-O1] "
+           "[<image>]\n"
+        << "       assembler -c <input.s> -o <output.o> [-O1]\n"
+        << "       assembler --link <input.o>... [-o <output>] [<image>]\n"
+        << "       assembler --disasm <input.bin>\n"
+        << "       assembler --cache-stats <dir>\n"
+        << "where <image> is [-O binary|ihex|elf] [--base <load address>]\n"
+        << "and <input.s> is - to read source from stdin as it arrives\n";
+}
+
+auto parseFormat(const std::string &name) -> std::optional<ImageFormat> {
+    if (name == "binary") {
+        return ImageFormat::BINARY;
+    }
+    if (name == "ihex") {
+        return ImageFormat::IHEX;
+    }
+    if (name == "elf") {
+        return ImageFormat::ELF;
+    }
+    return std::nullopt;
+}
+
+// Decimal, or hex with 0x
+auto parseAddress(const std::string &text) -> std::optional<uint32_t> {
+    char *end = nullptr;
+    const unsigned long long address = std::strtoull(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0' || text[0] == '-' ||
+        address > UINT32_MAX) {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(address);
+}
+
+// Returns nullopt if the arguments do not match the usage
+auto parseOptions(const std::vector<std::string> &args)
+    -> std::optional<Options> {
+    Options options;
+    bool hasInput = false;
+    for (size_t i{0}; i < args.size(); i++) {
+        const std::string &arg = args[i];
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "-o" && hasValue) {
+            options.output = args[++i];
+            options.hasOutput = true;
+        } else if (arg == "--cache-dir" && hasValue) {
+            options.cacheDir = args[++i];
+        } else if (arg == "--debug-line" && hasValue) {
+            options.debugLine = args[++i];
+        } else if (i == 0 && arg == "--emit-tokens") {
+            options.mode = Mode::EMIT_TOKENS;
+        } else if (i == 0 && arg == "--from-tokens") {
+            options.mode = Mode::FROM_TOKENS;
+        } else if (i == 0 && arg == "-c") {
+            options.mode = Mode::OBJECT;
+        } else if (i == 0 && arg == "--link") {
+            options.mode = Mode::LINK;
+        } else if (arg == "-O" && hasValue && parseFormat(args[i + 1])) {
+            options.format = *parseFormat(args[++i]);
+            options.hasFormat = true;
+        } else if (arg == "-O0" || arg == "-O1") {
+            options.optimize = arg == "-O1";
+        } else if (arg == "--base" && hasValue &&
+                   parseAddress(args[i + 1])) {
+            options.loadAddress = *parseAddress(args[++i]);
+            options.hasFormat = true;
+        } else if (options.mode == Mode::LINK && !arg.starts_with("-")) {
+            options.objects.push_back(arg);
+            hasInput = true;
+        } else if (i == 0 && arg == "--disasm") {
+            options.mode = Mode::DISASSEMBLE;
+        } else if (i == 0 && arg == "--cache-stats") {
+            options.mode = Mode::CACHE_STATS;
+        } else if (!hasInput &&
+                   (arg == STDIN_INPUT || !arg.starts_with("-"))) {
+            options.input = arg;
+            hasInput = true;
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    const bool assembles =
+        options.mode == Mode::ASSEMBLE || options.mode == Mode::FROM_TOKENS;
+    const bool writesFile = options.mode != Mode::DISASSEMBLE &&
+                            options.mode != Mode::CACHE_STATS;
+    // Source from stdin is streamed, so it cannot be part of a cache key
+    const bool readsSource = options.mode == Mode::ASSEMBLE ||
+                             options.mode == Mode::EMIT_TOKENS ||
+                             options.mode == Mode::OBJECT;
+    const bool fromStdin = options.input == STDIN_INPUT;
+    // A cache hit skips assembling, so it would leave .debug_line unwritten
+    if (!hasInput || (options.cacheDir && !assembles) ||
+        (fromStdin && (!readsSource || options.cacheDir)) ||
+        (options.debugLine && (!assembles || options.cacheDir)) ||
+        (options.hasOutput && !writesFile) ||
+        (options.hasFormat && !assembles && options.mode != Mode::LINK) ||
+        (options.optimize && !assembles && options.mode != Mode::OBJECT) ||
+        ((options.mode == Mode::EMIT_TOKENS || options.mode == Mode::OBJECT) &&
+         !options.hasOutput)) {
+        return std::nullopt;
+    }
+    return options;
+}
+
+} // namespace
 
-auto main() -> int {
-    std::cout << "Hello World" << "\n";
+auto main(int argc, char *argv[]) -> int {
+    const std::optional<Options> options =
+        parseOptions(std::vector<std::string>(argv + 1, argv + argc));
+    if (!options) {
+        printUsage();
+        return 1;
+    }
+    try {
+        switch (options->mode) {
+        case Mode::ASSEMBLE:
+        case Mode::FROM_TOKENS:
+            assembleFile(*options);
+            break;
+        case Mode::EMIT_TOKENS:
+            emitTokens(*options);
+            break;
+        case Mode::OBJECT:
+            assembleObject(*options);
+            break;
+        case Mode::LINK:
+            linkObjects(*options);
+            break;
+        case Mode::DISASSEMBLE:
+            disassembleFile(options->input);
+            break;
+        case Mode::CACHE_STATS:
+            printCacheStats(options->input);
+            break;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
     return 0;
 }
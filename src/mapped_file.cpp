@@ -0,0 +1,79 @@
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+MappedFile::MappedFile(const std::string &path) {
+    const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    struct stat status {};
+    if (fstat(file, &status) != 0) {
+        close(file);
+        throw std::runtime_error("Could not read the size of " + path);
+    }
+    this->length = static_cast<size_t>(status.st_size);
+    if (this->length > 0) { // Empty files cannot be mapped
+        void *mapping =
+            mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping == MAP_FAILED) {
+            close(file);
+            throw std::runtime_error("Could not map " + path);
+        }
+        this->data = static_cast<const std::byte *>(mapping);
+    }
+    // The mapping keeps its own reference to the file
+    close(file);
+}
+
+MappedFile::~MappedFile() {
+    if (this->data != nullptr) {
+        munmap(const_cast<std::byte *>(this->data), this->length);
+    }
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data(std::exchange(other.data, nullptr)),
+      length(std::exchange(other.length, 0)) {}
+
+auto MappedFile::operator=(MappedFile &&other) noexcept -> MappedFile & {
+    std::swap(this->data, other.data);
+    std::swap(this->length, other.length);
+    return *this;
+}
+
+MappedOutput::MappedOutput(const std::string &path, size_t size)
+    : length(size) {
+    const int file =
+        open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0) {
+        throw std::runtime_error("Could not create " + path);
+    }
+    if (size > 0) {
+        if (posix_fallocate(file, 0, static_cast<off_t>(size)) != 0) {
+            close(file);
+            throw std::runtime_error("Could not allocate " + path);
+        }
+        void *mapping =
+            mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (mapping == MAP_FAILED) {
+            close(file);
+            throw std::runtime_error("Could not map " + path);
+        }
+        this->data = static_cast<std::byte *>(mapping);
+    }
+    close(file);
+}
+
+MappedOutput::~MappedOutput() {
+    if (this->data != nullptr) {
+        munmap(this->data, this->length);
+    }
+}
@@ -0,0 +1,260 @@
+#include "object_file.h"
+#include "byte_buffer.h"
+#include "encoding.h"
+#include "symbol_table.h"
+#include "token.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC = {'A', 'R', 'M', 'O',
+                                       'B', 'J', '\0', '\0'};
+
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    std::array<uint32_t, SECTION_COUNT> sectionWords;
+    std::array<uint32_t, SECTION_COUNT> sectionAlignments;
+    uint32_t symbolCount;
+    uint32_t relocationCount;
+    uint32_t nameBytes;
+};
+
+struct SymbolRecord {
+    uint32_t nameOffset;
+    uint32_t nameSize;
+    uint8_t binding;
+    uint8_t section;
+    uint16_t padding;
+    int32_t offset;
+};
+
+struct RelocationRecord {
+    uint32_t offset;
+    uint32_t symbol;
+    uint8_t section;
+    uint8_t lsb;
+    uint8_t width;
+    uint8_t padding;
+};
+
+// Past what any section asks for, so a corrupt value cannot pad the image
+// out to gigabytes
+constexpr uint32_t MAX_SECTION_ALIGNMENT = 4096;
+
+auto corrupt() -> std::runtime_error {
+    return std::runtime_error("Object file is corrupt");
+}
+
+// Builds the symbol list, adding each name once
+class SymbolList {
+  private:
+    SymbolTable<uint32_t> indices;
+    ObjectFile &object;
+
+  public:
+    explicit SymbolList(ObjectFile &object) : object(object) {}
+
+    auto indexOf(std::string_view name, SymbolBinding binding,
+                 LabelAddress address) -> uint32_t {
+        const auto index = static_cast<uint32_t>(this->object.symbols.size());
+        if (!this->indices.insert(name, index)) {
+            return *this->indices.find(name);
+        }
+        this->object.symbols.push_back(ObjectSymbol{
+            static_cast<uint32_t>(this->object.names.size()),
+            static_cast<uint32_t>(name.size()), binding, address.section,
+            address.offset});
+        this->object.names.append(name);
+        return index;
+    }
+};
+
+// The field a label argument of the instruction is written to
+auto labelField(Mnemonic mnemonic, ArgFormat format) -> OperandField {
+    const InstructionEncoding *encoding = findEncoding(mnemonic, format);
+    for (size_t i{0}; i < encoding->operandCount; i++) {
+        if (encoding->fields[i].kind == FieldKind::PCREL) {
+            return encoding->fields[i];
+        }
+    }
+    throw std::runtime_error("Label argument without a PC-relative field");
+}
+
+} // namespace
+
+auto ObjectFile::fromState(const AssemblerState &assemblerState)
+    -> ObjectFile {
+    ObjectFile object;
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        const SectionBuffer &section = assemblerState.sections[i];
+        const auto first =
+            assemblerState.machineCode.begin() + section.base / 4;
+        object.sections[i].assign(first, first + section.size / 4);
+        object.alignments[i] = section.alignment;
+    }
+
+    SymbolList symbols(object);
+    assemblerState.globalSymbols.forEach(
+        [&](std::string_view name, size_t token) {
+            const LabelAddress *address =
+                assemblerState.labelToAddress.find(name);
+            if (address == nullptr) {
+                // Likely a typo, which would otherwise only surface at link
+                // time as an unrelated undefined symbol
+                throw assemblerState.errorAt(
+                    token, std::string("Global symbol ")
+                               .append(name)
+                               .append(" is not defined"));
+            }
+            symbols.indexOf(name, SymbolBinding::GLOBAL, *address);
+        });
+
+    std::array<int, SECTION_COUNT> offsets{};
+    for (const Instruction &instruction : assemblerState.instructions) {
+        int &offset = offsets[static_cast<size_t>(instruction.section)];
+        const auto tokens = assemblerState.tokensOf(instruction);
+        // Expanded branches only ever target their own section
+        if (instruction.format && instruction.size == 4 &&
+            tokens.back().type == TokenType::Label) {
+            const std::string_view name =
+                std::get<Label>(tokens.back().token).val;
+            const LabelAddress *target =
+                assemblerState.labelToAddress.find(name);
+            if (target == nullptr || target->section != instruction.section) {
+                const OperandField field =
+                    labelField(std::get<Mnemonic>(tokens[0].token),
+                               *instruction.format);
+                // Globals are already listed, so a defined label new to
+                // the list is local
+                const uint32_t symbol =
+                    target == nullptr
+                        ? symbols.indexOf(name, SymbolBinding::UNDEFINED,
+                                          LabelAddress{Section::TEXT, 0})
+                        : symbols.indexOf(name, SymbolBinding::LOCAL, *target);
+                object.relocations.push_back(
+                    Relocation{instruction.section, field.lsb, field.width,
+                               static_cast<uint32_t>(offset), symbol});
+            }
+        }
+        offset += instruction.size;
+    }
+    return object;
+}
+
+auto ObjectFile::serialize() const -> std::vector<std::byte> {
+    Header header{MAGIC, OBJECT_FILE_VERSION, {}, {},
+                  static_cast<uint32_t>(this->symbols.size()),
+                  static_cast<uint32_t>(this->relocations.size()),
+                  static_cast<uint32_t>(this->names.size())};
+    size_t words{0};
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        header.sectionWords[i] =
+            static_cast<uint32_t>(this->sections[i].size());
+        header.sectionAlignments[i] =
+            static_cast<uint32_t>(this->alignments[i]);
+        words += this->sections[i].size();
+    }
+
+    std::vector<std::byte> out;
+    out.reserve(sizeof(Header) + words * 4 +
+                this->symbols.size() * sizeof(SymbolRecord) +
+                this->relocations.size() * sizeof(RelocationRecord) +
+                this->names.size());
+    appendBytes(out, header);
+    for (const auto &section : this->sections) {
+        for (const uint32_t word : section) {
+            appendBytes(out, word);
+        }
+    }
+    for (const ObjectSymbol &symbol : this->symbols) {
+        appendBytes(out, SymbolRecord{symbol.nameOffset, symbol.nameSize,
+                                      static_cast<uint8_t>(symbol.binding),
+                                      static_cast<uint8_t>(symbol.section), 0,
+                                      symbol.offset});
+    }
+    for (const Relocation &relocation : this->relocations) {
+        appendBytes(out, RelocationRecord{
+                             relocation.offset, relocation.symbol,
+                             static_cast<uint8_t>(relocation.section),
+                             relocation.lsb, relocation.width, 0});
+    }
+    const auto *names = reinterpret_cast<const std::byte *>(this->names.data());
+    out.insert(out.end(), names, names + this->names.size());
+    return out;
+}
+
+auto ObjectFile::load(std::span<const std::byte> bytes) -> ObjectFile {
+    ByteReader reader(bytes, "Object file");
+    const auto header = reader.read<Header>();
+    if (header.magic != MAGIC) {
+        throw std::runtime_error("Not an object file");
+    }
+    if (header.version != OBJECT_FILE_VERSION) {
+        throw std::runtime_error("Object file is from another version");
+    }
+
+    ObjectFile object;
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        const uint32_t alignment = header.sectionAlignments[i];
+        if (alignment < 4 || alignment > MAX_SECTION_ALIGNMENT ||
+            !std::has_single_bit(alignment)) {
+            throw corrupt();
+        }
+        object.alignments[i] = static_cast<int>(alignment);
+        const auto words = reader.take(size_t{header.sectionWords[i]} * 4);
+        object.sections[i].resize(header.sectionWords[i]);
+        std::memcpy(object.sections[i].data(), words.data(), words.size());
+    }
+    const auto symbolRecords =
+        reader.take(size_t{header.symbolCount} * sizeof(SymbolRecord));
+    const auto relocationRecords = reader.take(
+        size_t{header.relocationCount} * sizeof(RelocationRecord));
+    object.names = reader.readString(header.nameBytes);
+    if (!reader.atEnd()) {
+        throw corrupt();
+    }
+
+    object.symbols.reserve(header.symbolCount);
+    for (size_t i{0}; i < header.symbolCount; i++) {
+        const auto record = recordAt<SymbolRecord>(symbolRecords, i);
+        if (record.nameOffset > object.names.size() ||
+            record.nameSize > object.names.size() - record.nameOffset ||
+            record.binding > static_cast<uint8_t>(SymbolBinding::UNDEFINED) ||
+            record.section >= SECTION_COUNT || record.offset < 0 ||
+            (record.binding != static_cast<uint8_t>(SymbolBinding::UNDEFINED) &&
+             static_cast<size_t>(record.offset) / 4 >
+                 object.sections[record.section].size())) {
+            throw corrupt();
+        }
+        object.symbols.push_back(ObjectSymbol{
+            record.nameOffset, record.nameSize,
+            static_cast<SymbolBinding>(record.binding),
+            static_cast<Section>(record.section), record.offset});
+    }
+    object.relocations.reserve(header.relocationCount);
+    for (size_t i{0}; i < header.relocationCount; i++) {
+        const auto record = recordAt<RelocationRecord>(relocationRecords, i);
+        if (record.section >= SECTION_COUNT || record.offset % 4 != 0 ||
+            record.offset / 4 >= object.sections[record.section].size() ||
+            record.symbol >= object.symbols.size() || record.width == 0 ||
+            record.lsb + record.width > 32) {
+            throw corrupt();
+        }
+        object.relocations.push_back(
+            Relocation{static_cast<Section>(record.section), record.lsb,
+                       record.width, record.offset, record.symbol});
+    }
+    return object;
+}
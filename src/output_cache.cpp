@@ -0,0 +1,224 @@
+#include "output_cache.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+constexpr uint64_t MIX = 0xBF58476D1CE4E5B9ULL;
+constexpr size_t LANES = 4;
+
+// Final avalanche of MurmurHash3, so that every input bit reaches every
+// output bit
+auto finalize(uint64_t hash) -> uint64_t {
+    hash ^= hash >> 33U;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33U;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    return hash ^ (hash >> 33U);
+}
+
+auto step(uint64_t lane, uint64_t word) -> uint64_t {
+    return std::rotl(lane ^ (word * MULTIPLIER), 31) * MIX;
+}
+
+// Four independent lanes of eight bytes each, so the multiplies of one
+// block overlap rather than wait on each other
+auto hashBytes(std::span<const std::byte> bytes, uint64_t seed) -> uint64_t {
+    std::array<uint64_t, LANES> lanes{};
+    for (size_t lane{0}; lane < LANES; lane++) {
+        lanes[lane] = seed + lane * MULTIPLIER;
+    }
+    size_t i{0};
+    for (; i + LANES * 8 <= bytes.size(); i += LANES * 8) {
+        for (size_t lane{0}; lane < LANES; lane++) {
+            uint64_t word{0};
+            std::memcpy(&word, bytes.data() + i + lane * 8, 8);
+            lanes[lane] = step(lanes[lane], word);
+        }
+    }
+    uint64_t hash = bytes.size() * MULTIPLIER;
+    for (const uint64_t lane : lanes) {
+        hash = step(hash, lane);
+    }
+    for (; i < bytes.size(); i += 8) {
+        uint64_t word{0};
+        std::memcpy(&word, bytes.data() + i,
+                    std::min<size_t>(8, bytes.size() - i));
+        hash = step(hash, word);
+    }
+    return finalize(hash);
+}
+
+auto asBytes(std::string_view text) -> std::span<const std::byte> {
+    return {reinterpret_cast<const std::byte *>(text.data()), text.size()};
+}
+
+// The counters file holds the hits, then the misses, of every process
+constexpr size_t HITS = 0;
+constexpr size_t MISSES = 1;
+constexpr size_t COUNTERS_SIZE = 2 * sizeof(uint64_t);
+
+static_assert(std::atomic_ref<uint64_t>::is_always_lock_free);
+
+// The directory's counters, mapped shared so that every process adds to the
+// same words. Unmapped (and so uncounted) if the file cannot be used.
+class Counters {
+  private:
+    uint64_t *words{nullptr};
+
+  public:
+    Counters(const std::filesystem::path &path, bool writable) {
+        const int file =
+            open(path.c_str(),
+                 writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC,
+                 0644);
+        if (file < 0) {
+            return;
+        }
+        // Growing a new file zeroes its counters, and every process sizes it
+        // the same, so doing it at once is harmless
+        struct stat info {};
+        const bool sized =
+            fstat(file, &info) == 0 &&
+            (static_cast<size_t>(info.st_size) == COUNTERS_SIZE ||
+             (writable && ftruncate(file, COUNTERS_SIZE) == 0));
+        void *mapping =
+            sized ? mmap(nullptr, COUNTERS_SIZE,
+                         writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                         MAP_SHARED, file, 0)
+                  : MAP_FAILED;
+        close(file);
+        if (mapping != MAP_FAILED) {
+            this->words = static_cast<uint64_t *>(mapping);
+        }
+    }
+
+    ~Counters() {
+        if (this->words != nullptr) {
+            munmap(this->words, COUNTERS_SIZE);
+        }
+    }
+
+    Counters(const Counters &) = delete;
+    auto operator=(const Counters &) -> Counters & = delete;
+    Counters(Counters &&) = delete;
+    auto operator=(Counters &&) -> Counters & = delete;
+
+    void add(size_t counter) {
+        if (this->words != nullptr) {
+            std::atomic_ref<uint64_t>(this->words[counter])
+                .fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] auto get(size_t counter) const -> uint64_t {
+        return this->words == nullptr
+                   ? 0
+                   : std::atomic_ref<uint64_t>(this->words[counter])
+                         .load(std::memory_order_relaxed);
+    }
+};
+
+// Writes every byte and flushes them to disk, so that a crash after the
+// rename cannot leave an empty or partial output in place
+auto writeDurably(int file, std::span<const std::byte> bytes) -> bool {
+    while (!bytes.empty()) {
+        const ssize_t written = write(file, bytes.data(), bytes.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes = bytes.subspan(static_cast<size_t>(written));
+    }
+    return fsync(file) == 0;
+}
+
+} // namespace
+
+OutputCache::OutputCache(std::filesystem::path directory)
+    : directory(std::move(directory)) {
+    std::filesystem::create_directories(this->directory);
+}
+
+auto OutputCache::keyOf(std::span<const std::byte> input,
+                        std::string_view options) -> std::string {
+    // The version and options seed the hash of the input, twice over with
+    // different seeds for 128 bits
+    const uint64_t setting = hashBytes(asBytes(ASSEMBLER_VERSION), 0) ^
+                             hashBytes(asBytes(options), 1);
+    std::array<char, 33> key{};
+    std::snprintf(key.data(), key.size(), "%016llx%016llx",
+                  static_cast<unsigned long long>(hashBytes(input, setting)),
+                  static_cast<unsigned long long>(
+                      hashBytes(input, ~setting)));
+    return key.data();
+}
+
+auto OutputCache::lookup(const std::string &key)
+    -> std::optional<MappedFile> {
+    std::optional<MappedFile> output;
+    try {
+        output.emplace((this->directory / key).string());
+    } catch (const std::runtime_error &) {
+        output.reset(); // Not stored (yet)
+    }
+    (output ? this->stats.hits : this->stats.misses)++;
+    Counters(this->directory / "counters", true).add(output ? HITS : MISSES);
+    return output;
+}
+
+auto OutputCache::store(const std::string &key,
+                        std::span<const std::byte> output) -> bool {
+    // Unique per process and per call, so writers never share a file
+    static std::atomic<uint64_t> counter{0};
+    const std::filesystem::path temporary =
+        this->directory /
+        (key + "." + std::to_string(getpid()) + "." +
+         std::to_string(counter.fetch_add(1)) + ".tmp");
+    const int file = open(temporary.c_str(),
+                          O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (file < 0) {
+        return false;
+    }
+    const bool written = writeDurably(file, output);
+    if (close(file) != 0 || !written) {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, this->directory / key, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+auto OutputCache::totalStats() const -> CacheStats {
+    const Counters counters(this->directory / "counters", false);
+    return CacheStats{counters.get(HITS), counters.get(MISSES)};
+}
@@ -1,116 +1,275 @@
 #include "parser.h"
 #include "argument_validation.h"
+#include "branch_relaxation.h"
+#include "encoding.h"
 #include "instruction.h"
+#include "peephole.h"
 #include "token.h"
-#include "util.h"
+#include <algorithm>
+#include <cstdint>
+#include <optional>
 #include <span>
 #include <stdexcept>
-
-Parser::Parser() : pc{0} {};
+#include <string>
+#include <string_view>
+#include <vector>
 
 void Parser::parse(AssemblerState &assemblerState) {
-    std::vector<Token> currLine;
+    const std::vector<Token> &tokens = assemblerState.tokens;
+    size_t lineStart = 0;
+    Section section = Section::TEXT;
+
+    for (size_t i = 0; i <= tokens.size(); i++) {
+        if (i < tokens.size() && tokens[i].type != TokenType::Newline) {
+            continue;
+        }
+        if (i > lineStart) {
+            try {
+                section =
+                    Parser::parseLine(assemblerState, lineStart, i, section);
+            } catch (const std::runtime_error &error) {
+                throw assemblerState.errorAt(lineStart, error.what());
+            }
+        }
+        lineStart = i + 1;
+    }
 
-    // Makes it easier to delimit by newline
-    assemblerState.tokens.push_back(Token::createNewline());
+    // Whatever is left in a pool goes at the end of its section
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        Parser::placeLiteralPool(assemblerState, static_cast<Section>(i),
+                                 tokens.size(), 0, false);
+    }
+
+    if (assemblerState.optimize) {
+        Peephole::optimize(assemblerState);
+    }
+    // Labels were placed assuming every branch reaches its target
+    BranchRelaxer::relax(assemblerState);
+    assemblerState.placeSections();
+    Parser::resolveImmediates(assemblerState);
+}
+
+void Parser::resolveImmediates(AssemblerState &assemblerState) {
+    const auto labelValue = [&assemblerState](std::string_view name) {
+        const LabelAddress *address =
+            assemblerState.labelToAddress.find(name);
+        if (address == nullptr) {
+            throw std::runtime_error("Undefined symbol in expression: " +
+                                     std::string(name));
+        }
+        return std::optional<int64_t>(assemblerState.addressOf(*address) +
+                                      int64_t{assemblerState.loadAddress});
+    };
+    for (const size_t token : assemblerState.deferredImmediates) {
+        Immediate &immediate =
+            std::get<Immediate>(assemblerState.tokens[token].token);
+        int64_t value{0};
+        try {
+            value = *assemblerState.expressions.evaluate(immediate.expression,
+                                                         labelValue);
+        } catch (const std::runtime_error &error) {
+            throw assemblerState.errorAt(token, error.what());
+        }
+        if (assemblerState.relocatable) {
+            Parser::checkRelocatable(assemblerState, token,
+                                     immediate.expression);
+        }
+        if (value < INT32_MIN || value > INT32_MAX) {
+            throw assemblerState.errorAt(
+                token,
+                "Immediate value out of range: " + std::to_string(value));
+        }
+        immediate.val = static_cast<int>(value);
+    }
+}
 
-    for (auto &token : assemblerState.tokens) {
-        if (token.type == TokenType::Newline) {
-            if (!currLine.empty()) {
-                assemblerState.instructions.push_back(this->parseInstruction(
-                    currLine, assemblerState.labelToAddress));
+void Parser::checkRelocatable(const AssemblerState &assemblerState,
+                              size_t token, uint32_t expression) {
+    // Linking moves each section of the unit by its own amount, so only
+    // differences of labels in one section keep their value
+    try {
+        const auto terms =
+            assemblerState.expressions.labelTerms<SECTION_COUNT>(
+                expression, [&assemblerState](std::string_view name) {
+                    return static_cast<size_t>(
+                        assemblerState.labelToAddress.find(name)->section);
+                });
+        for (const int64_t term : terms) {
+            if (term != 0) {
+                throw std::runtime_error(
+                    "Label address is not known until linking; only "
+                    "differences of labels in one section can be used");
             }
-            currLine.clear();
-        } else {
-            currLine.push_back(token);
         }
+    } catch (const std::runtime_error &error) {
+        throw assemblerState.errorAt(token, error.what());
+    }
+}
+
+auto Parser::parseLine(AssemblerState &assemblerState, size_t lineStart,
+                       size_t lineEnd, Section section) -> Section {
+    const auto line = std::span<const Token>(assemblerState.tokens)
+                          .subspan(lineStart, lineEnd - lineStart);
+    if (line[0].type == TokenType::Directive) {
+        section = Parser::parseDirective(line, section);
+        const auto directive = std::get<Directive>(line[0].token);
+        if (directive == Directive::LTORG) {
+            Parser::placeLiteralPool(assemblerState, section, lineStart,
+                                     line.size(), false);
+        } else if (directive == Directive::GLOBAL) {
+            // Only matters to object files (see object_file.h), and naming
+            // a symbol twice is harmless
+            assemblerState.globalSymbols.insert(
+                std::get<Label>(line[1].token).val, lineStart);
+        }
+        return section;
+    }
+
+    // Each section's size so far is its location counter
+    int &locationCounter = assemblerState.section(section).size;
+    if (assemblerState.literalPools.mustFlush(section, locationCounter)) {
+        // Any later and a load would be out of the pool's reach
+        Parser::placeLiteralPool(assemblerState, section, lineStart, 0,
+                                 true);
+    }
+    const int pc = locationCounter;
+    const std::optional<ArgFormat> format = Parser::parseInstruction(
+        line, assemblerState.labelToAddress, section, locationCounter);
+    if (format == ArgFormat::REG_LITERAL) {
+        Parser::addLiteral(assemblerState, lineEnd - 1, section, pc);
+    } else if (format && invertedBranch(std::get<Mnemonic>(line[0].token))) {
+        assemblerState.literalPools.noteRelaxableBranch(section);
     }
+    assemblerState.instructions.push_back(Instruction{
+        lineStart, line.size(), format, format ? 4 : 0, section});
+    return section;
+}
 
-    assemblerState.tokens.pop_back();
+void Parser::addLiteral(AssemblerState &assemblerState, size_t token,
+                        Section section, int pc) {
+    // ldr rt, =value: the register is the first argument, the value the last
+    Literal &literal = std::get<Literal>(assemblerState.tokens[token].token);
+    const auto reg =
+        std::get<Register>(assemblerState.tokens[token - 1].token);
+    const bool is64Bit = !isWRegister(reg);
+    const auto signedVal = static_cast<int64_t>(literal.val);
+    if (!is64Bit && literal.val > UINT32_MAX &&
+        (signedVal < INT32_MIN || signedVal >= 0)) {
+        throw std::runtime_error("Literal does not fit in a W register");
+    }
+    literal.entry = assemblerState.literalPools.add(
+        section, is64Bit ? literal.val : literal.val & UINT32_MAX, is64Bit,
+        pc);
 }
 
-auto Parser::parseInstruction(std::vector<Token> &tokens, LabelMap &labelMap)
-    -> Instruction {
-    // TODO: Add line nums to token for better errors
+void Parser::placeLiteralPool(AssemblerState &assemblerState,
+                              Section section, size_t firstToken,
+                              size_t tokenCount, bool branchOver) {
+    SectionBuffer &buffer = assemblerState.section(section);
+    const uint32_t pool =
+        assemblerState.literalPools.flush(section, buffer.size, branchOver);
+    if (pool == NO_LITERAL) {
+        return;
+    }
+    const LiteralPool &placed = assemblerState.literalPools.pool(pool);
+    const int size = placed.size;
+    if (placed.wideBytes > 0) {
+        buffer.alignment = 8;
+    }
+    assemblerState.instructions.push_back(Instruction{
+        firstToken, tokenCount, std::nullopt, size, section, pool});
+    buffer.size += size;
+}
+
+auto Parser::parseDirective(std::span<const Token> tokens, Section section)
+    -> Section {
+    // Only .global takes an argument, the symbol it exports
+    const auto directive = std::get<Directive>(tokens[0].token);
+    const size_t argumentCount = directive == Directive::GLOBAL ? 1 : 0;
+    if (tokens.size() > argumentCount + 1) {
+        throw std::runtime_error("Unexpected tokens following directive");
+    }
+    if (tokens.size() <= argumentCount ||
+        (argumentCount == 1 && tokens[1].type != TokenType::Label)) {
+        throw std::runtime_error("Expected a symbol after .global");
+    }
+    switch (directive) {
+    case Directive::TEXT:
+        return Section::TEXT;
+    case Directive::DATA:
+        return Section::DATA;
+    case Directive::LTORG:
+        return section; // The caller writes out the pool
+    case Directive::GLOBAL:
+        return section; // The caller records the symbol
+    }
+    throw std::runtime_error("Invalid directive");
+}
+
+auto Parser::parseInstruction(std::span<const Token> tokens,
+                              LabelMap &labelMap, Section section, int &pc)
+    -> std::optional<ArgFormat> {
+    // Errors are given their position by parse (see source_map.h)
     const Token &firstToken = tokens[0];
+    std::optional<ArgFormat> format;
 
     switch (firstToken.type) {
     case TokenType::Label: {
         if (tokens.size() > 1) {
             throw std::runtime_error("Unexpected tokens following label");
         }
-        labelMap.insert({std::get<Label>(firstToken.token), this->pc});
+        // Relaxation moves labels by name, so each must be defined once
+        const Label &label = std::get<Label>(firstToken.token);
+        if (!labelMap.insert(label.val, LabelAddress{section, pc})) {
+            throw std::runtime_error("Duplicate label: " + label.val);
+        }
         break;
     }
 
     case TokenType::Mnemonic: {
         // This is a machine instruction
-        const std::span<const Token> arguments(tokens.data() + 1,
-                                               tokens.size() - 1);
-        if (!Parser::validateMnemonicArguments(
-                std::get<Mnemonic>(tokens[0].token), arguments)) {
+        const std::span<const Token> arguments = tokens.subspan(1);
+        format = Parser::validateMnemonicArguments(
+            std::get<Mnemonic>(tokens[0].token), arguments);
+        if (!format) {
             throw std::runtime_error("Invalid arguments for a mnemonic");
         }
-        this->pc += 4;
+        pc += 4;
         break;
     }
 
-    case TokenType::Directive: {
-        throw std::runtime_error("Directive instructions not yet supported");
-        break;
-    }
+    case TokenType::Directive: // Handled by parseDirective
     case TokenType::Newline:
     case TokenType::Register:
-    case TokenType::Immediate: {
+    case TokenType::Immediate:
+    case TokenType::Literal:
+    case TokenType::LeftBracket:
+    case TokenType::RightBracket: {
         throw std::runtime_error("Invalid instruction");
     }
     };
-    return Instruction{tokens};
+    return format;
 }
 
 auto Parser::validateMnemonicArguments(Mnemonic mnemonic,
                                        const std::span<const Token> &args)
-    -> bool {
-    if (!util::isValidKey(mnemonic, mnemonicsToFormats)) {
+    -> std::optional<ArgFormat> {
+    const std::span<const ArgFormat> supportedArgFormats =
+        mnemonicFormats(mnemonic);
+    if (supportedArgFormats.empty()) {
         throw std::runtime_error("Unsupported mnemonic found while parsing");
     }
 
-    const std::vector<ArgFormat> &supportedArgFormats =
-        mnemonicsToFormats.at(mnemonic);
-    const std::vector<ValidationRule> rules =
-        Parser::gatherValidationRules(supportedArgFormats);
-
     // Check if any of the rules match
-    for (const auto &rule : rules) {
-        if (rule.size() != args.size()) {
-            continue;
-        }
-
-        for (int i{0}; i < args.size(); i++) {
-            if (rule[i] != args[i].type) {
-                break;
-            }
-            // Found a match
-            if (i == args.size() - 1) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-auto Parser::gatherValidationRules(const std::vector<ArgFormat> &formats)
-    -> std::vector<ValidationRule> {
-    std::vector<ValidationRule> rules;
-
-    for (const auto &argFormat : formats) {
-        if (!util::isValidKey(argFormat, validationRules)) {
-            throw std::runtime_error(
-                "ArgFormat not found in the validationRules map");
+    for (const ArgFormat format : supportedArgFormats) {
+        const ValidationRule rule = validationRule(format);
+        if (std::equal(rule.begin(), rule.end(), args.begin(), args.end(),
+                       [](TokenType type, const Token &arg) {
+                           return type == arg.type;
+                       })) {
+            return format;
         }
-        rules.push_back(validationRules.at(argFormat));
     }
 
-    return rules;
+    return std::nullopt;
 }
@@ -0,0 +1,177 @@
+#include "peephole.h"
+#include "encoder.h"
+#include "encoding.h"
+#include "instruction.h"
+#include "literal_pool.h"
+#include "token.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+namespace {
+
+// Registers 31 and up are SP or XZR depending on the instruction, so they
+// are left alone
+constexpr uint32_t FIRST_SPECIAL_REGISTER = 31;
+
+auto mnemonicOf(std::span<const Token> tokens) -> Mnemonic {
+    return std::get<Mnemonic>(tokens[0].token);
+}
+
+// The register number an instruction writes, if it can take part in a
+// pattern
+auto destinationOf(std::span<const Token> tokens) -> std::optional<uint32_t> {
+    const uint32_t number =
+        registerNumber(std::get<Register>(tokens[1].token));
+    if (number >= FIRST_SPECIAL_REGISTER) {
+        return std::nullopt;
+    }
+    return number;
+}
+
+// Immediates waiting for labels have no value yet
+auto isKnownImmediate(const Token &token, std::optional<int> value) -> bool {
+    const auto &immediate = std::get<Immediate>(token.token);
+    return immediate.expression == NO_EXPRESSION &&
+           (!value || immediate.val == *value);
+}
+
+auto isNoop(std::span<const Token> tokens, ArgFormat format) -> bool {
+    const NoopPattern *pattern = findNoopPattern(mnemonicOf(tokens), format);
+    if (pattern == nullptr) {
+        return false;
+    }
+    const Register destination = std::get<Register>(tokens[1].token);
+    if (isWRegister(destination) || !destinationOf(tokens)) {
+        return false;
+    }
+    for (size_t i{0}; i < pattern->argumentCount; i++) {
+        const Token &argument = tokens[i + 1];
+        switch (pattern->arguments[i]) {
+        case PatternArgument::DESTINATION:
+            if (std::get<Register>(argument.token) != destination) {
+                return false;
+            }
+            break;
+        case PatternArgument::ZERO:
+            if (!isKnownImmediate(argument, 0)) {
+                return false;
+            }
+            break;
+        case PatternArgument::ANY:
+            break;
+        }
+    }
+    return true;
+}
+
+// Whether second writes first's register without reading it, making first
+// dead
+auto overwrites(std::span<const Token> first, ArgFormat firstFormat,
+                std::span<const Token> second, ArgFormat secondFormat)
+    -> bool {
+    if (!isOverwrite(mnemonicOf(first), firstFormat) ||
+        !isOverwrite(mnemonicOf(second), secondFormat)) {
+        return false;
+    }
+    const std::optional<uint32_t> destination = destinationOf(first);
+    if (!destination || destinationOf(second) != destination) {
+        return false;
+    }
+    for (const Token &argument : first.subspan(2)) {
+        if (argument.type == TokenType::Immediate &&
+            !isKnownImmediate(argument, std::nullopt)) {
+            return false;
+        }
+    }
+    for (const Token &argument : second.subspan(2)) {
+        if (argument.type == TokenType::Register &&
+            registerNumber(std::get<Register>(argument.token)) ==
+                *destination) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Moves a label or literal pool back by the bytes removed before it
+void moveBack(AssemblerState &assemblerState, const Instruction &instruction,
+              int bytes) {
+    if (instruction.literalPool != NO_LITERAL) {
+        LiteralPools &pools = assemblerState.literalPools;
+        pools.movePool(instruction.literalPool,
+                       pools.pool(instruction.literalPool).offset - bytes);
+    } else {
+        const auto &label =
+            std::get<Label>(assemblerState.tokensOf(instruction)[0].token);
+        assemblerState.labelToAddress.find(label.val)->offset -= bytes;
+    }
+}
+
+} // namespace
+
+auto Peephole::optimize(AssemblerState &assemblerState) -> size_t {
+    std::vector<Instruction> &instructions = assemblerState.instructions;
+    // Bytes removed so far from each section, which is how far back
+    // everything after them moves
+    std::array<int, SECTION_COUNT> removed{};
+    // Checks an instruction before it is removed, as the encoder would
+    const auto remove = [&](const Instruction &instruction) {
+        try {
+            Encoder::resolveInstruction(assemblerState.tokensOf(instruction),
+                                        *instruction.format, assemblerState,
+                                        0);
+        } catch (const std::runtime_error &error) {
+            throw assemblerState.errorAt(instruction.firstToken, error.what());
+        }
+        removed[static_cast<size_t>(instruction.section)] += 4;
+    };
+
+    // Instructions are compacted in place: [0, kept) are the ones kept, and
+    // the window is the last of them and the next one
+    size_t kept{0};
+    for (size_t i{0}; i < instructions.size(); i++) {
+        const Instruction instruction = instructions[i];
+        if (!instruction.format) {
+            const int moved =
+                removed[static_cast<size_t>(instruction.section)];
+            if (moved != 0) {
+                moveBack(assemblerState, instruction, moved);
+            }
+            instructions[kept++] = instruction;
+            continue;
+        }
+
+        const auto tokens = assemblerState.tokensOf(instruction);
+        if (isNoop(tokens, *instruction.format)) {
+            remove(instruction);
+            continue;
+        }
+        if (kept > 0) {
+            Instruction &previous = instructions[kept - 1];
+            if (previous.format && previous.section == instruction.section &&
+                overwrites(assemblerState.tokensOf(previous), *previous.format,
+                           tokens, *instruction.format)) {
+                remove(previous);
+                previous = instruction;
+                continue;
+            }
+        }
+        instructions[kept++] = instruction;
+    }
+    instructions.erase(instructions.begin() + static_cast<ptrdiff_t>(kept),
+                       instructions.end());
+
+    size_t count{0};
+    for (size_t i{0}; i < SECTION_COUNT; i++) {
+        assemblerState.sections[i].size -= removed[i];
+        count += static_cast<size_t>(removed[i] / 4);
+    }
+    return count;
+}
@@ -0,0 +1,236 @@
+#include "source_map.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Layout of an entry's first byte. Fields that do not fit in it follow as
+// LEB128 varints, in this order: token delta, file, line delta, column.
+constexpr uint8_t TOKEN_DELTA_MASK = 0x0F; // 15 means a varint follows
+constexpr uint8_t NEXT_LINE = 0x10;        // Line is one more than the last
+constexpr uint8_t SAME_COLUMN = 0x20;
+constexpr uint8_t NEW_FILE = 0x40;
+
+void appendVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80U));
+        value >>= 7U;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+auto readVarint(std::span<const uint8_t> bytes, size_t &offset) -> uint64_t {
+    uint64_t value{0};
+    for (unsigned shift{0}; shift < 64; shift += 7) {
+        if (offset == bytes.size()) {
+            break;
+        }
+        const uint8_t byte = bytes[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Source map is corrupt");
+}
+
+// Line deltas may be negative (after a file change), so they are zigzag
+// encoded to keep small magnitudes small
+auto zigzag(int64_t value) -> uint64_t {
+    return (static_cast<uint64_t>(value) << 1U) ^
+           static_cast<uint64_t>(value >> 63);
+}
+
+auto unzigzag(uint64_t value) -> int64_t {
+    return static_cast<int64_t>(value >> 1U) ^
+           -static_cast<int64_t>(value & 1U);
+}
+
+} // namespace
+
+auto SourceMap::decode(std::span<const uint8_t> encoded, size_t &offset,
+                       const Entry &previous) -> Entry {
+    if (offset == encoded.size()) {
+        throw std::runtime_error("Source map is corrupt");
+    }
+    const uint8_t flags = encoded[offset++];
+    Entry entry = previous;
+    uint64_t tokenDelta = flags & TOKEN_DELTA_MASK;
+    if (tokenDelta == TOKEN_DELTA_MASK) {
+        tokenDelta = readVarint(encoded, offset);
+    }
+    entry.firstToken += tokenDelta;
+    if ((flags & NEW_FILE) != 0) {
+        entry.location.file =
+            static_cast<uint32_t>(readVarint(encoded, offset));
+    }
+    entry.location.line +=
+        (flags & NEXT_LINE) != 0
+            ? 1
+            : static_cast<int>(unzigzag(readVarint(encoded, offset)));
+    if ((flags & SAME_COLUMN) == 0) {
+        entry.location.column =
+            static_cast<int>(readVarint(encoded, offset));
+    }
+    return entry;
+}
+
+auto SourceMap::addFile(std::string_view name) -> uint32_t {
+    this->fileNames.append(name);
+    this->fileEnds.push_back(static_cast<uint32_t>(this->fileNames.size()));
+    this->currentFile = static_cast<uint32_t>(this->fileEnds.size() - 1);
+    return this->currentFile;
+}
+
+void SourceMap::addLine(size_t firstToken, int line, int column) {
+    if (this->fileEnds.empty()) {
+        this->addFile("");
+    }
+    const Entry entry{firstToken, SourceLocation{this->currentFile, line,
+                                                 column}};
+    const size_t tokenDelta = firstToken - this->last.firstToken;
+    const bool newFile = entry.location.file != this->last.location.file;
+    const bool nextLine = line == this->last.location.line + 1;
+    const bool sameColumn = column == this->last.location.column;
+
+    uint8_t flags = static_cast<uint8_t>(
+        std::min<size_t>(tokenDelta, TOKEN_DELTA_MASK));
+    flags |= (nextLine ? NEXT_LINE : 0U) | (sameColumn ? SAME_COLUMN : 0U) |
+             (newFile ? NEW_FILE : 0U);
+    this->encoded.push_back(flags);
+    if (tokenDelta >= TOKEN_DELTA_MASK) {
+        appendVarint(this->encoded, tokenDelta);
+    }
+    if (newFile) {
+        appendVarint(this->encoded, entry.location.file);
+    }
+    if (!nextLine) {
+        appendVarint(this->encoded,
+                     zigzag(static_cast<int64_t>(line) -
+                            this->last.location.line));
+    }
+    if (!sameColumn) {
+        appendVarint(this->encoded, static_cast<uint64_t>(column));
+    }
+
+    this->last = entry;
+    this->entryCount++;
+    if (this->entryCount % CHECKPOINT_INTERVAL == 1) {
+        this->checkpoints.push_back(Checkpoint{this->encoded.size(), entry});
+    }
+}
+
+auto SourceMap::locate(size_t token) const -> SourceLocation {
+    // Last checkpoint at or before the token, then forward from there
+    const auto after = std::upper_bound(
+        this->checkpoints.begin(), this->checkpoints.end(), token,
+        [](size_t target, const Checkpoint &checkpoint) {
+            return target < checkpoint.entry.firstToken;
+        });
+    if (after == this->checkpoints.begin()) {
+        return this->checkpoints.empty()
+                   ? SourceLocation{}
+                   : this->checkpoints.front().entry.location;
+    }
+    const Checkpoint &checkpoint = *(after - 1);
+    Entry entry = checkpoint.entry;
+    size_t offset = checkpoint.offset;
+    while (offset < this->encoded.size()) {
+        const Entry next = SourceMap::decode(this->encoded, offset, entry);
+        if (next.firstToken > token) {
+            break;
+        }
+        entry = next;
+    }
+    return entry.location;
+}
+
+auto SourceMap::fileName(uint32_t file) const -> std::string_view {
+    if (file >= this->fileEnds.size()) {
+        return "";
+    }
+    const uint32_t start = file == 0 ? 0 : this->fileEnds[file - 1];
+    return std::string_view(this->fileNames)
+        .substr(start, this->fileEnds[file] - start);
+}
+
+auto SourceMap::describe(size_t token) const -> std::string {
+    const SourceLocation location = this->locate(token);
+    const std::string_view file = this->fileName(location.file);
+    if (file.empty()) {
+        return "line " + std::to_string(location.line) + ", column " +
+               std::to_string(location.column);
+    }
+    std::string description(file);
+    description.append(":")
+        .append(std::to_string(location.line))
+        .append(":")
+        .append(std::to_string(location.column));
+    return description;
+}
+
+void SourceMap::load(std::span<const uint8_t> bytes,
+                     std::span<const std::string_view> names) {
+    this->clear();
+    for (const std::string_view name : names) {
+        this->addFile(name);
+    }
+    // Decoding rebuilds the checkpoints, and checks every entry
+    this->encoded.assign(bytes.begin(), bytes.end());
+    size_t offset{0};
+    while (offset < this->encoded.size()) {
+        const Entry entry =
+            SourceMap::decode(this->encoded, offset, this->last);
+        if (entry.location.file >= this->fileEnds.size() ||
+            entry.firstToken < this->last.firstToken) {
+            throw std::runtime_error("Source map is corrupt");
+        }
+        this->last = entry;
+        this->entryCount++;
+        if (this->entryCount % CHECKPOINT_INTERVAL == 1) {
+            this->checkpoints.push_back(Checkpoint{offset, entry});
+        }
+    }
+    this->currentFile = this->last.location.file;
+}
+
+void SourceMap::clear() {
+    this->encoded.clear();
+    this->checkpoints.clear();
+    this->fileNames.clear();
+    this->fileEnds.clear();
+    this->currentFile = 0;
+    this->entryCount = 0;
+    this->last = Entry{};
+}
+
+SourceMap::Cursor::Cursor(const SourceMap &map) : map(&map) {
+    this->advance();
+    if (this->hasNext) {
+        this->current = this->next;
+        this->advance();
+    }
+}
+
+void SourceMap::Cursor::advance() {
+    this->hasNext = this->offset < this->map->encoded.size();
+    if (this->hasNext) {
+        this->next = SourceMap::decode(this->map->encoded, this->offset,
+                                       this->current);
+    }
+}
+
+auto SourceMap::Cursor::locate(size_t token) -> SourceLocation {
+    while (this->hasNext && this->next.firstToken <= token) {
+        this->current = this->next;
+        this->advance();
+    }
+    return this->current.location;
+}
@@ -0,0 +1,392 @@
+#include "token_cache.h"
+#include "byte_buffer.h"
+#include "expression.h"
+#include "source_map.h"
+#include "symbol_table.h"
+#include "token.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC = {'A', 'R', 'M', 'T',
+                                       'O', 'K', 'S', '\0'};
+
+// Set in the type byte of an immediate that is an expression's root node
+// rather than a value
+constexpr uint8_t EXPRESSION_FLAG = 0x80;
+
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t mnemonicCount;
+    uint32_t tokenCount;
+    uint32_t tokenBytes;
+    uint32_t nodeCount;
+    uint32_t constantCount;
+    uint32_t labelCount;
+    uint32_t fileCount;
+    uint32_t stringBytes; // Label, constant and file names
+    uint32_t nameBytes;   // Names used in expressions
+    uint32_t sourceMapBytes;
+};
+
+// An expression node, without ExpressionNode's padding
+struct NodeRecord {
+    uint32_t op;
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+// A .equ constant: its name in the label table and its root node
+struct ConstantRecord {
+    uint32_t label;
+    uint32_t root;
+};
+
+// Where a label's name is in the strings
+struct LabelRecord {
+    uint32_t offset;
+    uint32_t size;
+};
+
+auto corrupt() -> std::runtime_error {
+    return std::runtime_error("Token cache is corrupt");
+}
+
+// Collects label names into the table, each stored once
+class LabelTable {
+  private:
+    SymbolTable<uint32_t> indices;
+
+  public:
+    std::vector<LabelRecord> labels;
+    std::string strings;
+
+    auto indexOf(std::string_view name) -> uint32_t {
+        const auto index = static_cast<uint32_t>(this->labels.size());
+        if (!this->indices.insert(name, index)) {
+            return *this->indices.find(name);
+        }
+        this->labels.push_back(
+            LabelRecord{static_cast<uint32_t>(this->strings.size()),
+                        static_cast<uint32_t>(name.size())});
+        this->strings.append(name);
+        return index;
+    }
+};
+
+// A type byte, then as many bytes as the type needs: one for enums, four for
+// labels and immediates, eight for literals and none for the rest
+void appendToken(const Token &token, LabelTable &labels,
+                 std::vector<std::byte> &out) {
+    auto type = static_cast<uint8_t>(token.type);
+    switch (token.type) {
+    case TokenType::Mnemonic:
+        appendBytes(out, type);
+        appendBytes(out, static_cast<uint8_t>(std::get<Mnemonic>(token.token)));
+        return;
+    case TokenType::Register:
+        appendBytes(out, type);
+        appendBytes(out, static_cast<uint8_t>(std::get<Register>(token.token)));
+        return;
+    case TokenType::Directive:
+        appendBytes(out, type);
+        appendBytes(out,
+                    static_cast<uint8_t>(std::get<Directive>(token.token)));
+        return;
+    case TokenType::Label:
+        appendBytes(out, type);
+        appendBytes(out, labels.indexOf(std::get<Label>(token.token).val));
+        return;
+    case TokenType::Immediate: {
+        // The value of an expression is recomputed by the parser
+        const Immediate &immediate = std::get<Immediate>(token.token);
+        if (immediate.expression != NO_EXPRESSION) {
+            appendBytes(out, static_cast<uint8_t>(type | EXPRESSION_FLAG));
+            appendBytes(out, immediate.expression);
+        } else {
+            appendBytes(out, type);
+            appendBytes(out, static_cast<int32_t>(immediate.val));
+        }
+        return;
+    }
+    case TokenType::Literal:
+        appendBytes(out, type);
+        appendBytes(out, std::get<Literal>(token.token).val);
+        return;
+    case TokenType::LeftBracket:
+    case TokenType::RightBracket:
+    case TokenType::Newline:
+        appendBytes(out, type);
+        return;
+    }
+}
+
+auto readToken(ByteReader &reader, std::span<const std::string_view> labels,
+               uint32_t nodeCount) -> Token {
+    const auto type = reader.read<uint8_t>();
+    const auto tokenType = static_cast<TokenType>(type & ~EXPRESSION_FLAG);
+    // Only immediates can be expressions
+    if ((type & EXPRESSION_FLAG) != 0 && tokenType != TokenType::Immediate) {
+        throw corrupt();
+    }
+    switch (tokenType) {
+    case TokenType::Mnemonic: {
+        const auto mnemonic = reader.read<uint8_t>();
+        if (mnemonic >= MNEMONIC_COUNT) {
+            throw corrupt();
+        }
+        return Token::createMnemonic(static_cast<Mnemonic>(mnemonic));
+    }
+    case TokenType::Register: {
+        const auto reg = reader.read<uint8_t>();
+        if (reg > static_cast<uint8_t>(Register::W32)) {
+            throw corrupt();
+        }
+        return Token::createRegister(static_cast<Register>(reg));
+    }
+    case TokenType::Directive: {
+        const auto directive = reader.read<uint8_t>();
+        if (directive > static_cast<uint8_t>(Directive::LTORG)) {
+            throw corrupt();
+        }
+        return Token::createDirective(static_cast<Directive>(directive));
+    }
+    case TokenType::Label: {
+        const auto label = reader.read<uint32_t>();
+        if (label >= labels.size()) {
+            throw corrupt();
+        }
+        return Token::createLabel(Label{std::string(labels[label])});
+    }
+    case TokenType::Immediate:
+        if ((type & EXPRESSION_FLAG) != 0) {
+            const auto root = reader.read<uint32_t>();
+            if (root >= nodeCount) {
+                throw corrupt();
+            }
+            return Token::createImmediate(Immediate{0, root});
+        }
+        return Token::createImmediate(Immediate{reader.read<int32_t>()});
+    case TokenType::Literal:
+        return Token::createLiteral(Literal{reader.read<uint64_t>()});
+    case TokenType::LeftBracket:
+        return Token::createLeftBracket();
+    case TokenType::RightBracket:
+        return Token::createRightBracket();
+    case TokenType::Newline:
+        return Token::createNewline();
+    }
+    throw corrupt();
+}
+
+// Operands come before the nodes using them, so evaluation cannot loop
+void checkNode(const ExpressionNode &node, uint32_t index,
+               size_t nameBytes) {
+    switch (node.op) {
+    case ExpressionOp::NUMBER:
+        return;
+    case ExpressionOp::SYMBOL:
+        if (node.lhs > nameBytes || node.rhs > nameBytes - node.lhs) {
+            throw corrupt();
+        }
+        return;
+    case ExpressionOp::NEGATE:
+    case ExpressionOp::NOT:
+        if (node.lhs >= index) {
+            throw corrupt();
+        }
+        return;
+    case ExpressionOp::MULTIPLY:
+    case ExpressionOp::DIVIDE:
+    case ExpressionOp::REMAINDER:
+    case ExpressionOp::ADD:
+    case ExpressionOp::SUBTRACT:
+    case ExpressionOp::SHIFT_LEFT:
+    case ExpressionOp::SHIFT_RIGHT:
+    case ExpressionOp::AND:
+    case ExpressionOp::XOR:
+    case ExpressionOp::OR:
+        if (node.lhs >= index || node.rhs >= index) {
+            throw corrupt();
+        }
+        return;
+    }
+    throw corrupt();
+}
+
+} // namespace
+
+auto TokenCache::serialize(const AssemblerState &assemblerState)
+    -> std::vector<std::byte> {
+    const Expressions &expressions = assemblerState.expressions;
+    const std::span<const ExpressionNode> nodes = expressions.allNodes();
+    const std::string_view names = expressions.allNames();
+
+    LabelTable labels;
+    std::vector<std::byte> tokens;
+    tokens.reserve(assemblerState.tokens.size() * 2);
+    for (const Token &token : assemblerState.tokens) {
+        appendToken(token, labels, tokens);
+    }
+    std::vector<ConstantRecord> constants;
+    expressions.forEachConstant([&](std::string_view name, uint32_t root) {
+        constants.push_back(ConstantRecord{labels.indexOf(name), root});
+    });
+    const SourceMap &sourceMap = assemblerState.sourceMap;
+    std::vector<uint32_t> files;
+    for (uint32_t file{0}; file < sourceMap.fileCount(); file++) {
+        files.push_back(labels.indexOf(sourceMap.fileName(file)));
+    }
+
+    const Header header{MAGIC,
+                        TOKEN_CACHE_VERSION,
+                        static_cast<uint32_t>(MNEMONIC_COUNT),
+                        static_cast<uint32_t>(assemblerState.tokens.size()),
+                        static_cast<uint32_t>(tokens.size()),
+                        static_cast<uint32_t>(nodes.size()),
+                        static_cast<uint32_t>(constants.size()),
+                        static_cast<uint32_t>(labels.labels.size()),
+                        static_cast<uint32_t>(files.size()),
+                        static_cast<uint32_t>(labels.strings.size()),
+                        static_cast<uint32_t>(names.size()),
+                        static_cast<uint32_t>(sourceMap.bytes().size())};
+
+    std::vector<std::byte> out;
+    out.reserve(sizeof(Header) + tokens.size() +
+                nodes.size() * sizeof(NodeRecord) +
+                constants.size() * sizeof(ConstantRecord) +
+                labels.labels.size() * sizeof(LabelRecord) +
+                files.size() * sizeof(uint32_t) + labels.strings.size() +
+                names.size() + sourceMap.bytes().size());
+    appendBytes(out, header);
+    out.insert(out.end(), tokens.begin(), tokens.end());
+    for (const ExpressionNode &node : nodes) {
+        appendBytes(out, NodeRecord{static_cast<uint32_t>(node.op), node.lhs,
+                               node.rhs});
+    }
+    for (const ConstantRecord &constant : constants) {
+        appendBytes(out, constant);
+    }
+    for (const LabelRecord &label : labels.labels) {
+        appendBytes(out, label);
+    }
+    for (const uint32_t file : files) {
+        appendBytes(out, file);
+    }
+    for (const std::string_view strings : {std::string_view(labels.strings),
+                                           names}) {
+        const auto *bytes = reinterpret_cast<const std::byte *>(strings.data());
+        out.insert(out.end(), bytes, bytes + strings.size());
+    }
+    const auto *map = reinterpret_cast<const std::byte *>(
+        sourceMap.bytes().data());
+    out.insert(out.end(), map, map + sourceMap.bytes().size());
+    return out;
+}
+
+void TokenCache::load(std::span<const std::byte> cache,
+                      AssemblerState &assemblerState) {
+    assemblerState.clear();
+    ByteReader reader(cache, "Token cache");
+    const auto header = reader.read<Header>();
+    if (header.magic != MAGIC) {
+        throw std::runtime_error("Not a token cache");
+    }
+    if (header.version != TOKEN_CACHE_VERSION ||
+        header.mnemonicCount != MNEMONIC_COUNT) {
+        throw std::runtime_error(
+            "Token cache was written by a different assembler version");
+    }
+
+    // Every section is located first, since the tokens refer to the labels
+    // and expressions that follow them
+    ByteReader tokens(reader.take(header.tokenBytes), "Token cache");
+    const auto nodes =
+        reader.take(size_t{header.nodeCount} * sizeof(NodeRecord));
+    const auto constants =
+        reader.take(size_t{header.constantCount} * sizeof(ConstantRecord));
+    const auto labelRecords =
+        reader.take(size_t{header.labelCount} * sizeof(LabelRecord));
+    const auto fileRecords =
+        reader.take(size_t{header.fileCount} * sizeof(uint32_t));
+    const std::string_view strings = reader.readString(header.stringBytes);
+    const std::string_view names = reader.readString(header.nameBytes);
+    const auto sourceMap = reader.take(header.sourceMapBytes);
+    if (!reader.atEnd()) {
+        throw corrupt();
+    }
+
+    std::vector<std::string_view> labels(header.labelCount);
+    for (uint32_t i{0}; i < header.labelCount; i++) {
+        const auto label = recordAt<LabelRecord>(labelRecords, i);
+        if (label.offset > strings.size() ||
+            label.size > strings.size() - label.offset) {
+            throw corrupt();
+        }
+        labels[i] = strings.substr(label.offset, label.size);
+    }
+
+    std::vector<std::string_view> files(header.fileCount);
+    for (uint32_t i{0}; i < header.fileCount; i++) {
+        const auto label = recordAt<uint32_t>(fileRecords, i);
+        if (label >= labels.size()) {
+            throw corrupt();
+        }
+        files[i] = labels[label];
+    }
+    assemblerState.sourceMap.load(
+        std::span(reinterpret_cast<const uint8_t *>(sourceMap.data()),
+                  sourceMap.size()),
+        files);
+
+    std::vector<ExpressionNode> nodeList(header.nodeCount);
+    for (uint32_t i{0}; i < header.nodeCount; i++) {
+        const auto record = recordAt<NodeRecord>(nodes, i);
+        if (record.op > static_cast<uint32_t>(ExpressionOp::OR)) {
+            throw corrupt();
+        }
+        nodeList[i] = ExpressionNode{static_cast<ExpressionOp>(record.op),
+                                     record.lhs, record.rhs};
+        checkNode(nodeList[i], i, names.size());
+    }
+    assemblerState.expressions.load(nodeList, names);
+
+    for (uint32_t i{0}; i < header.constantCount; i++) {
+        const auto constant = recordAt<ConstantRecord>(constants, i);
+        if (constant.label >= labels.size() ||
+            constant.root >= header.nodeCount ||
+            !assemblerState.expressions.define(labels[constant.label],
+                                               constant.root)) {
+            throw corrupt();
+        }
+    }
+
+    // Each token takes at least its type byte, which bounds the count
+    // before anything is allocated for it
+    if (header.tokenCount > header.tokenBytes) {
+        throw corrupt();
+    }
+    std::vector<Token> &tokenList = assemblerState.tokens;
+    tokenList.reserve(header.tokenCount);
+    for (uint32_t i{0}; i < header.tokenCount; i++) {
+        tokenList.push_back(readToken(tokens, labels, header.nodeCount));
+        if (tokenList.back().type == TokenType::Immediate &&
+            std::get<Immediate>(tokenList.back().token).expression !=
+                NO_EXPRESSION) {
+            assemblerState.deferredImmediates.push_back(i);
+        }
+    }
+    if (!tokens.atEnd()) {
+        throw corrupt();
+    }
+}
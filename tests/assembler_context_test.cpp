@@ -0,0 +1,74 @@
+#include "assembler_context.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+#include <span>
+#include <string>
+#include <vector>
+
+// Count every allocation in the test binary so tests can check that a warm
+// context no longer allocates
+namespace {
+std::atomic<size_t> allocationCount{0};
+} // namespace
+
+auto operator new(size_t size) -> void * {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, size_t /*size*/) noexcept {
+    std::free(memory);
+}
+
+const std::string snippet = "start:\n"
+                            "    mov x1, #10\n"
+                            "    add x2, x1, #1 // comment\n"
+                            "loop_body:\n"
+                            "    sub x1, x1, #1\n"
+                            "    cbnz x1, loop_body\n"
+                            "    ldr x3, [x2, #8]\n"
+                            "    b start\n";
+
+auto toVector(std::span<const uint32_t> words) -> std::vector<uint32_t> {
+    return {words.begin(), words.end()};
+}
+
+TEST(AssemblerContextTest, RepeatedAssemblyIsIdentical) {
+    AssemblerContext context;
+    const std::vector<uint32_t> first = toVector(context.assemble(snippet));
+    ASSERT_EQ(first.size(), 6);
+    EXPECT_EQ(toVector(context.assemble(snippet)), first);
+    EXPECT_EQ(toVector(context.assemble("mov w1, w2")),
+              std::vector<uint32_t>{0x2A0203E1});
+    EXPECT_EQ(toVector(context.assemble(snippet)), first);
+}
+
+TEST(AssemblerContextTest, ResetForgetsLabels) {
+    AssemblerContext context;
+    context.assemble("target:\nb target");
+    EXPECT_TRUE(context.getState().labelToAddress.contains("target"));
+    EXPECT_THROW({ context.assemble("b target"); }, std::runtime_error);
+
+    context.reset();
+    EXPECT_TRUE(context.getState().labelToAddress.empty());
+    EXPECT_TRUE(context.getState().machineCode.empty());
+}
+
+TEST(AssemblerContextTest, NoAllocationsOnceWarm) {
+    AssemblerContext context;
+    context.assemble(snippet);
+
+    const size_t before = allocationCount.load();
+    for (int i{0}; i < 100; i++) {
+        context.assemble(snippet);
+    }
+    EXPECT_EQ(allocationCount.load() - before, 0);
+}
@@ -0,0 +1,109 @@
+#include "assembler_state.h"
+#include "batch_encoder.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+auto getParsedState(const std::string &assembly) -> AssemblerState {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    return state;
+}
+
+// Enough instructions per encoding to exercise full SIMD lanes and tails
+auto mixedProgram() -> std::string {
+    std::string program = "start:\n";
+    for (int i{0}; i < 37; i++) {
+        const std::string a = std::to_string(i % 31);
+        const std::string b = std::to_string((i * 7) % 31);
+        const std::string imm = std::to_string(i * 97);
+        program += "add x" + a + ", x" + b + ", x" + a + "\n";
+        program += "add w" + b + ", w" + a + ", #" + imm + "\n";
+        program += "sub x" + a + ", x" + b + ", #" + imm + "\n";
+        if (i % 3 == 0) {
+            program += "mov w" + a + ", w" + b + "\n";
+            program += "mov x" + b + ", #" + std::to_string(i * 1771) + "\n";
+            program += "cbz w" + a + ", end\n";
+            program += "ldr x" + a + ", [x" + b + ", #" +
+                       std::to_string(i * 8) + "]\n";
+        }
+        program += (i % 2 == 0) ? "b start\n" : "bl end\n";
+    }
+    return program + "end:";
+}
+
+auto encodeWithLevel(AssemblerState state, SimdLevel level)
+    -> std::vector<uint32_t> {
+    EncodingBatches batches;
+    uint32_t offset{0};
+    for (const auto &instruction : state.instructions) {
+        if (instruction.format) {
+            BatchEncoder::addInstruction(
+                batches,
+                Encoder::resolveInstruction(state.tokensOf(instruction),
+                                            *instruction.format, state,
+                                            static_cast<int>(offset * 4)),
+                offset);
+            offset++;
+        }
+    }
+    std::vector<uint32_t> words(offset);
+    BatchEncoder::encodeBatches(batches, words, level);
+    return words;
+}
+
+TEST(BatchEncoderTest, MatchesScalarEncoder) {
+    AssemblerState scalarState = getParsedState(mixedProgram());
+    AssemblerState batchState = scalarState;
+    Encoder::encode(scalarState);
+    BatchEncoder::encode(batchState);
+    EXPECT_EQ(scalarState.machineCode, batchState.machineCode);
+}
+
+TEST(BatchEncoderTest, SectionsMatchScalarEncoder) {
+    AssemblerState scalarState = getParsedState(
+        ".data\ntable:\nmov x1, x2\n.text\nldr x3, table\n"
+        ".data\nadd x4, x5, #1\n.text\ncbz x6, table\nb table");
+    AssemblerState batchState = scalarState;
+    Encoder::encode(scalarState);
+    BatchEncoder::encode(batchState);
+    EXPECT_EQ(scalarState.machineCode, batchState.machineCode);
+    EXPECT_EQ(batchState.section(Section::TEXT).words,
+              scalarState.section(Section::TEXT).words);
+    EXPECT_EQ(batchState.section(Section::DATA).words,
+              scalarState.section(Section::DATA).words);
+}
+
+TEST(BatchEncoderTest, LiteralPoolsMatchScalarEncoder) {
+    AssemblerState scalarState = getParsedState(
+        "ldr x1, =0x123456789\n.data\nldr w2, =7\n.text\nldr x3, =5\n"
+        ".ltorg\nldr x4, =0x123456789\nmov x5, x6");
+    AssemblerState batchState = scalarState;
+    Encoder::encode(scalarState);
+    BatchEncoder::encode(batchState);
+    EXPECT_EQ(scalarState.machineCode, batchState.machineCode);
+}
+
+TEST(BatchEncoderTest, EverySimdLevelIsBitIdentical) {
+    AssemblerState state = getParsedState(mixedProgram());
+    AssemblerState expected = state;
+    Encoder::encode(expected);
+
+    EXPECT_EQ(encodeWithLevel(state, SimdLevel::SCALAR),
+              expected.machineCode);
+    EXPECT_EQ(encodeWithLevel(state, SimdLevel::SSE2), expected.machineCode);
+    if (BatchEncoder::detectSimdLevel() == SimdLevel::AVX2) {
+        EXPECT_EQ(encodeWithLevel(state, SimdLevel::AVX2),
+                  expected.machineCode);
+    }
+}
+
+TEST(BatchEncoderTest, InvalidOperandThrows) {
+    AssemblerState state = getParsedState("add x1, x2, #4096");
+    EXPECT_THROW({ BatchEncoder::encode(state); }, std::runtime_error);
+}
@@ -0,0 +1,73 @@
+#include "assembler_state.h"
+#include "branch_relaxation.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+constexpr int MAX_SHORT_OFFSET = (1 << 18) - 1; // Words a CBZ reaches forward
+
+auto filler(int count) -> std::string {
+    std::string lines;
+    for (int i{0}; i < count; i++) {
+        lines += "mov x3, x4\n";
+    }
+    return lines;
+}
+
+auto relaxedState(const std::string &assembly) -> AssemblerState {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state;
+}
+
+TEST(BranchRelaxationTest, InRangeBranchesStayShort) {
+    // The label sits exactly at the furthest address a CBZ reaches
+    const AssemblerState state = relaxedState(
+        "cbz x1, edge\n" + filler(MAX_SHORT_OFFSET - 1) + "edge:");
+    EXPECT_EQ(state.machineCode.size(), MAX_SHORT_OFFSET);
+    EXPECT_EQ(state.machineCode[0], 0xB4000001 | (MAX_SHORT_OFFSET << 5));
+    EXPECT_EQ(state.labelToAddress.at("edge").offset,
+              MAX_SHORT_OFFSET * 4);
+}
+
+TEST(BranchRelaxationTest, OutOfRangeBranchIsExpanded) {
+    const AssemblerState state = relaxedState(
+        "start:\ncbnz w1, far\n" + filler(MAX_SHORT_OFFSET) + "far:\n" +
+        "cbz x2, start");
+    // cbz w1, #8 then b far, which moved forward by the added word
+    EXPECT_EQ(state.machineCode[0], 0x34000041);
+    EXPECT_EQ(state.machineCode[1], 0x14000000 | (MAX_SHORT_OFFSET + 1));
+    EXPECT_EQ(state.labelToAddress.at("far").offset,
+              (MAX_SHORT_OFFSET + 2) * 4);
+    // The backward branch at the end is now out of range too
+    EXPECT_EQ(state.machineCode.size(), MAX_SHORT_OFFSET + 4);
+    EXPECT_EQ(state.machineCode[MAX_SHORT_OFFSET + 2], 0xB5000042);
+}
+
+TEST(BranchRelaxationTest, ExpansionCascades) {
+    // near is in range of the first branch until the second one, which sits
+    // between them, is expanded
+    const AssemblerState state = relaxedState(
+        "cbz x2, near\ncbz x1, far\n" + filler(MAX_SHORT_OFFSET - 2) +
+        "near:\n" + filler(2) + "far:");
+    EXPECT_EQ(state.machineCode.size(), MAX_SHORT_OFFSET + 4);
+    EXPECT_EQ(state.machineCode[0], 0xB5000042);
+    EXPECT_EQ(state.machineCode[1], 0x14000000 | (1 << 18));
+    EXPECT_EQ(state.machineCode[2], 0xB5000041);
+    EXPECT_EQ(state.machineCode[3], 0x14000000 | (1 << 18));
+}
+
+TEST(BranchRelaxationTest, JumpIsUnconditionalBranch) {
+    EXPECT_EQ(relaxedState("loop:\nj loop\njump loop").machineCode,
+              (std::vector<uint32_t>{0x14000000, 0x17FFFFFF}));
+}
+
+TEST(BranchRelaxationTest, DuplicateLabelThrows) {
+    EXPECT_THROW({ relaxedState("a:\nmov x1, x2\na:"); }, std::runtime_error);
+}
@@ -0,0 +1,129 @@
+#include "assembler_context.h"
+#include "assembler_state.h"
+#include "batch_encoder.h"
+#include "disassembler.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Run under -DSANITIZE_THREAD=ON to have ThreadSanitizer check these
+
+constexpr size_t THREAD_COUNT = 8;
+constexpr size_t ITERATIONS = 200;
+
+// Programs that differ in length, labels and registers, so threads sharing
+// any hidden state would see each other's results
+auto concurrentPrograms() -> std::vector<std::string> {
+    std::vector<std::string> programs;
+    for (int variant{0}; variant < 8; variant++) {
+        const std::string label = "loop_" + std::to_string(variant);
+        std::string program = label + ":\n";
+        for (int i{0}; i <= variant * 3; i++) {
+            program += "add x" + std::to_string((i + variant) % 31) + ", x" +
+                       std::to_string(i % 31) + ", #" +
+                       std::to_string(i * variant) + "\n";
+        }
+        program += "cbnz w" + std::to_string(variant) + ", " + label + "\n";
+        program += "ldr x1, [x2, #" + std::to_string(variant * 8) + "]\n";
+        program += "b done\ndone:\nmov x0, x1";
+        programs.push_back(program);
+    }
+    return programs;
+}
+
+auto assembleOnce(const std::string &program) -> std::vector<uint32_t> {
+    AssemblerContext context;
+    const auto words = context.assemble(program);
+    return {words.begin(), words.end()};
+}
+
+// Each thread runs `work` ITERATIONS times and counts the runs that fail
+template <typename Work> auto countFailures(Work work) -> size_t {
+    std::vector<size_t> failures(THREAD_COUNT);
+    std::vector<std::thread> threads;
+    for (size_t thread{0}; thread < THREAD_COUNT; thread++) {
+        threads.emplace_back([&, thread] {
+            for (size_t i{0}; i < ITERATIONS; i++) {
+                if (!work(thread, i)) {
+                    failures[thread]++;
+                }
+            }
+        });
+    }
+    size_t total{0};
+    for (size_t thread{0}; thread < THREAD_COUNT; thread++) {
+        threads[thread].join();
+        total += failures[thread];
+    }
+    return total;
+}
+
+TEST(ConcurrencyTest, ContextsAssembleInParallel) {
+    const std::vector<std::string> programs = concurrentPrograms();
+    std::vector<std::vector<uint32_t>> expected;
+    for (const auto &program : programs) {
+        expected.push_back(assembleOnce(program));
+    }
+
+    std::vector<AssemblerContext> contexts(THREAD_COUNT);
+    EXPECT_EQ(countFailures([&](size_t thread, size_t i) {
+                  const size_t program = (thread + i) % programs.size();
+                  const auto words =
+                      contexts[thread].assemble(programs[program]);
+                  return std::vector<uint32_t>(words.begin(), words.end()) ==
+                         expected[program];
+              }),
+              0);
+}
+
+TEST(ConcurrencyTest, ErrorsStayOnTheirThread) {
+    std::vector<AssemblerContext> contexts(THREAD_COUNT);
+    EXPECT_EQ(countFailures([&](size_t thread, size_t i) {
+                  // Odd threads fail on an undefined label, even ones succeed
+                  if (thread % 2 == 1) {
+                      try {
+                          contexts[thread].assemble("b missing_" +
+                                                    std::to_string(i));
+                      } catch (const std::runtime_error &) {
+                          return true;
+                      }
+                      return false;
+                  }
+                  const std::string label = "here_" + std::to_string(i);
+                  return contexts[thread].assemble(label + ":\nb " + label)
+                             .size() == 1;
+              }),
+              0);
+}
+
+TEST(ConcurrencyTest, BatchEncoderAndDisassemblerInParallel) {
+    const std::vector<std::string> programs = concurrentPrograms();
+    std::vector<std::vector<uint32_t>> expected;
+    std::vector<std::string> listings;
+    for (const auto &program : programs) {
+        expected.push_back(assembleOnce(program));
+        std::vector<DecodedInstruction> decoded(expected.back().size());
+        Disassembler::decode(expected.back(), decoded);
+        listings.push_back(Disassembler::toListing(decoded));
+    }
+
+    EXPECT_EQ(countFailures([&](size_t thread, size_t i) {
+                  const size_t program = (thread + i) % programs.size();
+                  AssemblerState state;
+                  Lexer::tokenize(programs[program], state);
+                  Parser::parse(state);
+                  BatchEncoder::encode(state);
+
+                  std::vector<DecodedInstruction> decoded(
+                      state.machineCode.size());
+                  Disassembler::decode(state.machineCode, decoded);
+                  return state.machineCode == expected[program] &&
+                         Disassembler::toListing(decoded) == listings[program];
+              }),
+              0);
+}
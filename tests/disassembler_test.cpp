@@ -0,0 +1,119 @@
+#include "assembler_state.h"
+#include "disassembler.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include "token.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+auto assemble(const std::string &assembly) -> std::vector<uint32_t> {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state.machineCode;
+}
+
+auto disassemble(const std::vector<uint32_t> &words) -> std::string {
+    std::vector<DecodedInstruction> decoded(words.size());
+    Disassembler::decode(words, decoded);
+    return Disassembler::toListing(decoded);
+}
+
+TEST(DisassemblerTest, DecodeToTokens) {
+    DecodedInstruction decoded = Disassembler::decode(0x8B030041);
+    ASSERT_TRUE(decoded.valid);
+
+    std::vector<Token> expected = {Token::createMnemonic(Mnemonic::ADD),
+                                   Token::createRegister(Register::X1),
+                                   Token::createRegister(Register::X2),
+                                   Token::createRegister(Register::X3)};
+    EXPECT_EQ(Disassembler::toTokens(decoded), expected);
+}
+
+TEST(DisassemblerTest, DecodeToText) {
+    EXPECT_EQ(disassemble({0x913FFC20, 0x529FFFE5}),
+              "add x0, x1, #4095\nmov w5, #65535\n");
+}
+
+TEST(DisassemblerTest, UnknownWord) {
+    DecodedInstruction decoded = Disassembler::decode(0x00000000);
+    EXPECT_FALSE(decoded.valid);
+    EXPECT_EQ(Disassembler::toText(decoded), ".word 0x00000000");
+}
+
+TEST(DisassemblerTest, RoundTrip) {
+    std::string source = "start:\n"
+                         "add x1, x2, x3\n"
+                         "add w1, w2, w30\n"
+                         "add x0, #12, x9\n"
+                         "sub x3, x4, #16\n"
+                         "sub w7, w8, w9\n"
+                         "mov x1, x2\n"
+                         "mov w5, #0xFFFF\n"
+                         "cmp x1, #7\n"
+                         "cmp w1, w2\n"
+                         "and x1, x2, x3\n"
+                         "orr w4, w5, w6\n"
+                         "eor x7, x8, x9\n"
+                         "lsl x1, x2, x3\n"
+                         "lsr w1, w2, #3\n"
+                         "asr x1, x2, #63\n"
+                         "ldr x1, [x2]\n"
+                         "ldr w1, [x2, #4092]\n"
+                         "str x1, [x30, #32760]\n"
+                         "ldr x3, end\n"
+                         "cbz w1, start\n"
+                         "cbnz x1, end\n"
+                         "b start\n"
+                         "bl end\n"
+                         "end:";
+    std::vector<uint32_t> words = assemble(source);
+    std::vector<uint32_t> reassembled = assemble(disassemble(words));
+    EXPECT_EQ(words, reassembled);
+}
+
+TEST(DisassemblerTest, TargetsOutsideTheListingRoundTrip) {
+    // A run cut from the middle of a program, branching back before it and
+    // forward past its end
+    const std::vector<uint32_t> program =
+        assemble("before:\nmov x1, x2\nloop:\ncbz x1, before\nb after\n"
+                 "b loop\nmov x3, x4\nafter:\n");
+    const std::vector<uint32_t> run(program.begin() + 1, program.end() - 1);
+    const std::string listing = disassemble(run);
+    EXPECT_EQ(listing, "; L_m4 is outside this listing\n"
+                       "; L_10 is outside this listing\n"
+                       "L_0:\n"
+                       "cbz x1, L_m4\n"
+                       "b L_10\n"
+                       "b L_0\n");
+
+    // Defined where they are, around the listing, the words come back
+    const std::vector<uint32_t> reassembled =
+        assemble("L_m4:\nmov x1, x2\n" + listing + "mov x3, x4\nL_10:\n");
+    EXPECT_EQ(reassembled, program);
+}
+
+TEST(DisassemblerTest, OutputBufferTooSmall) {
+    std::vector<uint32_t> words{0x8B030041, 0x8B030041};
+    std::vector<DecodedInstruction> decoded(1);
+    EXPECT_THROW({ Disassembler::decode(words, decoded); }, std::runtime_error);
+}
+
+TEST(DisassemblerTest, MemoryAndBranchText) {
+    std::vector<uint32_t> words = assemble("loop:\nldr w1, [x2, #8]\n"
+                                           "str x3, [x4]\nb loop");
+    EXPECT_EQ(disassemble(words), "L_0:\n"
+                                  "ldr w1, [x2, #8]\n"
+                                  "str x3, [x4]\n"
+                                  "b L_0\n");
+}
+
+TEST(DisassemblerTest, AliasesPreferred) {
+    // ORR with the zero register is shown as MOV
+    EXPECT_EQ(disassemble({0xAA0203E1}), "mov x1, x2\n");
+    EXPECT_EQ(disassemble({0xAA030041}), "orr x1, x2, x3\n");
+}
@@ -0,0 +1,104 @@
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+auto getEncoderOutput(const std::string &assembly) -> std::vector<uint32_t> {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state.machineCode;
+}
+
+TEST(EncoderTest, AddRegisters) {
+    EXPECT_EQ(getEncoderOutput("add x1, x2, x3"),
+              std::vector<uint32_t>{0x8B030041});
+    EXPECT_EQ(getEncoderOutput("add w1, w2, w3"),
+              std::vector<uint32_t>{0x0B030041});
+}
+
+TEST(EncoderTest, AddSubImmediate) {
+    EXPECT_EQ(getEncoderOutput("add x0, x1, #4095"),
+              std::vector<uint32_t>{0x913FFC20});
+    EXPECT_EQ(getEncoderOutput("sub x3, x4, #16"),
+              std::vector<uint32_t>{0xD1004083});
+    // Immediate in the middle is the same instruction with swapped arguments
+    EXPECT_EQ(getEncoderOutput("add x0, #4095, x1"),
+              getEncoderOutput("add x0, x1, #4095"));
+}
+
+TEST(EncoderTest, Mov) {
+    EXPECT_EQ(getEncoderOutput("mov x1, x2"),
+              std::vector<uint32_t>{0xAA0203E1});
+    EXPECT_EQ(getEncoderOutput("mov w5, #0xFFFF"),
+              std::vector<uint32_t>{0x529FFFE5});
+}
+
+TEST(EncoderTest, LabelsTakeNoSpace) {
+    EXPECT_EQ(getEncoderOutput("start:\nmov x1, x2\nend:").size(), 1);
+}
+
+TEST(EncoderTest, ImmediateOutOfRange) {
+    EXPECT_THROW({ getEncoderOutput("add x1, x2, #4096"); },
+                 std::runtime_error);
+    EXPECT_THROW({ getEncoderOutput("mov x1, #-1"); }, std::runtime_error);
+}
+
+TEST(EncoderTest, MixedRegisterWidths) {
+    EXPECT_THROW({ getEncoderOutput("add x1, w2, x3"); }, std::runtime_error);
+}
+
+TEST(EncoderTest, CompareAndLogical) {
+    EXPECT_EQ(getEncoderOutput("cmp x1, x2\ncmp w3, #42"),
+              (std::vector<uint32_t>{0xEB02003F, 0x7100A87F}));
+    EXPECT_EQ(
+        getEncoderOutput("and x1, x2, x3\norr w1, w2, w3\neor x4, x5, x6"),
+        (std::vector<uint32_t>{0x8A030041, 0x2A030041, 0xCA0600A4}));
+}
+
+TEST(EncoderTest, Shifts) {
+    EXPECT_EQ(
+        getEncoderOutput("lsl x1, x2, x3\nlsr x1, x2, #4\nasr w1, w2, #31"),
+        (std::vector<uint32_t>{0x9AC32041, 0xD344FC41, 0x131F7C41}));
+    EXPECT_THROW({ getEncoderOutput("lsr w1, w2, #32"); }, std::runtime_error);
+}
+
+TEST(EncoderTest, Branches) {
+    // Backward and forward references, relative to each instruction
+    EXPECT_EQ(getEncoderOutput("start:\nb end\nbl start\ncbz x1, start\n"
+                               "cbnz w2, end\nend:"),
+              (std::vector<uint32_t>{0x14000004, 0x97FFFFFF, 0xB4FFFFC1,
+                                     0x35000022}));
+    EXPECT_THROW({ getEncoderOutput("b nowhere"); }, std::runtime_error);
+}
+
+TEST(EncoderTest, LoadStore) {
+    EXPECT_EQ(getEncoderOutput("ldr x1, [x2]\nldr w1, [x2, #8]\n"
+                               "str x3, [x4, #16]\nldr x5, data\ndata:"),
+              (std::vector<uint32_t>{0xF9400041, 0xB9400841, 0xF9000883,
+                                     0x58000025}));
+    // Offsets are in units of the access size and bases are X registers
+    EXPECT_THROW({ getEncoderOutput("ldr x1, [x2, #4]"); }, std::runtime_error);
+    EXPECT_THROW({ getEncoderOutput("str x1, [w2]"); }, std::runtime_error);
+}
+
+TEST(EncoderTest, SectionsAreNotInterleaved) {
+    // Data follows all of the code, whatever order the source uses
+    const std::string assembly = ".data\n"
+                                 "value:\n"
+                                 "mov x9, x9\n"
+                                 ".text\n"
+                                 "ldr x1, value\n"
+                                 ".data\n"
+                                 "mov x8, x8\n"
+                                 ".text\n"
+                                 "b value";
+    EXPECT_EQ(getEncoderOutput(assembly),
+              (std::vector<uint32_t>{0x58000041, 0x14000001, 0xAA0903E9,
+                                     0xAA0803E8}));
+}
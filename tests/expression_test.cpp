@@ -0,0 +1,67 @@
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include "token.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+auto lexedImmediate(const std::string &assembly) -> Immediate {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    return std::get<Immediate>(state.tokens.back().token);
+}
+
+auto encodeExpressions(const std::string &assembly) -> std::vector<uint32_t> {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state.machineCode;
+}
+
+TEST(ExpressionTest, ConstantsFoldWhileLexing) {
+    EXPECT_EQ(lexedImmediate("mov x1, #2 + 3 * 4").val, 14);
+    EXPECT_EQ(lexedImmediate("mov x1, #(2 + 3) * 4").val, 20);
+    EXPECT_EQ(lexedImmediate("mov x1, #1 << 4 | 0x3").val, 19);
+    EXPECT_EQ(lexedImmediate("mov x1, #-(7 / 2) % 2").val, -1);
+    EXPECT_EQ(lexedImmediate("mov x1, #~0 & 0xFF").val, 255);
+    EXPECT_EQ(lexedImmediate("mov x1, #-2147483648").val, INT32_MIN);
+}
+
+TEST(ExpressionTest, EquConstants) {
+    const Immediate immediate = lexedImmediate(
+        ".equ TABLE_SIZE, 16\n.set ENTRY, TABLE_SIZE / 2\n"
+        "add x1, x2, #TABLE_SIZE * ENTRY");
+    EXPECT_EQ(immediate.val, 128);
+    EXPECT_EQ(immediate.expression, NO_EXPRESSION);
+    EXPECT_THROW({ lexedImmediate(".equ A, 1\n.equ A, 2\nmov x1, #A"); },
+                 std::runtime_error);
+}
+
+TEST(ExpressionTest, LabelsAreResolvedAfterLayout) {
+    // Three words between start and end, counted before end is defined
+    EXPECT_EQ(encodeExpressions("start:\nmov x1, #(end - start) / 4\n"
+                                "mov x2, x3\nmov x4, x5\nend:"),
+              encodeExpressions("mov x1, #3\nmov x2, x3\nmov x4, x5"));
+    // Constants may use labels and be defined after their use
+    EXPECT_EQ(encodeExpressions("add x1, x2, #BYTES\n.equ BYTES, "
+                                "end - start\nstart:\nmov x2, x3\nend:"),
+              encodeExpressions("add x1, x2, #4\nmov x2, x3"));
+}
+
+TEST(ExpressionTest, InvalidExpressionsThrow) {
+    EXPECT_THROW({ lexedImmediate("mov x1, #(1 + 2"); }, std::runtime_error);
+    EXPECT_THROW({ lexedImmediate("mov x1, #1 +"); }, std::runtime_error);
+    EXPECT_THROW({ lexedImmediate("mov x1, #4 / 0"); }, std::runtime_error);
+    EXPECT_THROW({ lexedImmediate("mov x1, #1 << 64"); }, std::runtime_error);
+    EXPECT_THROW({ lexedImmediate("mov x1, #0x80000000"); },
+                 std::runtime_error);
+    EXPECT_THROW({ encodeExpressions("mov x1, #missing * 2"); },
+                 std::runtime_error);
+    EXPECT_THROW({ encodeExpressions(".equ A, B\n.equ B, A\nmov x1, #A"); },
+                 std::runtime_error);
+}
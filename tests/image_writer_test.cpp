@@ -0,0 +1,104 @@
+#include "image_writer.h"
+#include "mapped_file.h"
+#include <elf.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+auto writtenImage(const Image &image, ImageFormat format,
+                  uint32_t loadAddress) -> std::string {
+    const std::string path = testing::TempDir() + "image_writer_test.out";
+    ImageWriter::write(path, image, format, loadAddress);
+    const MappedFile file(path);
+    std::string bytes(reinterpret_cast<const char *>(file.bytes().data()),
+                      file.bytes().size());
+    std::remove(path.c_str());
+    return bytes;
+}
+
+// Address to byte of every data record, checking each record's checksum
+auto decodeIhex(const std::string &hex) -> std::map<uint32_t, uint8_t> {
+    std::map<uint32_t, uint8_t> memory;
+    uint32_t upper{0};
+    std::istringstream lines(hex);
+    std::string line;
+    while (std::getline(lines, line)) {
+        EXPECT_EQ(line[0], ':');
+        std::vector<uint8_t> record;
+        uint8_t sum{0};
+        for (size_t i{1}; i + 1 < line.size(); i += 2) {
+            record.push_back(static_cast<uint8_t>(
+                std::stoul(line.substr(i, 2), nullptr, 16)));
+            sum = static_cast<uint8_t>(sum + record.back());
+        }
+        EXPECT_EQ(sum, 0) << line;
+        EXPECT_EQ(record.size(), record[0] + 5U) << line;
+        const uint32_t address = (record[1] << 8U) | record[2];
+        if (record[3] == 0x04) {
+            upper = static_cast<uint32_t>((record[4] << 8U) | record[5]) << 16U;
+        } else if (record[3] == 0x00) {
+            for (size_t i{0}; i < record[0]; i++) {
+                memory[upper + address + static_cast<uint32_t>(i)] =
+                    record[4 + i];
+            }
+        }
+    }
+    return memory;
+}
+
+TEST(ImageWriterTest, BinaryIsTheImage) {
+    const Image image{{0xAA0203E1, 0x14000000}, {}, std::nullopt};
+    EXPECT_EQ(writtenImage(image, ImageFormat::BINARY, 0x1000),
+              std::string("\xE1\x03\x02\xAA\x00\x00\x00\x14", 8));
+    EXPECT_EQ(writtenImage(Image{}, ImageFormat::BINARY, 0), "");
+}
+
+TEST(ImageWriterTest, IhexHasAddressDataStartAndEndRecords) {
+    const Image image{{0xAA0203E1, 0x14000000}, {}, 4};
+    EXPECT_EQ(writtenImage(image, ImageFormat::IHEX, 0x08000000),
+              ":020000040800F2\n"
+              ":08000000E10302AA0000001454\n"
+              ":0400000508000004EB\n"
+              ":00000001FF\n");
+}
+
+TEST(ImageWriterTest, IhexRecordsStopAtSegments) {
+    Image image;
+    for (uint32_t i{0}; i < 40; i++) {
+        image.words.push_back(i * 0x01010101U);
+    }
+    // Starts 8 bytes before a 64 KiB boundary, unaligned to records
+    const std::string hex = writtenImage(image, ImageFormat::IHEX, 0x1FFF8);
+    EXPECT_EQ(hex.size(), ImageWriter::size(ImageFormat::IHEX, 160, 0x1FFF8,
+                                            false));
+    EXPECT_NE(hex.find(":020000040002F8\n"), std::string::npos);
+
+    const std::map<uint32_t, uint8_t> memory = decodeIhex(hex);
+    ASSERT_EQ(memory.size(), 160);
+    std::vector<uint8_t> bytes(160);
+    std::memcpy(bytes.data(), image.words.data(), bytes.size());
+    for (uint32_t i{0}; i < bytes.size(); i++) {
+        EXPECT_EQ(memory.at(0x1FFF8 + i), bytes[i]) << i;
+    }
+}
+
+TEST(ImageWriterTest, ElfImageStartsAtEntry) {
+    const Image image{{0xAA0203E1, 0x14000000}, {}, 4};
+    const std::string elf = writtenImage(image, ImageFormat::ELF, 0);
+
+    Elf64_Ehdr header{};
+    std::memcpy(&header, elf.data(), sizeof(header));
+    EXPECT_EQ(std::memcmp(header.e_ident, ELFMAG, SELFMAG), 0);
+    EXPECT_EQ(header.e_machine, EM_AARCH64);
+    EXPECT_EQ(header.e_entry, ELF_LOAD_ADDRESS + ELF_IMAGE_OFFSET + 4);
+    ASSERT_EQ(elf.size(), ELF_IMAGE_OFFSET + 8);
+    EXPECT_EQ(std::memcmp(elf.data() + ELF_IMAGE_OFFSET, image.words.data(),
+                          8),
+              0);
+}
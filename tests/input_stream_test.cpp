@@ -0,0 +1,127 @@
+#include "assembler_state.h"
+#include "input_stream.h"
+#include "lexer.h"
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+// Long enough that only a stream waiting on its producer misses it
+constexpr std::chrono::seconds STREAM_DEADLINE{10};
+
+// Tokenizes what a writer thread sends through a pipe
+auto streamedState(const std::string &assembly, size_t chunkSize)
+    -> AssemblerState {
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    std::thread writer([&assembly, fd = fds[1]] {
+        // Small writes, so chunks are filled from several reads
+        for (size_t i{0}; i < assembly.size(); i += 5) {
+            const size_t size = std::min<size_t>(5, assembly.size() - i);
+            EXPECT_EQ(write(fd, assembly.data() + i, size),
+                      static_cast<ssize_t>(size));
+        }
+        close(fd);
+    });
+    AssemblerState state;
+    {
+        InputStream input(fds[0], chunkSize);
+        Lexer::tokenizeStream(input, state, "<stdin>");
+    }
+    writer.join();
+    close(fds[0]);
+    return state;
+}
+
+TEST(InputStreamTest, StreamsLikeWholeInput) {
+    const std::string assembly =
+        "start:\n  mov x1, #1 ; one\n\nadd x2, x1, #(3 + 4)\n"
+        "a_label_longer_than_a_chunk:\nldr x3, =0x1122334455\n"
+        "\n\ncbz x3, start\n.data\nmov x4, x4";
+    AssemblerState whole;
+    Lexer::tokenize(assembly, whole, "<stdin>");
+    for (const size_t chunkSize : {1, 7, 16, 4096}) {
+        const AssemblerState streamed = streamedState(assembly, chunkSize);
+        EXPECT_EQ(streamed.tokens, whole.tokens) << chunkSize;
+        for (size_t token{0}; token < whole.tokens.size(); token++) {
+            EXPECT_EQ(streamed.sourceMap.describe(token),
+                      whole.sourceMap.describe(token))
+                << chunkSize;
+        }
+    }
+    // With a final line break too
+    EXPECT_EQ(streamedState(assembly + "\n", 7).tokens.size(),
+              whole.tokens.size());
+    EXPECT_TRUE(streamedState("", 7).tokens.empty());
+}
+
+TEST(InputStreamTest, ErrorsStopTheReader) {
+    // The writer is done before lexing starts, and the reader fills the
+    // ring and waits on it until the lexer gives up at line 3
+    std::string assembly = "mov x1, #1\nmov x2, #2\nbad x3\n";
+    for (int i{0}; i < 1000; i++) {
+        assembly += "mov x1, #1\n";
+    }
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_EQ(write(fds[1], assembly.data(), assembly.size()),
+              static_cast<ssize_t>(assembly.size()));
+    close(fds[1]);
+    AssemblerState state;
+    try {
+        InputStream input(fds[0], 16);
+        Lexer::tokenizeStream(input, state);
+        FAIL() << "Expected an error";
+    } catch (const std::runtime_error &error) {
+        EXPECT_NE(std::string(error.what()).find("line: 3"),
+                  std::string::npos)
+            << error.what();
+    }
+    close(fds[0]);
+
+    InputStream closed(-1, 16);
+    EXPECT_THROW(closed.next(), std::runtime_error);
+}
+
+TEST(InputStreamTest, ErrorsStopTheReaderWhileTheProducerIsIdle) {
+    // The writer end stays open with nothing more to say, so only closing
+    // the stream can end the reader's wait
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    const std::string assembly = "bad x3\n";
+    ASSERT_EQ(write(fds[1], assembly.data(), assembly.size()),
+              static_cast<ssize_t>(assembly.size()));
+    auto lexing = std::async(std::launch::async, [fd = fds[0]] {
+        AssemblerState state;
+        InputStream input(fd);
+        Lexer::tokenizeStream(input, state);
+    });
+    const bool stopped =
+        lexing.wait_for(STREAM_DEADLINE) == std::future_status::ready;
+    close(fds[1]); // Lets a stuck reader finish, so the test ends either way
+    EXPECT_TRUE(stopped);
+    EXPECT_THROW(lexing.get(), std::runtime_error);
+    close(fds[0]);
+}
+
+TEST(InputStreamTest, SlowInputIsHandedOverAsItArrives) {
+    // One line, far short of a chunk, and the writer end stays open
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    const std::string line = "mov x1, x2\n";
+    ASSERT_EQ(write(fds[1], line.data(), line.size()),
+              static_cast<ssize_t>(line.size()));
+    InputStream input(fds[0]);
+    auto first = std::async(std::launch::async,
+                            [&input] { return std::string(input.next()); });
+    const bool arrived =
+        first.wait_for(STREAM_DEADLINE) == std::future_status::ready;
+    close(fds[1]);
+    EXPECT_TRUE(arrived);
+    EXPECT_EQ(first.get(), line);
+    EXPECT_TRUE(input.next().empty());
+    close(fds[0]);
+}
@@ -0,0 +1,123 @@
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lazy_assembler.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The .global of square sits in the body of unused
+const std::string LIBRARY = ".equ STEP, 8\n"
+                            ".global sum\n"
+                            ".global unused\n"
+                            "sum:\n"
+                            "mov x2, #0\n"
+                            "loop:\n"
+                            "bl square\n"
+                            "add x2, x2, #STEP\n"
+                            "sub x1, x1, #1\n"
+                            "cbnz x1, loop\n"
+                            "b sum\n"
+                            "unused:\n"
+                            "mov x9, #99\n"
+                            ".global square\n"
+                            "square:\n"
+                            "ldr x3, =0x1122334455\n"
+                            "mov x0, x3\n"
+                            "b square\n";
+
+} // namespace
+
+auto wholeProgramCode(const std::string &assembly) -> std::vector<uint32_t> {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state.machineCode;
+}
+
+TEST(LazyAssemblerTest, AssemblesOnlyWhatIsCalled) {
+    LazyAssembler library(LIBRARY);
+    EXPECT_EQ(library.symbolCount(), 3);
+    EXPECT_EQ(library.assembledCount(), 0);
+    EXPECT_TRUE(library.code().empty());
+
+    // sum pulls in square, which it calls, but not unused
+    const AssembledSymbol sum = library.assembleSymbol("sum");
+    EXPECT_EQ(library.assembledCount(), 2);
+    EXPECT_EQ(sum.address, 0);
+    EXPECT_EQ(sum.size, 6 * 4);
+    const std::vector<uint32_t> code(library.code().begin(),
+                                     library.code().end());
+    EXPECT_EQ(code, wholeProgramCode(".equ STEP, 8\nsum:\nmov x2, #0\n"
+                                     "loop:\nbl square\nadd x2, x2, #STEP\n"
+                                     "sub x1, x1, #1\ncbnz x1, loop\n"
+                                     "b sum\nsquare:\n"
+                                     "ldr x3, =0x1122334455\nmov x0, x3\n"
+                                     "b square\n"));
+    EXPECT_EQ(library.assembleSymbol("square").address, 6 * 4);
+}
+
+TEST(LazyAssemblerTest, ResultsAreCached) {
+    LazyAssembler library(LIBRARY);
+    const AssembledSymbol first = library.assembleSymbol("unused");
+    const size_t words = library.code().size();
+    const AssembledSymbol again = library.assembleSymbol("unused");
+    EXPECT_EQ(first.address, again.address);
+    EXPECT_EQ(library.code().size(), words);
+    EXPECT_EQ(library.assembledCount(), 1);
+}
+
+TEST(LazyAssemblerTest, EveryLabelIsASymbolWithoutGlobals) {
+    LazyAssembler library("start:\nmov x1, #1\n.data\ntable:\nmov x2, #2\n"
+                          ".text\nnext:\nb start\n");
+    EXPECT_EQ(library.symbolCount(), 3);
+    // table starts in .data, so its body does too
+    EXPECT_EQ(library.assembleSymbol("table").size, 4);
+    const AssembledSymbol next = library.assembleSymbol("next");
+    EXPECT_EQ(library.assembledCount(), 3);
+    EXPECT_EQ(library.assembleSymbol("start").address, next.address + 4);
+}
+
+TEST(LazyAssemblerTest, ErrorsLeaveTheCodeAsItWas) {
+    LazyAssembler library("first:\nmov x1, #1\nsecond:\nmov x1, #1\n"
+                          "bl missing\nthird:\nmov x2, x1\nmov x3, #-1\n",
+                          "lib.s");
+    library.assembleSymbol("first");
+    const size_t words = library.code().size();
+    EXPECT_THROW(library.assembleSymbol("missing"), std::runtime_error);
+    EXPECT_THROW(library.assembleSymbol("second"), std::runtime_error);
+    try {
+        library.assembleSymbol("third");
+        FAIL() << "Expected an error";
+    } catch (const std::runtime_error &error) {
+        // Lines are numbered as in the whole library
+        EXPECT_NE(std::string(error.what()).find("lib.s:8"),
+                  std::string::npos)
+            << error.what();
+    }
+    EXPECT_EQ(library.code().size(), words);
+    EXPECT_EQ(library.assembledCount(), 1);
+    EXPECT_THROW(LazyAssembler("twice:\ntwice:\n"), std::runtime_error);
+}
+
+TEST(LazyAssemblerTest, LabelAddressesInImmediatesThrow) {
+    LazyAssembler library(".global a\n.global b\na:\nmov x0, #1\nb a\n"
+                          "b:\nmov x0, #b\nb b\n"
+                          ".global c\nc:\nmov x0, #(end - c) / 4\n"
+                          "end:\nb c\n");
+    library.assembleSymbol("a");
+    const size_t words = library.code().size();
+    // b's address in code() is only known once it is placed
+    EXPECT_THROW(library.assembleSymbol("b"), std::runtime_error);
+    EXPECT_EQ(library.code().size(), words);
+    // A difference of the body's own labels is the same wherever it goes
+    const AssembledSymbol c = library.assembleSymbol("c");
+    EXPECT_EQ(library.code()[static_cast<size_t>(c.address) / 4],
+              0xD2800020); // mov x0, #1
+}
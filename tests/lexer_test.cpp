@@ -7,9 +7,8 @@
 #include <vector>
 
 auto getLexerOutput(const std::string &lexerInput) -> std::vector<Token> {
-    Lexer lexer;
     AssemblerState state;
-    lexer.tokenize(lexerInput, state);
+    Lexer::tokenize(lexerInput, state);
     return state.tokens;
 }
 
@@ -159,7 +158,7 @@ TEST(LexerTest, MultipleLabels) {
 }
 
 TEST(LexerTest, InvalidImmediate) {
-    std::string testInput = "add x1, x2, #invalid";
+    std::string testInput = "add x1, x2, #12invalid";
     EXPECT_THROW({ getLexerOutput(testInput); }, std::runtime_error);
 }
 
@@ -218,3 +217,78 @@ TEST(LexerTest, WhitespaceTrimmed) {
     std::vector<Token> lexerOutput = getLexerOutput(testInput);
     validateLexerOutput(lexerOutput, expected);
 }
+
+TEST(LexerTest, MemoryOperand) {
+    std::string testInput = "ldr x1, [x2, #8]\nstr w3, [ x4 ]";
+
+    std::vector<Token> expected = {Token::createMnemonic(Mnemonic::LDR),
+                                   Token::createRegister(Register::X1),
+                                   Token::createLeftBracket(),
+                                   Token::createRegister(Register::X2),
+                                   Token::createImmediate(Immediate{8}),
+                                   Token::createRightBracket(),
+                                   Token::createNewline(),
+                                   Token::createMnemonic(Mnemonic::STR),
+                                   Token::createRegister(Register::W3),
+                                   Token::createLeftBracket(),
+                                   Token::createRegister(Register::X4),
+                                   Token::createRightBracket()};
+
+    std::vector<Token> lexerOutput = getLexerOutput(testInput);
+    validateLexerOutput(lexerOutput, expected);
+}
+
+TEST(LexerTest, ForwardLabelReference) {
+    std::string testInput = "cbz x1, done\ndone:";
+    Label label{"done"};
+
+    std::vector<Token> expected = {Token::createMnemonic(Mnemonic::CBZ),
+                                   Token::createRegister(Register::X1),
+                                   Token::createLabel(label),
+                                   Token::createNewline(),
+                                   Token::createLabel(label)};
+
+    std::vector<Token> lexerOutput = getLexerOutput(testInput);
+    validateLexerOutput(lexerOutput, expected);
+}
+
+TEST(LexerTest, InvalidRegister) {
+    std::string testInput = "add x1, x2, x99";
+    EXPECT_THROW({ getLexerOutput(testInput); }, std::runtime_error);
+}
+
+TEST(LexerTest, MnemonicLookup) {
+    EXPECT_EQ(lookupMnemonic("j"), Mnemonic::JUMP);
+    EXPECT_EQ(lookupMnemonic("jump"), Mnemonic::JUMP);
+    EXPECT_EQ(lookupMnemonic("cbnz"), Mnemonic::CBNZ);
+    EXPECT_EQ(lookupMnemonic("cbnzz"), std::nullopt);
+    EXPECT_EQ(lookupMnemonic(""), std::nullopt);
+    static_assert(lookupMnemonic("ldr") == Mnemonic::LDR);
+}
+
+TEST(LexerTest, LabelWithUnderscore) {
+    std::string testInput = "_loop_start:";
+
+    std::vector<Token> expected = {Token::createLabel(Label{"_loop_start"})};
+
+    std::vector<Token> lexerOutput = getLexerOutput(testInput);
+    validateLexerOutput(lexerOutput, expected);
+}
+
+TEST(LexerTest, LiteralValues) {
+    std::string testInput = "ldr x1, =0xFFFFFFFFFFFFFFFF\nldr w2, =-1";
+
+    std::vector<Token> expected = {
+        Token::createMnemonic(Mnemonic::LDR),
+        Token::createRegister(Register::X1),
+        Token::createLiteral(Literal{UINT64_MAX}),
+        Token::createNewline(),
+        Token::createMnemonic(Mnemonic::LDR),
+        Token::createRegister(Register::W2),
+        Token::createLiteral(Literal{UINT64_MAX})};
+
+    std::vector<Token> lexerOutput = getLexerOutput(testInput);
+    validateLexerOutput(lexerOutput, expected);
+    EXPECT_THROW({ getLexerOutput("ldr x1, =0x10000000000000000"); },
+                 std::runtime_error);
+}
@@ -0,0 +1,143 @@
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "linker.h"
+#include "object_file.h"
+#include "parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Assembles a unit and round trips its object file through bytes
+auto objectOf(const std::string &assembly) -> ObjectFile {
+    AssemblerState state;
+    state.relocatable = true;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return ObjectFile::load(ObjectFile::fromState(state).serialize());
+}
+
+auto assembleWhole(const std::string &assembly) -> std::vector<uint32_t> {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state.machineCode;
+}
+
+TEST(LinkerTest, CallsAcrossUnitsResolve) {
+    const std::vector<ObjectFile> units = {
+        objectOf(".global _start\n_start:\nbl helper\ncbz x0, helper\n"
+                 "b _start\n"),
+        objectOf(".global helper\nhelper:\nmov x0, x1\nb _start\n")};
+
+    const Image image = Linker::link(units, 1);
+    // The same as assembling both units as one
+    EXPECT_EQ(image.words,
+              assembleWhole("_start:\nbl helper\ncbz x0, helper\nb _start\n"
+                            "helper:\nmov x0, x1\nb _start\n"));
+    EXPECT_EQ(image.entry, 0);
+}
+
+TEST(LinkerTest, SectionsMergeInUnitOrder) {
+    // The branches to data are relocated, as merging moves data away
+    const std::vector<ObjectFile> units = {
+        objectOf("b first\nldr x1, =0x123456789\n.data\nfirst:\n"
+                 "mov x2, x3\n"),
+        objectOf("cbz x4, second\n.data\nsecond:\nb done\ndone:\n")};
+
+    const Image image = Linker::link(units, 1);
+    EXPECT_EQ(image.words,
+              assembleWhole("b first\nldr x1, =0x123456789\n.ltorg\n"
+                            "cbz x4, second\n.data\nfirst:\nmov x2, x3\n"
+                            "second:\nb done\ndone:\n"));
+    EXPECT_EQ(image.sectionBases[1], 6 * 4);
+}
+
+TEST(LinkerTest, UnitsWithXLiteralsAreAligned) {
+    const std::vector<ObjectFile> units = {
+        objectOf("mov x1, x2\n"), objectOf("ldr x1, =0x123456789\n")};
+
+    const Image image = Linker::link(units, 1);
+    // A zero word pads the second unit to eight bytes, so its value is
+    // aligned: ldr, a spare word, then the value
+    EXPECT_EQ(image.words.size(), 6);
+    EXPECT_EQ(image.words[1], 0);
+    EXPECT_EQ(image.words[2], 0x58000041);
+    EXPECT_EQ(image.words[4], 0x23456789);
+
+    // The alignment survives the object file, and a bad one is corrupt.
+    // The text section's alignment follows the magic, version and sizes.
+    std::vector<std::byte> bytes = units[1].serialize();
+    EXPECT_EQ(ObjectFile::load(bytes).alignments, units[1].alignments);
+    bytes[20] = std::byte{3};
+    EXPECT_THROW(ObjectFile::load(bytes), std::runtime_error);
+}
+
+TEST(LinkerTest, OnlySameSectionLabelDifferencesAreRelocatable) {
+    // A difference within one section keeps its value wherever the unit
+    // goes, so the linked image matches assembling both units as one
+    const std::vector<ObjectFile> units = {
+        objectOf("mov x1, x2\n"),
+        objectOf("start:\nmov x0, #(end - start) / 4\nmov x1, x1\nend:\n")};
+    EXPECT_EQ(Linker::link(units, 1).words,
+              assembleWhole("mov x1, x2\nstart:\nmov x0, #(end - start) / 4\n"
+                            "mov x1, x1\nend:\n"));
+
+    // The address itself, a difference across sections and an address
+    // through another operator all depend on where the linker puts them
+    for (const std::string assembly :
+         {"helper:\nmov x0, #helper\n",
+          "f:\nmov x0, #(d - f)\n.data\nd:\n",
+          "f:\nmov x0, #(f * 2 - f)\n",
+          ".equ HERE, f + 4\nf:\nmov x0, #HERE\n"}) {
+        EXPECT_THROW(objectOf(assembly), std::runtime_error) << assembly;
+    }
+}
+
+TEST(LinkerTest, ThreadsLinkLikeOne) {
+    std::vector<ObjectFile> units;
+    for (int i{0}; i < 200; i++) {
+        const std::string self = "f" + std::to_string(i);
+        const std::string next = "f" + std::to_string((i + 1) % 200);
+        units.push_back(objectOf(".global " + self + "\n" + self +
+                                 ":\nadd x1, x2, #" + std::to_string(i) +
+                                 "\nbl " + next + "\nb " + self + "\n"));
+    }
+    const Image serial = Linker::link(units, 1);
+    const Image parallel = Linker::link(units, 8);
+    EXPECT_EQ(serial.words, parallel.words);
+
+    std::vector<std::vector<std::byte>> bytes;
+    std::vector<std::span<const std::byte>> objects;
+    for (const ObjectFile &unit : units) {
+        bytes.push_back(unit.serialize());
+    }
+    for (const auto &object : bytes) {
+        objects.push_back(object);
+    }
+    EXPECT_EQ(Linker::link(Linker::load(objects, 8), 8).words, serial.words);
+}
+
+TEST(LinkerTest, SymbolErrorsThrow) {
+    // Undefined, only defined locally elsewhere, and defined twice
+    EXPECT_THROW(Linker::link(std::vector{objectOf("b missing\n")}),
+                 std::runtime_error);
+    EXPECT_THROW(Linker::link(std::vector{objectOf("b hidden\n"),
+                                          objectOf("hidden:\nmov x1, x2\n")}),
+                 std::runtime_error);
+    EXPECT_THROW(
+        Linker::link(std::vector{objectOf(".global twice\ntwice:\n"),
+                                 objectOf(".global twice\ntwice:\n")}),
+        std::runtime_error);
+    EXPECT_THROW(ObjectFile::load(std::vector<std::byte>(8)),
+                 std::runtime_error);
+    // Exported but never defined, as with a typo
+    EXPECT_THROW(objectOf(".global _strat\n_start:\nmov x1, x2\n"),
+                 std::runtime_error);
+}
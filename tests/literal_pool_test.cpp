@@ -0,0 +1,110 @@
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr uint32_t FILLER_WORD = 0xAA0403E3; // mov x3, x4
+
+auto assembleWithPools(const std::string &assembly) -> AssemblerState {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state;
+}
+
+// Address an LDR (literal) at the word index loads from
+auto poolLoadTarget(const AssemblerState &state, size_t word) -> size_t {
+    const uint32_t offset = (state.machineCode[word] >> 5U) & 0x7FFFFU;
+    return (word + offset) * 4;
+}
+
+TEST(LiteralPoolTest, IdenticalValuesShareAnEntry) {
+    const AssemblerState state = assembleWithPools(
+        "ldr x1, =0x1122334455667788\nldr x2, =0x1122334455667788");
+    // Both loads reach the one entry placed after them, then a spare word
+    const std::vector<uint32_t> expected = {0x58000041, 0x58000022,
+                                            0x55667788, 0x11223344, 0};
+    EXPECT_EQ(state.machineCode, expected);
+    EXPECT_EQ(state.literalPools.entryCount(), 1);
+}
+
+TEST(LiteralPoolTest, WRegistersLoadFourBytes) {
+    const AssemblerState state =
+        assembleWithPools("ldr w1, =-1\nldr x2, =-1\nldr w3, =0xFFFFFFFF");
+    // The W loads share a word; the X load needs its own eight bytes, which
+    // come first and are aligned by the spare word
+    const std::vector<uint32_t> expected = {0x180000C1, 0x58000062,
+                                            0x18000083, 0,
+                                            0xFFFFFFFF, 0xFFFFFFFF,
+                                            0xFFFFFFFF};
+    EXPECT_EQ(state.machineCode, expected);
+}
+
+TEST(LiteralPoolTest, LtorgPlacesThePool) {
+    const AssemblerState state =
+        assembleWithPools("ldr x1, =5\n.ltorg\nmov x3, x4\nldr x2, =5");
+    // A value pooled before .ltorg is not shared with later loads
+    const std::vector<uint32_t> expected = {
+        0x58000041, 0, 5, 0, FILLER_WORD, 0x58000022, 5, 0, 0};
+    EXPECT_EQ(state.machineCode, expected);
+}
+
+TEST(LiteralPoolTest, EachSectionHasItsOwnPool) {
+    const AssemblerState state =
+        assembleWithPools("ldr w1, =9\n.data\nldr w2, =9\n.text\nmov x3, x4");
+    const std::vector<uint32_t> text = {0x18000041, FILLER_WORD, 9};
+    const std::vector<uint32_t> data = {0x18000022, 9};
+    EXPECT_EQ(state.section(Section::TEXT).words, text);
+    EXPECT_EQ(state.section(Section::DATA).words, data);
+}
+
+TEST(LiteralPoolTest, FarLoadsFlushWithBranchOver) {
+    // A load is followed by more code than LDR (literal) reaches
+    const int fillerCount = 1 << 18;
+    std::string assembly = "ldr x1, =0x42\n";
+    for (int i{0}; i < fillerCount; i++) {
+        assembly += "mov x3, x4\n";
+    }
+    const AssemblerState state = assembleWithPools(assembly);
+    ASSERT_EQ(state.machineCode.size(), fillerCount + 5);
+
+    size_t branch{1};
+    while (state.machineCode[branch] == FILLER_WORD) {
+        branch++;
+    }
+    // b over the data and spare words, then the value the load reaches
+    const size_t value = (branch + 1) % 2 == 0 ? branch + 1 : branch + 2;
+    EXPECT_EQ(state.machineCode[branch], 0x14000004);
+    EXPECT_EQ(state.machineCode[value], 0x42);
+    EXPECT_EQ(state.machineCode[value + 1], 0);
+    EXPECT_EQ(state.machineCode[0], 0x58000001 | (value << 5));
+}
+
+TEST(LiteralPoolTest, ValueTooLargeForWRegisterThrows) {
+    EXPECT_THROW({ assembleWithPools("ldr w1, =0x100000000"); },
+                 std::runtime_error);
+    EXPECT_NO_THROW({ assembleWithPools("ldr w1, =-0x80000000"); });
+}
+
+TEST(LiteralPoolTest, XValuesAreAligned) {
+    // Word index of the X load: its pool starts four bytes past a multiple
+    // of eight, after W values, and in a section after an odd one
+    const std::vector<std::pair<std::string, size_t>> programs = {
+        {"mov x1, #1\nmov x3, #2\nldr x2, =0x1122334455667788\n.ltorg", 2},
+        {"ldr w1, =5\nldr x2, =0x1122334455667788", 1},
+        {"mov x1, #1\n.data\nldr x2, =0x1122334455667788\nldr w3, =5", 2}};
+    for (const auto &[assembly, load] : programs) {
+        const AssemblerState state = assembleWithPools(assembly);
+        const size_t target = poolLoadTarget(state, load);
+        EXPECT_EQ(target % 8, 0) << assembly;
+        EXPECT_EQ(state.machineCode[target / 4], 0x55667788) << assembly;
+        EXPECT_EQ(state.machineCode[target / 4 + 1], 0x11223344) << assembly;
+    }
+}
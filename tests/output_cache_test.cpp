@@ -0,0 +1,100 @@
+#include "output_cache.h"
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+auto cacheBytes(std::string_view text) -> std::vector<std::byte> {
+    const auto *bytes = reinterpret_cast<const std::byte *>(text.data());
+    return {bytes, bytes + text.size()};
+}
+
+// A fresh directory per test
+auto cacheDirectory(const std::string &name) -> std::filesystem::path {
+    const std::filesystem::path directory =
+        std::filesystem::path(::testing::TempDir()) / ("output_cache_" + name);
+    std::filesystem::remove_all(directory);
+    return directory;
+}
+
+TEST(OutputCacheTest, KeysDependOnInputAndOptions) {
+    const auto input = cacheBytes("add x1, x2, x3");
+    const std::string key = OutputCache::keyOf(input, "assemble");
+    EXPECT_EQ(key.size(), 32);
+    EXPECT_EQ(key, OutputCache::keyOf(input, "assemble"));
+    EXPECT_NE(key, OutputCache::keyOf(input, "from-tokens"));
+    EXPECT_NE(key, OutputCache::keyOf(cacheBytes("add x1, x2, x4"),
+                                      "assemble"));
+    // Every length of tail is hashed
+    std::string text;
+    std::vector<std::string> keys;
+    for (int i{0}; i < 40; i++) {
+        keys.push_back(OutputCache::keyOf(cacheBytes(text), ""));
+        text += 'a';
+    }
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+TEST(OutputCacheTest, StoredOutputIsFound) {
+    const std::filesystem::path directory = cacheDirectory("stored");
+    OutputCache cache(directory);
+    const std::string key = OutputCache::keyOf(cacheBytes("source"), "");
+    EXPECT_FALSE(cache.lookup(key));
+    ASSERT_TRUE(cache.store(key, cacheBytes("output")));
+    const auto output = cache.lookup(key);
+    ASSERT_TRUE(output);
+    EXPECT_TRUE(std::ranges::equal(output->bytes(), cacheBytes("output")));
+
+    EXPECT_EQ(cache.sessionStats().hits, 1);
+    EXPECT_EQ(cache.sessionStats().misses, 1);
+    // Lookups of other processes (here, another object) count too
+    EXPECT_FALSE(OutputCache(directory).lookup("0"));
+    EXPECT_EQ(cache.totalStats().hits, 1);
+    EXPECT_EQ(cache.totalStats().misses, 2);
+    // The counters are updated in place, so their file does not grow
+    const uintmax_t countersSize =
+        std::filesystem::file_size(directory / "counters");
+    for (int i{0}; i < 100; i++) {
+        EXPECT_TRUE(cache.lookup(key));
+    }
+    EXPECT_EQ(std::filesystem::file_size(directory / "counters"),
+              countersSize);
+    EXPECT_EQ(cache.totalStats().hits, 101);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(OutputCacheTest, ConcurrentWritersLeaveOneWholeOutput) {
+    const std::filesystem::path directory = cacheDirectory("concurrent");
+    const std::string key = OutputCache::keyOf(cacheBytes("shared"), "");
+    const std::vector<std::byte> output(1 << 20, std::byte{0x5A});
+
+    std::vector<std::thread> writers;
+    for (int i{0}; i < 8; i++) {
+        writers.emplace_back([&] {
+            OutputCache cache(directory);
+            for (int j{0}; j < 4; j++) {
+                EXPECT_TRUE(cache.store(key, output));
+                const auto stored = cache.lookup(key);
+                ASSERT_TRUE(stored);
+                EXPECT_TRUE(std::ranges::equal(stored->bytes(), output));
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    // Only the output and the counters are left, no temporary files
+    size_t files{0};
+    for ([[maybe_unused]] const auto &entry :
+         std::filesystem::directory_iterator(directory)) {
+        files++;
+    }
+    EXPECT_EQ(files, 2);
+    EXPECT_EQ(OutputCache(directory).totalStats().hits, 32);
+    std::filesystem::remove_all(directory);
+}
@@ -4,17 +4,28 @@
 #include "token.h"
 #include <gtest/gtest.h>
 
-auto getParserOutput(const std::vector<Token> &tokens)
-    -> std::vector<Instruction> {
-    Parser parser;
+auto getParserState(const std::vector<Token> &tokens) -> AssemblerState {
     AssemblerState assemblerState;
-    assemblerState.tokens = std::move(tokens);
-    parser.parse(assemblerState);
-    return assemblerState.instructions;
+    assemblerState.tokens = tokens;
+    Parser::parse(assemblerState);
+    return assemblerState;
+}
+
+// Each instruction as the tokens it covers
+auto getParserOutput(const std::vector<Token> &tokens)
+    -> std::vector<std::vector<Token>> {
+    AssemblerState assemblerState = getParserState(tokens);
+    std::vector<std::vector<Token>> instructions;
+    for (const auto &instruction : assemblerState.instructions) {
+        const auto instructionTokens = assemblerState.tokensOf(instruction);
+        instructions.emplace_back(instructionTokens.begin(),
+                                  instructionTokens.end());
+    }
+    return instructions;
 }
 
-void validateParserOutput(const std::vector<Instruction> &parserOutput,
-                          const std::vector<Instruction> expected) {
+void validateParserOutput(const std::vector<std::vector<Token>> &parserOutput,
+                          const std::vector<std::vector<Token>> expected) {
     ASSERT_EQ(expected.size(), parserOutput.size())
         << "Length of lexer token list and expected token list don't match\n";
 
@@ -37,7 +48,62 @@ TEST(ParserTest, ThreeArgMnemonic) {
     Token token4 = Token::createRegister(reg3);
 
     std::vector<Token> tokens{token1, token2, token3, token4};
-    std::vector<Instruction> expectedInstructions{Instruction{tokens}};
+    std::vector<std::vector<Token>> expectedInstructions{tokens};
 
     validateParserOutput(getParserOutput(tokens), expectedInstructions);
 }
+
+TEST(ParserTest, LabelAddresses) {
+    Token start = Token::createLabel(Label{"start"});
+    Token end = Token::createLabel(Label{"end"});
+    Token newLine = Token::createNewline();
+    std::vector<Token> mov = {Token::createMnemonic(Mnemonic::MOV),
+                              Token::createRegister(Register::X1),
+                              Token::createRegister(Register::X2)};
+
+    std::vector<Token> tokens{start, newLine};
+    tokens.insert(tokens.end(), mov.begin(), mov.end());
+    tokens.insert(tokens.end(), {newLine, newLine, end});
+
+    validateParserOutput(getParserOutput(tokens), {{start}, mov, {end}});
+
+    AssemblerState state = getParserState(tokens);
+    EXPECT_EQ(state.labelToAddress.at("start"),
+              (LabelAddress{Section::TEXT, 0}));
+    EXPECT_EQ(state.labelToAddress.at("end"),
+              (LabelAddress{Section::TEXT, 4}));
+    EXPECT_FALSE(state.instructions[0].format.has_value());
+    EXPECT_EQ(state.instructions[1].format, ArgFormat::REG_REG);
+}
+
+TEST(ParserTest, SectionsHaveTheirOwnLocationCounter) {
+    Token newLine = Token::createNewline();
+    Token mov = Token::createMnemonic(Mnemonic::MOV);
+    Token x1 = Token::createRegister(Register::X1);
+    Token x2 = Token::createRegister(Register::X2);
+    std::vector<Token> tokens{
+        Token::createLabel(Label{"code"}), newLine, mov, x1, x2, newLine,
+        Token::createDirective(Directive::DATA), newLine,
+        Token::createLabel(Label{"table"}), newLine, mov, x1, x2, newLine,
+        Token::createDirective(Directive::TEXT), newLine, mov, x1, x2,
+        newLine, Token::createLabel(Label{"after"})};
+
+    AssemblerState state = getParserState(tokens);
+    EXPECT_EQ(state.labelToAddress.at("table"),
+              (LabelAddress{Section::DATA, 0}));
+    EXPECT_EQ(state.labelToAddress.at("after"),
+              (LabelAddress{Section::TEXT, 8}));
+    // Directives switch sections but are not instructions themselves
+    ASSERT_EQ(state.instructions.size(), 6);
+    EXPECT_EQ(state.instructions[3].section, Section::DATA);
+    EXPECT_EQ(state.section(Section::TEXT).size, 8);
+    EXPECT_EQ(state.section(Section::DATA).size, 4);
+    EXPECT_EQ(state.section(Section::DATA).base, 8);
+    EXPECT_EQ(state.addressOf(state.labelToAddress.at("table")), 8);
+}
+
+TEST(ParserTest, InvalidArguments) {
+    std::vector<Token> tokens{Token::createMnemonic(Mnemonic::MOV),
+                              Token::createRegister(Register::X1)};
+    EXPECT_THROW({ getParserOutput(tokens); }, std::runtime_error);
+}
@@ -0,0 +1,85 @@
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include "peephole.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+auto peepholeState(const std::string &assembly, bool optimize)
+    -> AssemblerState {
+    AssemblerState state;
+    state.optimize = optimize;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state;
+}
+
+auto peepholeCode(const std::string &assembly) -> std::vector<uint32_t> {
+    return peepholeState(assembly, true).machineCode;
+}
+
+auto plainCode(const std::string &assembly) -> std::vector<uint32_t> {
+    return peepholeState(assembly, false).machineCode;
+}
+
+TEST(PeepholeTest, RemovesNoops) {
+    EXPECT_EQ(peepholeCode("mov x1, x1\nadd x2, x2, #0\nadd x3, #0, x3\n"
+                           "sub x4, x4, #0\nlsr x5, x5, #0\n"
+                           "orr x6, x6, x6\nmov x7, x8"),
+              plainCode("mov x7, x8"));
+    // W forms clear the upper half, and other registers or values change
+    // something
+    const std::string kept = "mov w1, w1\nadd w2, w2, #0\nmov x1, x2\n"
+                             "add x2, x3, #0\nadd x2, x2, #1\n"
+                             "orr x6, x6, x7";
+    EXPECT_EQ(peepholeCode(kept), plainCode(kept));
+}
+
+TEST(PeepholeTest, RemovesOverwrittenWrites) {
+    EXPECT_EQ(peepholeCode("mov x1, x2\nmov x1, #3\nmov w1, #4"),
+              plainCode("mov w1, #4"));
+    EXPECT_EQ(peepholeCode("add x1, x2, x3\nmov x5, x5\nsub x1, x4, #8"),
+              plainCode("sub x1, x4, #8"));
+    // Read by the second, written to other registers, or a branch target
+    const std::string kept = "mov x1, #3\nadd x1, x1, x2\nmov x3, #1\n"
+                             "mov x4, #1\nmov x5, #1\nnext:\nmov x5, #2\n"
+                             "mov x6, #1\nldr x6, [x7]\nmov x8, #1\n"
+                             "cmp x8, #0\nmov x8, #2";
+    EXPECT_EQ(peepholeCode(kept), plainCode(kept));
+}
+
+TEST(PeepholeTest, LabelsAndPoolsMoveBack) {
+    const AssemblerState optimized = peepholeState(
+        "start:\nmov x1, x1\nldr x2, =0x123456789\ncbz x2, done\n"
+        "mov x3, #1\nmov x3, #2\nadd x4, x4, #0\nb start\ndone:\n.ltorg\n"
+        ".data\nmov x7, x7\ntable:\nmov x7, #1\n.text\n"
+        "mov x9, #(done - start)\nldr x8, =7\nb done\nfinish:",
+        true);
+    const AssemblerState expected = peepholeState(
+        "start:\nldr x2, =0x123456789\ncbz x2, done\nmov x3, #2\nb start\n"
+        "done:\n.ltorg\n.data\ntable:\nmov x7, #1\n.text\n"
+        "mov x9, #(done - start)\nldr x8, =7\nb done\nfinish:",
+        false);
+    EXPECT_EQ(optimized.machineCode, expected.machineCode);
+    for (const char *label : {"start", "done", "table", "finish"}) {
+        EXPECT_EQ(optimized.labelToAddress.at(label),
+                  expected.labelToAddress.at(label))
+            << label;
+    }
+    EXPECT_EQ(optimized.section(Section::DATA).base,
+              expected.section(Section::DATA).base);
+}
+
+TEST(PeepholeTest, RemovedInstructionsAreChecked) {
+    EXPECT_THROW(
+        { peepholeState("mov x1, #70000\nmov x1, #2", true); },
+        std::runtime_error);
+    EXPECT_THROW(
+        { peepholeState("mov x1, w1\nmov x1, #2", true); },
+        std::runtime_error);
+}
@@ -0,0 +1,198 @@
+#include "assembler_state.h"
+#include "debug_line.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "parser.h"
+#include "source_map.h"
+#include "token_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Position of the line holding the n-th instruction that has a format
+auto locationOfInstruction(const AssemblerState &state, size_t n)
+    -> SourceLocation {
+    for (const Instruction &instruction : state.instructions) {
+        if (instruction.format && n-- == 0) {
+            return state.sourceMap.locate(instruction.firstToken);
+        }
+    }
+    throw std::out_of_range("No such instruction");
+}
+
+auto assemblyErrorOf(const std::string &assembly, std::string_view file)
+    -> std::string {
+    AssemblerState state;
+    try {
+        Lexer::tokenize(assembly, state, file);
+        Parser::parse(state);
+        Encoder::encode(state);
+    } catch (const std::runtime_error &e) {
+        return e.what();
+    }
+    return "";
+}
+
+struct LineRow {
+    uint64_t address;
+    int line;
+    int column;
+};
+
+// Decodes the rows of a .debug_line section written by DebugLine
+auto decodeLineRows(const std::vector<std::byte> &section)
+    -> std::vector<LineRow> {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(section.data());
+    size_t offset = 0;
+    auto uleb = [&] {
+        uint64_t value = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            const uint8_t byte = bytes[offset++];
+            value |= static_cast<uint64_t>(byte & 0x7FU) << shift;
+            if ((byte & 0x80U) == 0) {
+                return value;
+            }
+        }
+    };
+    auto sleb = [&] {
+        int64_t value = 0;
+        unsigned shift = 0;
+        uint8_t byte = 0;
+        do {
+            byte = bytes[offset++];
+            value |= static_cast<int64_t>(byte & 0x7FU) << shift;
+            shift += 7;
+        } while ((byte & 0x80U) != 0);
+        if (shift < 64 && (byte & 0x40U) != 0) {
+            value |= -(int64_t{1} << shift);
+        }
+        return value;
+    };
+
+    uint32_t unitLength = 0;
+    uint32_t headerLength = 0;
+    std::memcpy(&unitLength, bytes, 4);
+    std::memcpy(&headerLength, bytes + 6, 4);
+    EXPECT_EQ(unitLength + 4, section.size());
+    const uint8_t opcodeBase = bytes[10 + 5];
+    offset = 10 + headerLength;
+
+    std::vector<LineRow> rows;
+    LineRow row{0, 1, 0};
+    while (offset < section.size()) {
+        const uint8_t opcode = bytes[offset++];
+        if (opcode >= opcodeBase) {
+            const int adjusted = opcode - opcodeBase;
+            row.address += static_cast<uint64_t>(adjusted / 14) * 4;
+            row.line += -5 + adjusted % 14;
+            rows.push_back(row);
+        } else if (opcode == 0) {
+            uleb(); // Length
+            if (bytes[offset++] == 2) {
+                std::memcpy(&row.address, bytes + offset, 8);
+                offset += 8;
+            } else {
+                row = LineRow{0, 1, 0}; // End of sequence
+            }
+        } else if (opcode == 1) {
+            rows.push_back(row);
+        } else if (opcode == 2) {
+            row.address += uleb() * 4;
+        } else if (opcode == 3) {
+            row.line += static_cast<int>(sleb());
+        } else if (opcode == 5) {
+            row.column = static_cast<int>(uleb());
+        } else {
+            uleb(); // Set file
+        }
+    }
+    return rows;
+}
+
+TEST(SourceMapTest, LocatesLinesAndColumns) {
+    AssemblerState state;
+    Lexer::tokenize("start:\n\n  add x1, x2, x3 // sum\n// note\n"
+                    "\tsub x4, x5, #1\nmov x6, x7",
+                    state);
+    Parser::parse(state);
+
+    const SourceLocation add = locationOfInstruction(state, 0);
+    EXPECT_EQ(add.line, 3);
+    EXPECT_EQ(add.column, 3);
+    const SourceLocation sub = locationOfInstruction(state, 1);
+    EXPECT_EQ(sub.line, 5);
+    EXPECT_EQ(sub.column, 2);
+    const SourceLocation mov = locationOfInstruction(state, 2);
+    EXPECT_EQ(mov.line, 6);
+    EXPECT_EQ(mov.column, 1);
+}
+
+TEST(SourceMapTest, TypicalLinesTakeOneByte) {
+    std::string assembly;
+    for (int i{0}; i < 1000; i++) {
+        assembly += "add x1, x2, x3\n";
+    }
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+
+    EXPECT_EQ(state.sourceMap.size(), 1000);
+    EXPECT_LE(state.sourceMap.bytes().size(), 1000 + 8);
+    // Lookups agree with a walk in order
+    SourceMap::Cursor cursor(state.sourceMap);
+    for (size_t token{0}; token < state.tokens.size(); token += 7) {
+        EXPECT_EQ(cursor.locate(token).line,
+                  state.sourceMap.locate(token).line);
+    }
+}
+
+TEST(SourceMapTest, ErrorsNameTheirPosition) {
+    // Found by the parser and by the encoder
+    const std::string duplicate = "start:\nadd x1, x2, x3\n start:\n";
+    EXPECT_NE(assemblyErrorOf(duplicate, "").find("line 3, column 2"),
+              std::string::npos);
+    const std::string undefined = "add x1, x2, x3\n\n  b nowhere\n";
+    EXPECT_NE(assemblyErrorOf(undefined, "").find("line 3, column 3"),
+              std::string::npos);
+    EXPECT_NE(assemblyErrorOf(undefined, "prog.s").find("prog.s:3:3"),
+              std::string::npos);
+}
+
+TEST(SourceMapTest, TokenCacheKeepsLocations) {
+    AssemblerState lexed;
+    Lexer::tokenize("start:\n\n  add x1, x2, x3\n    b start\n", lexed,
+                    "loop.s");
+    AssemblerState loaded;
+    TokenCache::load(TokenCache::serialize(lexed), loaded);
+    Parser::parse(loaded);
+
+    const SourceLocation branch = locationOfInstruction(loaded, 1);
+    EXPECT_EQ(branch.line, 4);
+    EXPECT_EQ(branch.column, 5);
+    EXPECT_EQ(loaded.sourceMap.fileName(branch.file), "loop.s");
+}
+
+TEST(SourceMapTest, DebugLineHasARowPerInstruction) {
+    AssemblerState state;
+    Lexer::tokenize("mov x1, #1\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n"
+                    "  add x1, x1, #2\nldr x2, =0x123456789\nb done\n"
+                    ".ltorg\ndone:\n mov x3, x4",
+                    state);
+    Parser::parse(state);
+
+    const std::vector<LineRow> rows =
+        decodeLineRows(DebugLine::emit(state));
+    // The pool after b done is data, so the last mov comes three words
+    // later (the value and its spare word)
+    const std::vector<LineRow> expected = {
+        {0, 1, 1}, {4, 21, 3}, {8, 22, 1}, {12, 23, 1}, {28, 26, 2}};
+    ASSERT_EQ(rows.size(), expected.size());
+    for (size_t i{0}; i < rows.size(); i++) {
+        EXPECT_EQ(rows[i].address, expected[i].address) << i;
+        EXPECT_EQ(rows[i].line, expected[i].line) << i;
+        EXPECT_EQ(rows[i].column, expected[i].column) << i;
+    }
+}
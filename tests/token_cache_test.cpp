@@ -0,0 +1,98 @@
+#include "assembler_state.h"
+#include "encoder.h"
+#include "lexer.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include "token_cache.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+auto cachedProgram() -> std::string {
+    return ".equ ENTRIES, 4\nstart:\nadd x1, x2, #ENTRIES * 8\n"
+           "ldr x3, =0x123456789\nmov x4, #(end - start) / 4\n"
+           "cbz x5, start\n.data\ntable:\nldr w6, [x7, #4]\n.text\n"
+           "b table\nend:";
+}
+
+auto encodeFromSource(const std::string &assembly) -> std::vector<uint32_t> {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    return state.machineCode;
+}
+
+auto cacheOf(const std::string &assembly) -> std::vector<std::byte> {
+    AssemblerState state;
+    Lexer::tokenize(assembly, state);
+    return TokenCache::serialize(state);
+}
+
+TEST(TokenCacheTest, CacheAssemblesLikeSource) {
+    AssemblerState state;
+    TokenCache::load(cacheOf(cachedProgram()), state);
+    AssemblerState lexed;
+    Lexer::tokenize(cachedProgram(), lexed);
+    EXPECT_EQ(state.tokens, lexed.tokens);
+
+    Parser::parse(state);
+    Encoder::encode(state);
+    EXPECT_EQ(state.machineCode, encodeFromSource(cachedProgram()));
+}
+
+TEST(TokenCacheTest, LabelNamesAreStoredOnce) {
+    const size_t once = cacheOf("b a_long_label_name").size();
+    const size_t twice =
+        cacheOf("b a_long_label_name\nb a_long_label_name").size();
+    // Only the second line's newline, mnemonic and label index, and its
+    // one byte source map entry
+    EXPECT_EQ(twice - once, 1 + 2 + 5 + 1);
+}
+
+TEST(TokenCacheTest, LoadsFromMappedFile) {
+    const std::string path = ::testing::TempDir() + "token_cache_test.tok";
+    {
+        const std::vector<std::byte> cache = cacheOf(cachedProgram());
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(cache.data()),
+                   static_cast<std::streamsize>(cache.size()));
+    }
+    AssemblerState state;
+    TokenCache::load(MappedFile(path).bytes(), state);
+    Parser::parse(state);
+    Encoder::encode(state);
+    EXPECT_EQ(state.machineCode, encodeFromSource(cachedProgram()));
+    std::remove(path.c_str());
+}
+
+TEST(TokenCacheTest, BadCachesThrow) {
+    AssemblerState state;
+    std::vector<std::byte> cache = cacheOf(cachedProgram());
+    EXPECT_THROW({ TokenCache::load(std::span(cache).first(30), state); },
+                 std::runtime_error);
+    std::vector<std::byte> extended = cache;
+    extended.push_back(std::byte{0});
+    EXPECT_THROW({ TokenCache::load(extended, state); }, std::runtime_error);
+    // A token count the token bytes cannot hold, set in a one-token cache
+    std::vector<std::byte> counted = cacheOf("start:");
+    std::fill(counted.begin() + 16, counted.begin() + 20, std::byte{0xFF});
+    EXPECT_THROW({ TokenCache::load(counted, state); }, std::runtime_error);
+    // The expression flag on a token that is not an immediate. Tokens
+    // follow the magic and the header's eleven counts.
+    std::vector<std::byte> flagged = cacheOf("b start");
+    const size_t tokens = 8 + sizeof(uint32_t) * 11;
+    ASSERT_EQ(flagged[tokens], static_cast<std::byte>(TokenType::Mnemonic));
+    flagged[tokens] |= std::byte{0x80};
+    EXPECT_THROW({ TokenCache::load(flagged, state); }, std::runtime_error);
+    cache[8] = std::byte{0xFF}; // The version
+    EXPECT_THROW({ TokenCache::load(cache, state); }, std::runtime_error);
+    cache[0] = std::byte{'X'}; // The magic
+    EXPECT_THROW({ TokenCache::load(cache, state); }, std::runtime_error);
+}
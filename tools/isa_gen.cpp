@@ -0,0 +1,670 @@
+// Build-time generator for the instruction tables (see isa/aarch64.isa)
+// Usage: isa_gen <spec file> <output directory>
+//
+// Writes four headers:
+//    isa_mnemonics.h - Mnemonic enum, perfect hash name lookup, names
+//    isa_formats.h   - ArgFormat enum and constexpr validation tables
+//    isa_encodings.h - instructionEncodings table and switch-based encoders
+//    isa_peepholes.h - noopPatterns table and switch-based pattern lookups
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct FormatSpec {
+    std::string name;
+    std::vector<std::string> tokens; // reg, imm, label, literal, [ or ]
+};
+
+struct MnemonicSpec {
+    std::string name;
+    std::vector<std::string> spellings;
+};
+
+struct FieldSpec {
+    std::string kind;
+    uint32_t lsb;
+    uint32_t width;
+};
+
+struct EncodingSpec {
+    std::string mnemonic;
+    std::string format;
+    uint32_t base64;
+    uint32_t base32;
+    std::vector<std::string> fields;
+};
+
+// An instruction that does nothing when its arguments match
+struct NoopSpec {
+    std::string mnemonic;
+    std::string format;
+    std::vector<std::string> arguments; // d, 0 or _
+};
+
+// An instruction that only writes its first argument
+struct OverwriteSpec {
+    std::string mnemonic;
+    std::string format;
+};
+
+struct IsaSpec {
+    std::vector<FormatSpec> formats;
+    std::vector<MnemonicSpec> mnemonics;
+    std::map<std::string, FieldSpec> fields;
+    std::vector<EncodingSpec> encodings;
+    std::vector<NoopSpec> noops;
+    std::vector<OverwriteSpec> overwrites;
+};
+
+const std::map<std::string, std::string> fieldKinds = {
+    {"reg", "REG"},       {"xreg", "XREG"},     {"uimm", "UIMM"},
+    {"shift", "SHIFT"},   {"scaled", "SCALED"}, {"pcrel", "PCREL"}};
+
+const std::map<std::string, std::string> formatTokenTypes = {
+    {"reg", "TokenType::Register"},
+    {"imm", "TokenType::Immediate"},
+    {"label", "TokenType::Label"},
+    {"literal", "TokenType::Literal"},
+    {"[", "TokenType::LeftBracket"},
+    {"]", "TokenType::RightBracket"}};
+
+// Argument tokens each field kind can be filled from
+const std::map<std::string, std::set<std::string>> fieldKindTokens = {
+    {"reg", {"reg"}},     {"xreg", {"reg"}},
+    {"uimm", {"imm"}},    {"shift", {"imm"}},
+    {"scaled", {"imm"}},  {"pcrel", {"label", "literal"}}};
+
+// Noop pattern arguments, and the argument tokens each can match
+const std::map<std::string, std::pair<std::string, std::string>>
+    noopArguments = {{"d", {"DESTINATION", "reg"}},
+                     {"0", {"ZERO", "imm"}},
+                     {"_", {"ANY", ""}}};
+
+auto fieldMask(const FieldSpec &field) -> uint32_t {
+    return static_cast<uint32_t>(((1ULL << field.width) - 1ULL) << field.lsb);
+}
+
+auto argumentTokens(const FormatSpec &format) -> std::vector<std::string> {
+    std::vector<std::string> arguments;
+    std::copy_if(format.tokens.begin(), format.tokens.end(),
+                 std::back_inserter(arguments), [](const std::string &token) {
+                     return token != "[" && token != "]";
+                 });
+    return arguments;
+}
+
+auto findFormat(const IsaSpec &spec, const std::string &name)
+    -> const FormatSpec * {
+    for (const auto &format : spec.formats) {
+        if (format.name == name) {
+            return &format;
+        }
+    }
+    return nullptr;
+}
+
+auto hasMnemonic(const IsaSpec &spec, const std::string &name) -> bool {
+    return std::any_of(
+        spec.mnemonics.begin(), spec.mnemonics.end(),
+        [&](const MnemonicSpec &mnemonic) { return mnemonic.name == name; });
+}
+
+auto parseNumber(const std::string &text) -> uint32_t {
+    size_t used{0};
+    const unsigned long value = std::stoul(text, &used, 0);
+    if (used != text.size() || value > UINT32_MAX) {
+        throw std::runtime_error("Invalid number: " + text);
+    }
+    return static_cast<uint32_t>(value);
+}
+
+void checkEncoding(const IsaSpec &spec, const EncodingSpec &encoding) {
+    if (!hasMnemonic(spec, encoding.mnemonic)) {
+        throw std::runtime_error("Unknown mnemonic " + encoding.mnemonic);
+    }
+    const FormatSpec *format = findFormat(spec, encoding.format);
+    if (format == nullptr) {
+        throw std::runtime_error("Unknown format " + encoding.format);
+    }
+    const std::vector<std::string> arguments = argumentTokens(*format);
+    if (arguments.size() != encoding.fields.size()) {
+        throw std::runtime_error("Format " + encoding.format + " takes " +
+                                 std::to_string(arguments.size()) +
+                                 " fields");
+    }
+
+    uint32_t usedBits{0};
+    for (size_t i{0}; i < encoding.fields.size(); i++) {
+        const auto field = spec.fields.find(encoding.fields[i]);
+        if (field == spec.fields.end()) {
+            throw std::runtime_error("Unknown field " + encoding.fields[i]);
+        }
+        if (!fieldKindTokens.at(field->second.kind).contains(arguments[i])) {
+            throw std::runtime_error("Field " + encoding.fields[i] +
+                                     " cannot hold a " + arguments[i] +
+                                     " argument");
+        }
+        const uint32_t mask = fieldMask(field->second);
+        if ((usedBits & mask) != 0 ||
+            ((encoding.base64 | encoding.base32) & mask) != 0) {
+            throw std::runtime_error("Field " + encoding.fields[i] +
+                                     " overlaps other bits");
+        }
+        usedBits |= mask;
+    }
+}
+
+void checkNoop(const IsaSpec &spec, const NoopSpec &noop) {
+    const std::vector<std::string> arguments =
+        argumentTokens(*findFormat(spec, noop.format));
+    if (arguments.size() != noop.arguments.size()) {
+        throw std::runtime_error("Format " + noop.format + " takes " +
+                                 std::to_string(arguments.size()) +
+                                 " arguments");
+    }
+    if (noop.arguments[0] != "d") {
+        throw std::runtime_error("The first argument of a noop must be d");
+    }
+    for (size_t i{0}; i < arguments.size(); i++) {
+        const auto argument = noopArguments.find(noop.arguments[i]);
+        if (argument == noopArguments.end()) {
+            throw std::runtime_error("Unknown noop argument " +
+                                     noop.arguments[i]);
+        }
+        if (!argument->second.second.empty() &&
+            argument->second.second != arguments[i]) {
+            throw std::runtime_error("Noop argument " + noop.arguments[i] +
+                                     " cannot match a " + arguments[i] +
+                                     " argument");
+        }
+    }
+}
+
+void checkOverwrite(const IsaSpec &spec, const OverwriteSpec &overwrite) {
+    const FormatSpec *format = findFormat(spec, overwrite.format);
+    if (format->tokens[0] != "reg" ||
+        !std::all_of(format->tokens.begin(), format->tokens.end(),
+                     [](const std::string &token) {
+                         return token == "reg" || token == "imm";
+                     })) {
+        throw std::runtime_error("An overwrite must take a register, then "
+                                 "registers and immediates");
+    }
+}
+
+auto parseSpec(const std::string &path) -> IsaSpec {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    IsaSpec spec;
+    std::set<std::pair<std::string, std::string>> encoded;
+    std::set<std::pair<std::string, std::string>> noops;
+    std::set<std::pair<std::string, std::string>> overwrites;
+    // Peephole patterns only apply to instructions that can be encoded
+    const auto checkEncoded = [&encoded](const std::string &mnemonic,
+                                         const std::string &format) {
+        if (!encoded.contains({mnemonic, format})) {
+            throw std::runtime_error("No encoding for " + mnemonic + " " +
+                                     format);
+        }
+    };
+    std::string line;
+    int lineNum = 0;
+    while (std::getline(file, line)) {
+        lineNum++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::vector<std::string> parts;
+        for (std::string word; words >> word;) {
+            parts.push_back(word);
+        }
+        if (parts.empty()) {
+            continue;
+        }
+
+        try {
+            const std::string &kind = parts[0];
+            if (kind == "format" && parts.size() >= 2) {
+                FormatSpec format{parts[1], {parts.begin() + 2, parts.end()}};
+                for (const auto &token : format.tokens) {
+                    if (formatTokenTypes.find(token) ==
+                        formatTokenTypes.end()) {
+                        throw std::runtime_error("Unknown format token " +
+                                                 token);
+                    }
+                }
+                spec.formats.push_back(format);
+            } else if (kind == "mnemonic" && parts.size() >= 3) {
+                spec.mnemonics.push_back(
+                    {parts[1], {parts.begin() + 2, parts.end()}});
+            } else if (kind == "field" && parts.size() == 5) {
+                if (fieldKinds.find(parts[2]) == fieldKinds.end()) {
+                    throw std::runtime_error("Unknown field kind " + parts[2]);
+                }
+                const FieldSpec field{parts[2], parseNumber(parts[3]),
+                                      parseNumber(parts[4])};
+                if (field.width == 0 || field.lsb + field.width > 32) {
+                    throw std::runtime_error("Field does not fit in a word");
+                }
+                spec.fields[parts[1]] = field;
+            } else if (kind == "encode" && parts.size() >= 5) {
+                EncodingSpec encoding{parts[1],
+                                      parts[2],
+                                      parseNumber(parts[3]),
+                                      parseNumber(parts[4]),
+                                      {parts.begin() + 5, parts.end()}};
+                checkEncoding(spec, encoding);
+                if (!encoded.insert({encoding.mnemonic, encoding.format})
+                         .second) {
+                    throw std::runtime_error("Duplicate encoding for " +
+                                             encoding.mnemonic + " " +
+                                             encoding.format);
+                }
+                spec.encodings.push_back(encoding);
+            } else if (kind == "noop" && parts.size() >= 4) {
+                NoopSpec noop{parts[1], parts[2],
+                              {parts.begin() + 3, parts.end()}};
+                checkEncoded(noop.mnemonic, noop.format);
+                checkNoop(spec, noop);
+                if (!noops.insert({noop.mnemonic, noop.format}).second) {
+                    throw std::runtime_error("Duplicate noop for " +
+                                             noop.mnemonic + " " +
+                                             noop.format);
+                }
+                spec.noops.push_back(noop);
+            } else if (kind == "overwrite" && parts.size() == 3) {
+                OverwriteSpec overwrite{parts[1], parts[2]};
+                checkEncoded(overwrite.mnemonic, overwrite.format);
+                checkOverwrite(spec, overwrite);
+                if (!overwrites.insert({overwrite.mnemonic, overwrite.format})
+                         .second) {
+                    throw std::runtime_error("Duplicate overwrite for " +
+                                             overwrite.mnemonic + " " +
+                                             overwrite.format);
+                }
+                spec.overwrites.push_back(overwrite);
+            } else {
+                throw std::runtime_error("Malformed line");
+            }
+        } catch (const std::exception &e) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNum) +
+                                     ": " + e.what());
+        }
+    }
+    return spec;
+}
+
+auto hex(uint32_t value) -> std::string {
+    std::array<char, 16> buffer{};
+    std::snprintf(buffer.data(), buffer.size(), "0x%08XU", value);
+    return buffer.data();
+}
+
+// Must match hashMnemonicName in the generated header
+auto hashName(std::string_view name, uint32_t seed) -> uint32_t {
+    uint32_t hash = 2166136261U ^ seed;
+    for (const char byte : name) {
+        hash ^= static_cast<uint8_t>(byte);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+struct PerfectHash {
+    uint32_t seed;
+    uint32_t shift; // Slot is the top bits of the hash
+    size_t size;
+    std::vector<std::pair<std::string, std::string>> slots; // spelling, name
+};
+
+// Finds a seed under which every spelling lands in its own slot
+auto buildPerfectHash(const IsaSpec &spec) -> PerfectHash {
+    std::vector<std::pair<std::string, std::string>> names;
+    for (const auto &mnemonic : spec.mnemonics) {
+        for (const auto &spelling : mnemonic.spellings) {
+            names.emplace_back(spelling, mnemonic.name);
+        }
+    }
+
+    uint32_t bits{1};
+    while ((1U << bits) < names.size() * 2) {
+        bits++;
+    }
+    for (;; bits++) {
+        const size_t size = 1U << bits;
+        const uint32_t shift = 32 - bits;
+        for (uint32_t seed{0}; seed < 1'000'000; seed++) {
+            std::vector<std::pair<std::string, std::string>> slots(size);
+            bool collision = false;
+            for (const auto &name : names) {
+                auto &slot = slots[hashName(name.first, seed) >> shift];
+                if (!slot.first.empty()) {
+                    collision = true;
+                    break;
+                }
+                slot = name;
+            }
+            if (!collision) {
+                return {seed, shift, size, slots};
+            }
+        }
+    }
+}
+
+const std::string_view HEADER_COMMENT =
+    "// Generated by tools/isa_gen.cpp from isa/aarch64.isa. Do not edit.\n";
+
+auto generateMnemonics(const IsaSpec &spec) -> std::string {
+    std::ostringstream out;
+    const PerfectHash hash = buildPerfectHash(spec);
+
+    out << HEADER_COMMENT << "#pragma once\n\n"
+        << "#include <array>\n#include <cstddef>\n#include <cstdint>\n"
+        << "#include <optional>\n#include <string_view>\n\n";
+
+    out << "enum class Mnemonic {\n";
+    for (const auto &mnemonic : spec.mnemonics) {
+        out << "    " << mnemonic.name << ",\n";
+    }
+    out << "};\n\n";
+    out << "inline constexpr size_t MNEMONIC_COUNT = " << spec.mnemonics.size()
+        << ";\n\n";
+
+    out << "// FNV-1a, seeded so that every spelling gets its own slot\n"
+        << "constexpr auto hashMnemonicName(std::string_view name) -> "
+           "uint32_t {\n"
+        << "    uint32_t hash = 2166136261U ^ " << hash.seed << "U;\n"
+        << "    for (const char byte : name) {\n"
+        << "        hash ^= static_cast<uint8_t>(byte);\n"
+        << "        hash *= 16777619U;\n"
+        << "    }\n"
+        << "    return hash;\n"
+        << "}\n\n";
+
+    out << "struct MnemonicName {\n"
+        << "    std::string_view name;\n"
+        << "    Mnemonic mnemonic;\n"
+        << "};\n\n";
+    out << "inline constexpr std::array<MnemonicName, " << hash.size
+        << "> mnemonicNames = {{\n";
+    for (const auto &[spelling, name] : hash.slots) {
+        out << "    {\"" << spelling << "\", Mnemonic::"
+            << (name.empty() ? spec.mnemonics[0].name : name) << "},\n";
+    }
+    out << "}};\n\n";
+
+    out << "constexpr auto lookupMnemonic(std::string_view name)\n"
+        << "    -> std::optional<Mnemonic> {\n"
+        << "    const MnemonicName &entry =\n"
+        << "        mnemonicNames[hashMnemonicName(name) >> " << hash.shift
+        << "U];\n"
+        << "    if (entry.name.empty() || entry.name != name) {\n"
+        << "        return std::nullopt;\n"
+        << "    }\n"
+        << "    return entry.mnemonic;\n"
+        << "}\n\n";
+
+    out << "constexpr auto mnemonicToString(Mnemonic mnemonic) -> "
+           "std::string_view {\n"
+        << "    switch (mnemonic) {\n";
+    for (const auto &mnemonic : spec.mnemonics) {
+        out << "    case Mnemonic::" << mnemonic.name << ":\n"
+            << "        return \"" << mnemonic.spellings[0] << "\";\n";
+    }
+    out << "    }\n    return \"\";\n}\n";
+    return out.str();
+}
+
+auto generateFormats(const IsaSpec &spec) -> std::string {
+    std::ostringstream out;
+    out << HEADER_COMMENT << "// Included by argument_validation.h\n"
+        << "#pragma once\n\n";
+
+    out << "enum class ArgFormat {\n";
+    for (const auto &format : spec.formats) {
+        out << "    " << format.name << ",\n";
+    }
+    out << "};\n\n";
+
+    out << "namespace isa_tables {\n";
+    for (const auto &format : spec.formats) {
+        out << "inline constexpr std::array<TokenType, "
+            << format.tokens.size() << "> " << format.name << "_RULE = {";
+        for (size_t i{0}; i < format.tokens.size(); i++) {
+            out << (i == 0 ? "" : ", ")
+                << formatTokenTypes.at(format.tokens[i]);
+        }
+        out << "};\n";
+    }
+    for (const auto &mnemonic : spec.mnemonics) {
+        std::vector<std::string> formats;
+        for (const auto &encoding : spec.encodings) {
+            if (encoding.mnemonic == mnemonic.name) {
+                formats.push_back(encoding.format);
+            }
+        }
+        out << "inline constexpr std::array<ArgFormat, " << formats.size()
+            << "> " << mnemonic.name << "_FORMATS = {";
+        for (size_t i{0}; i < formats.size(); i++) {
+            out << (i == 0 ? "" : ", ") << "ArgFormat::" << formats[i];
+        }
+        out << "};\n";
+    }
+    out << "} // namespace isa_tables\n\n";
+
+    out << "// Tokens the arguments of an instruction in this format must be\n"
+        << "constexpr auto validationRule(ArgFormat format) -> ValidationRule "
+           "{\n"
+        << "    switch (format) {\n";
+    for (const auto &format : spec.formats) {
+        out << "    case ArgFormat::" << format.name << ":\n"
+            << "        return isa_tables::" << format.name << "_RULE;\n";
+    }
+    out << "    }\n    return {};\n}\n\n";
+
+    out << "// Argument formats a mnemonic accepts (empty if it cannot be "
+           "encoded)\n"
+        << "constexpr auto mnemonicFormats(Mnemonic mnemonic)\n"
+        << "    -> std::span<const ArgFormat> {\n"
+        << "    switch (mnemonic) {\n";
+    for (const auto &mnemonic : spec.mnemonics) {
+        out << "    case Mnemonic::" << mnemonic.name << ":\n"
+            << "        return isa_tables::" << mnemonic.name
+            << "_FORMATS;\n";
+    }
+    out << "    }\n    return {};\n}\n";
+    return out.str();
+}
+
+auto generateEncodings(const IsaSpec &spec) -> std::string {
+    std::ostringstream out;
+    out << HEADER_COMMENT << "// Included by encoding.h\n"
+        << "#pragma once\n\n";
+
+    out << "inline constexpr std::array<InstructionEncoding, "
+        << spec.encodings.size() << "> instructionEncodings = {{\n";
+    for (const auto &encoding : spec.encodings) {
+        out << "    {Mnemonic::" << encoding.mnemonic << ", ArgFormat::"
+            << encoding.format << ", " << hex(encoding.base64) << ", "
+            << hex(encoding.base32) << ",\n     {{";
+        for (size_t i{0}; i < encoding.fields.size(); i++) {
+            const FieldSpec &field = spec.fields.at(encoding.fields[i]);
+            out << (i == 0 ? "" : ", ") << "{FieldKind::"
+                << fieldKinds.at(field.kind) << ", " << field.lsb << ", "
+                << field.width << "}";
+        }
+        out << "}},\n     " << encoding.fields.size() << "},\n";
+    }
+    out << "}};\n\n";
+
+    out << "constexpr auto findEncoding(Mnemonic mnemonic, ArgFormat format)\n"
+        << "    -> const InstructionEncoding * {\n"
+        << "    switch (mnemonic) {\n";
+    for (const auto &mnemonic : spec.mnemonics) {
+        out << "    case Mnemonic::" << mnemonic.name << ":\n"
+            << "        switch (format) {\n";
+        for (size_t i{0}; i < spec.encodings.size(); i++) {
+            if (spec.encodings[i].mnemonic == mnemonic.name) {
+                out << "        case ArgFormat::" << spec.encodings[i].format
+                    << ":\n"
+                    << "            return &instructionEncodings[" << i
+                    << "];\n";
+            }
+        }
+        out << "        default:\n"
+            << "            return nullptr;\n"
+            << "        }\n";
+    }
+    out << "    }\n    return nullptr;\n}\n\n";
+
+    out << "// Builds the word for instructionEncodings[index] from field "
+           "values that\n"
+        << "// have already been checked and scaled\n"
+        << "constexpr auto encodeFields(size_t index, bool is32Bit,\n"
+        << "                            const std::array<uint32_t, 3> "
+           "&operands)\n"
+        << "    -> uint32_t {\n"
+        << "    switch (index) {\n";
+    for (size_t i{0}; i < spec.encodings.size(); i++) {
+        const EncodingSpec &encoding = spec.encodings[i];
+        out << "    case " << i << ": // " << encoding.mnemonic << " "
+            << encoding.format << "\n"
+            << "        return (is32Bit ? " << hex(encoding.base32) << " : "
+            << hex(encoding.base64) << ")";
+        for (size_t field{0}; field < encoding.fields.size(); field++) {
+            const uint32_t lsb = spec.fields.at(encoding.fields[field]).lsb;
+            out << " |\n               (operands[" << field << "] << " << lsb
+                << "U)";
+        }
+        out << ";\n";
+    }
+    out << "    default:\n        return 0;\n    }\n}\n";
+    return out.str();
+}
+
+auto generatePeepholes(const IsaSpec &spec) -> std::string {
+    std::ostringstream out;
+    out << HEADER_COMMENT << "// Included by peephole.h\n"
+        << "#pragma once\n\n";
+
+    out << "inline constexpr std::array<NoopPattern, " << spec.noops.size()
+        << "> noopPatterns = {{\n";
+    for (const auto &noop : spec.noops) {
+        out << "    {Mnemonic::" << noop.mnemonic << ", ArgFormat::"
+            << noop.format << ",\n     {{";
+        for (size_t i{0}; i < noop.arguments.size(); i++) {
+            out << (i == 0 ? "" : ", ") << "PatternArgument::"
+                << noopArguments.at(noop.arguments[i]).first;
+        }
+        out << "}},\n     " << noop.arguments.size() << "},\n";
+    }
+    out << "}};\n\n";
+
+    out << "constexpr auto findNoopPattern(Mnemonic mnemonic, ArgFormat "
+           "format)\n"
+        << "    -> const NoopPattern * {\n"
+        << "    switch (mnemonic) {\n";
+    for (const auto &mnemonic : spec.mnemonics) {
+        bool any = false;
+        for (size_t i{0}; i < spec.noops.size(); i++) {
+            if (spec.noops[i].mnemonic != mnemonic.name) {
+                continue;
+            }
+            if (!any) {
+                out << "    case Mnemonic::" << mnemonic.name << ":\n"
+                    << "        switch (format) {\n";
+                any = true;
+            }
+            out << "        case ArgFormat::" << spec.noops[i].format << ":\n"
+                << "            return &noopPatterns[" << i << "];\n";
+        }
+        if (any) {
+            out << "        default:\n"
+                << "            return nullptr;\n"
+                << "        }\n";
+        }
+    }
+    out << "    default:\n        return nullptr;\n    }\n}\n\n";
+
+    out << "constexpr auto isOverwrite(Mnemonic mnemonic, ArgFormat format) "
+           "-> bool {\n"
+        << "    switch (mnemonic) {\n";
+    for (const auto &mnemonic : spec.mnemonics) {
+        std::vector<std::string> formats;
+        for (const auto &overwrite : spec.overwrites) {
+            if (overwrite.mnemonic == mnemonic.name) {
+                formats.push_back(overwrite.format);
+            }
+        }
+        if (formats.empty()) {
+            continue;
+        }
+        out << "    case Mnemonic::" << mnemonic.name << ":\n"
+            << "        return ";
+        for (size_t i{0}; i < formats.size(); i++) {
+            out << (i == 0 ? "" : " ||\n               ")
+                << "format == ArgFormat::" << formats[i];
+        }
+        out << ";\n";
+    }
+    out << "    default:\n        return false;\n    }\n}\n";
+    return out.str();
+}
+
+// Leaves the file untouched when nothing changed so dependents don't rebuild
+void writeIfChanged(const std::filesystem::path &path,
+                    const std::string &contents) {
+    std::ifstream existing(path, std::ios::binary);
+    if (existing) {
+        std::ostringstream current;
+        current << existing.rdbuf();
+        if (current.str() == contents) {
+            return;
+        }
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not write " + path.string());
+    }
+    file << contents;
+}
+
+} // namespace
+
+auto main(int argc, char *argv[]) -> int {
+    if (argc != 3) {
+        std::cerr << "Usage: isa_gen <spec file> <output directory>\n";
+        return 1;
+    }
+    try {
+        const IsaSpec spec = parseSpec(argv[1]);
+        const std::filesystem::path outputDir = argv[2];
+        std::filesystem::create_directories(outputDir);
+        writeIfChanged(outputDir / "isa_mnemonics.h", generateMnemonics(spec));
+        writeIfChanged(outputDir / "isa_formats.h", generateFormats(spec));
+        writeIfChanged(outputDir / "isa_encodings.h", generateEncodings(spec));
+        writeIfChanged(outputDir / "isa_peepholes.h", generatePeepholes(spec));
+    } catch (const std::exception &e) {
+        std::cerr << "isa_gen: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}